@@ -15,13 +15,23 @@ import java.util.concurrent.TimeUnit;
 import java.util.concurrent.TimeoutException;
 import java.util.concurrent.Future;
 import java.util.concurrent.ExecutionException;
+import java.util.concurrent.BlockingQueue;
+import java.util.concurrent.LinkedBlockingQueue;
+import java.util.concurrent.ConcurrentHashMap;
 import java.util.LinkedList;
 import java.util.Queue;
 import java.io.IOException;
 import java.io.File;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.CharBuffer;
+import java.nio.charset.CharsetEncoder;
+import java.nio.charset.CoderResult;
+import java.nio.charset.CodingErrorAction;
 import java.nio.charset.StandardCharsets;
+import java.math.BigDecimal;
 import java.util.HashMap;
+import java.util.Iterator;
 import java.util.Map;
 import java.io.FileInputStream;
 import java.io.ObjectInputStream;
@@ -35,6 +45,7 @@ import java.lang.management.ManagementFactory;
 import java.lang.management.MemoryMXBean;
 import java.lang.management.MemoryUsage;
 
+import com.fasterxml.jackson.databind.DeserializationFeature;
 import com.fasterxml.jackson.databind.JsonNode;
 import com.fasterxml.jackson.databind.ObjectMapper;
 
@@ -47,13 +58,29 @@ public class DebeziumRunner {
 	private String lastDbzMessage;
 	private boolean lastDbzSuccess;
 	private Throwable lastDbzError;
-	private HashMap<Integer, ChangeRecordBatch> activeBatchHash = new HashMap<>();
+	private Map<Integer, ChangeRecordBatch> activeBatchHash = new ConcurrentHashMap<>();
 	private BatchManager batchManager = new BatchManager();
+	private ByteBuffer changeEventsBuffer;
+	private CharsetEncoder utf8Encoder = newUtf8Encoder();
+
+	/* used only when batches are pipelined */
+	private boolean pipelineBatches = false;
+	private Thread batchPreparerThread;
+	private ExecutorService commitExecutor;
+	private BlockingQueue<ByteBuffer> freeBatchBuffers;
+	private BlockingQueue<ByteBuffer> readyBatchBuffers;
+	private ByteBuffer currentBatchBuffer;
+
+	/* used only when change events are sent in binary format */
+	private boolean binaryChangeEvents = false;
+	private BinaryEventEncoder binaryEventEncoder;
 
 	final int TYPE_MYSQL = 1;
 	final int TYPE_ORACLE = 2;
 	final int TYPE_SQLSERVER = 3;
 	final int BATCH_QUEUE_SIZE = 3;
+	final int EVENT_BUFFER_INITIAL_SIZE = 1024 * 1024;
+	final int PIPELINE_BUFFER_NUM = 2;
 
 	/* MyParameters class - encapsulates all supported debezium parameters */
 	public class MyParameters
@@ -87,6 +114,9 @@ public class DebeziumRunner {
 		private String sslKeystorePass;
 		private String sslTruststore;
 		private String sslTruststorePass;
+		private boolean pipelineBatches;
+		private boolean binaryChangeEvents;
+		private boolean transactionMetadata;
 
 		/* constructor requires all required parameters for a connector to work */
 		public MyParameters(String connectorName, int connectorType, String hostname, int port, String user, String password, String database, String table, String snapshotMode)
@@ -186,6 +216,21 @@ public class DebeziumRunner {
 			this.sslTruststorePass = sslTruststorePass;
 			return this;
 		}
+		public MyParameters setPipelineBatches(boolean pipelineBatches)
+		{
+			this.pipelineBatches = pipelineBatches;
+			return this;
+		}
+		public MyParameters setBinaryChangeEvents(boolean binaryChangeEvents)
+		{
+			this.binaryChangeEvents = binaryChangeEvents;
+			return this;
+		}
+		public MyParameters setTransactionMetadata(boolean transactionMetadata)
+		{
+			this.transactionMetadata = transactionMetadata;
+			return this;
+		}
 
 		/* add more setters here to incrementally set parameters */
 		public void print()
@@ -216,6 +261,9 @@ public class DebeziumRunner {
 			logger.warn("sslKeystorePass = " + this.sslKeystorePass);
 			logger.warn("sslTruststore = " + this.sslTruststore);
 			logger.warn("sslTruststorePass = " + this.sslTruststorePass);
+			logger.warn("pipelineBatches = " + this.pipelineBatches);
+			logger.warn("binaryChangeEvents = " + this.binaryChangeEvents);
+			logger.warn("transactionMetadata = " + this.transactionMetadata);
 		}
 
 	}
@@ -255,6 +303,9 @@ public class DebeziumRunner {
 			this.batchid++;
 			logger.info("added a batch task: id = " + batch.batchid + " size = " + batch.records.size());
 			notifyAll();
+
+			/* wake up synchdb worker to process this batch right away */
+			wakeupSynchdb();
 		}
 
 		public synchronized ChangeRecordBatch getNextBatch()
@@ -267,12 +318,341 @@ public class DebeziumRunner {
 			return batch;
 		}
 
+		/* same as getNextBatch() but waits until a batch is available or shutdown */
+		public synchronized ChangeRecordBatch waitNextBatch() throws InterruptedException
+		{
+			while (batchQueue.isEmpty() && !this.isShutdown)
+			{
+				wait();
+			}
+
+			if (this.isShutdown)
+				return null;
+
+			return getNextBatch();
+		}
+
 		public synchronized void shutdown()
 		{
 			this.isShutdown = true;
 			notifyAll();
 		}
 	}
+
+	/*
+	 * BatchPreparer is the background thread used when batches are pipelined. It
+	 * serializes the next queued batch into a free direct buffer while synchdb is
+	 * still applying the current one, so the next getChangeEventsBuffer() call
+	 * can hand it over right away.
+	 */
+	public class BatchPreparer implements Runnable
+	{
+		private CharsetEncoder encoder = newUtf8Encoder();
+
+		@Override
+		public void run()
+		{
+			try
+			{
+				while (true)
+				{
+					ByteBuffer buf;
+					ChangeRecordBatch batch;
+					List<Object> events;
+
+					/* wait for synchdb to give back a buffer it has finished with */
+					buf = freeBatchBuffers.take();
+
+					batch = batchManager.waitNextBatch();
+					if (batch == null)
+						break;
+
+					events = encodeChangeEvents(batchToEvents(batch));
+					activeBatchHash.put(batch.batchid, batch);
+
+					while (!serializeChangeEvents(events, buf, encoder))
+					{
+						logger.info("growing pipelined batch buffer to " + buf.capacity() * 2 + " bytes");
+						buf = ByteBuffer.allocateDirect(buf.capacity() * 2).order(ByteOrder.nativeOrder());
+					}
+
+					readyBatchBuffers.put(buf);
+					logger.info("prepared batchid(" + batch.batchid + ") with size(" + batch.records.size() + ")");
+
+					/* batch is ready to be picked up */
+					wakeupSynchdb();
+				}
+			}
+			catch (InterruptedException e)
+			{
+				Thread.currentThread().interrupt();
+			}
+			logger.warn("batch preparer thread exits");
+		}
+	}
+	
+	/*
+	 * BinaryEventEncoder turns the JSON change events produced by Debezium into the
+	 * compact binary format decoded by synchdb's format converter. The schema section
+	 * of an event is only sent along with the first event that carries it, later
+	 * events refer to it by its fingerprint. All integers are in native byte order:
+	 *
+	 *   byte   magic (BINARY_EVENT_MAGIC)
+	 *   byte   version (BINARY_EVENT_VERSION)
+	 *   byte   op ('c', 'r', 'u' or 'd')
+	 *   byte   snapshot (0 = not snapshot, 1 = snapshot, 2 = last snapshot event)
+	 *   string connector, db, schema, table
+	 *   int64  schema fingerprint
+	 *   byte   1 if schema follows, 0 otherwise
+	 *     int16  number of fields, then for each field:
+	 *            string name, string semantic type name, int32 scale (Integer.MIN_VALUE if none)
+	 *   values before, values after
+	 *
+	 * where string is an int32 length (-1 for null) followed by UTF-8 bytes, and values
+	 * is an int16 count (-1 for a null image) followed by (int16 field index, byte tag,
+	 * string value) for each column, tag being one of the BINARY_VALUE_* constants.
+	 * DDL and other events that do not fit this format are left as JSON.
+	 */
+	public static class BinaryEventEncoder
+	{
+		static final byte BINARY_EVENT_MAGIC = 0x01;
+		static final byte BINARY_EVENT_VERSION = 2;
+		static final byte BINARY_VALUE_NULL = 0;
+		static final byte BINARY_VALUE_TEXT = 1;
+		static final byte BINARY_VALUE_JSON = 2;
+
+		private final ObjectMapper mapper = new ObjectMapper().enable(DeserializationFeature.USE_BIG_DECIMAL_FOR_FLOATS);
+		private final Map<Long, Map<String, Integer>> sentSchemas = new HashMap<>();
+		private ByteBuffer buf = ByteBuffer.allocate(64 * 1024).order(ByteOrder.nativeOrder());
+
+		/* returns the binary encoding of a JSON change event, or null if it must stay JSON */
+		public byte[] encode(String event)
+		{
+			JsonNode root, schema, payload, source, op, rowSchema;
+			Map<String, Integer> fieldIndex;
+			long fingerprint;
+			boolean newSchema = false;
+
+			try
+			{
+				root = mapper.readTree(event);
+			}
+			catch (IOException e)
+			{
+				logger.warn("cannot parse change event for binary encoding: " + e.getMessage());
+				return null;
+			}
+
+			schema = root.get("schema");
+			payload = root.get("payload");
+			if (schema == null || payload == null || !payload.isObject())
+				return null;
+
+			op = payload.get("op");
+			source = payload.get("source");
+			if (op == null || !op.isTextual() || op.asText().length() != 1 || source == null)
+				return null;
+
+			fingerprint = fingerprint(schema.toString());
+			fieldIndex = sentSchemas.get(fingerprint);
+			rowSchema = null;
+			if (fieldIndex == null)
+			{
+				rowSchema = findRowSchema(schema);
+				if (rowSchema == null)
+					return null;
+
+				fieldIndex = new HashMap<>();
+				for (JsonNode field : rowSchema.get("fields"))
+				{
+					fieldIndex.put(field.path("field").asText(), fieldIndex.size());
+				}
+				newSchema = true;
+			}
+
+			buf.clear();
+			put((byte) BINARY_EVENT_MAGIC);
+			put((byte) BINARY_EVENT_VERSION);
+			put((byte) op.asText().charAt(0));
+			put(snapshotFlag(source.path("snapshot").asText()));
+			putString(textOrNull(source.get("connector")));
+			putString(textOrNull(source.get("db")));
+			putString(textOrNull(source.get("schema")));
+			putString(textOrNull(source.get("table")));
+			putLong(fingerprint);
+
+			if (newSchema)
+			{
+				put((byte) 1);
+				putShort(rowSchema.get("fields").size());
+				for (JsonNode field : rowSchema.get("fields"))
+				{
+					JsonNode scale = field.path("parameters").get("scale");
+
+					putString(field.path("field").asText());
+					putString(textOrNull(field.get("name")));
+					putInt(scale == null ? Integer.MIN_VALUE : scale.asInt(0));
+				}
+			}
+			else
+				put((byte) 0);
+
+			if (!putValues(payload.get("before"), fieldIndex) ||
+				!putValues(payload.get("after"), fieldIndex))
+				return null;
+
+			/* synchdb will know this schema once it has received this event */
+			if (newSchema)
+				sentSchemas.put(fingerprint, fieldIndex);
+
+			byte[] encoded = new byte[buf.position()];
+			buf.flip();
+			buf.get(encoded);
+			return encoded;
+		}
+
+		/* returns the struct schema of the before or after image */
+		private JsonNode findRowSchema(JsonNode schema)
+		{
+			JsonNode fields = schema.get("fields");
+
+			if (fields == null || !fields.isArray())
+				return null;
+
+			for (JsonNode field : fields)
+			{
+				String name = field.path("field").asText();
+				if ((name.equals("after") || name.equals("before")) && field.path("fields").isArray())
+					return field;
+			}
+			return null;
+		}
+
+		private boolean putValues(JsonNode image, Map<String, Integer> fieldIndex)
+		{
+			Iterator<Map.Entry<String, JsonNode>> it;
+
+			if (image == null || image.isNull())
+			{
+				putShort(-1);
+				return true;
+			}
+
+			if (!image.isObject())
+				return false;
+
+			putShort(image.size());
+			it = image.fields();
+			while (it.hasNext())
+			{
+				Map.Entry<String, JsonNode> column = it.next();
+				JsonNode value = column.getValue();
+				Integer index = fieldIndex.get(column.getKey());
+
+				/* column not described by the schema, send this event as JSON */
+				if (index == null)
+					return false;
+
+				putShort(index);
+				if (value.isNull())
+				{
+					put(BINARY_VALUE_NULL);
+				}
+				else if (value.isContainerNode())
+				{
+					put(BINARY_VALUE_JSON);
+					putString(value.toString());
+				}
+				else
+				{
+					put(BINARY_VALUE_TEXT);
+					putString(value.isBigDecimal() ? value.decimalValue().toPlainString() : value.asText());
+				}
+			}
+			return true;
+		}
+
+		/* same rule as is_snapshot_value() in format_converter.c */
+		private static byte snapshotFlag(String snapshot)
+		{
+			if (snapshot.isEmpty() || snapshot.equals("null") ||
+				snapshot.equals("false") || snapshot.equals("incremental"))
+				return 0;
+			if (snapshot.equals("last"))
+				return 2;
+			return 1;
+		}
+
+		private static String textOrNull(JsonNode node)
+		{
+			return (node == null || node.isNull()) ? null : node.asText();
+		}
+
+		/* 64-bit FNV-1a hash of the schema section */
+		private static long fingerprint(String schema)
+		{
+			long hash = 0xcbf29ce484222325L;
+
+			for (int i = 0; i < schema.length(); i++)
+			{
+				hash ^= schema.charAt(i);
+				hash *= 0x100000001b3L;
+			}
+			return hash;
+		}
+
+		private void ensureRemaining(int len)
+		{
+			if (buf.remaining() < len)
+			{
+				ByteBuffer bigger = ByteBuffer.allocate(Math.max(buf.capacity() * 2, buf.position() + len))
+						.order(ByteOrder.nativeOrder());
+				buf.flip();
+				bigger.put(buf);
+				buf = bigger;
+			}
+		}
+
+		private void put(byte b)
+		{
+			ensureRemaining(1);
+			buf.put(b);
+		}
+
+		private void putShort(int s)
+		{
+			ensureRemaining(2);
+			buf.putShort((short) s);
+		}
+
+		private void putInt(int i)
+		{
+			ensureRemaining(4);
+			buf.putInt(i);
+		}
+
+		private void putLong(long l)
+		{
+			ensureRemaining(8);
+			buf.putLong(l);
+		}
+
+		private void putString(String s)
+		{
+			byte[] bytes;
+
+			if (s == null)
+			{
+				putInt(-1);
+				return;
+			}
+
+			bytes = s.getBytes(StandardCharsets.UTF_8);
+			putInt(bytes.length);
+			ensureRemaining(bytes.length);
+			buf.put(bytes);
+		}
+	}
 	
 	/* ChangeRecordBatch represents a batch with our own identifier 'batchid' added to it */
 	public class ChangeRecordBatch
@@ -288,6 +668,68 @@ public class DebeziumRunner {
 		}
 	}
 
+	/*
+	 * native method implemented and registered by synchdb worker. It writes to a
+	 * pipe the worker waits on so it wakes up immediately instead of at the next
+	 * naptime
+	 */
+	private native void notifyBatchReady();
+
+	static CharsetEncoder newUtf8Encoder()
+	{
+		return StandardCharsets.UTF_8.newEncoder()
+				.onMalformedInput(CodingErrorAction.REPLACE)
+				.onUnmappableCharacter(CodingErrorAction.REPLACE);
+	}
+
+	/* turns a batch into the list of records sent to synchdb, metadata record first */
+	private List<String> batchToEvents(ChangeRecordBatch batch)
+	{
+		List<String> events = new ArrayList<>(batch.records.size() + 1);
+
+		events.add("B-" + String.valueOf(batch.batchid));
+		for (int i = 0; i < batch.records.size(); i++)
+		{
+			events.add(batch.records.get(i).value());
+		}
+		return events;
+	}
+
+	/*
+	 * turns the events of a batch into the records put in a direct buffer. When binary
+	 * change events are enabled, change events are replaced by their binary encoding;
+	 * the metadata record and events that cannot be encoded are kept as they are
+	 */
+	private List<Object> encodeChangeEvents(List<String> events)
+	{
+		List<Object> records = new ArrayList<>(events.size());
+
+		for (int i = 0; i < events.size(); i++)
+		{
+			String event = events.get(i);
+			byte[] encoded = null;
+
+			if (i > 0 && binaryChangeEvents && event != null)
+				encoded = binaryEventEncoder.encode(event);
+
+			records.add(encoded != null ? encoded : event);
+		}
+		return records;
+	}
+
+	private void wakeupSynchdb()
+	{
+		try
+		{
+			notifyBatchReady();
+		}
+		catch (UnsatisfiedLinkError e)
+		{
+			/* not registered by synchdb, it will find the batch at next naptime */
+			logger.debug("notifyBatchReady is not available: " + e.getMessage());
+		}
+	}
+
 	public void checkMemoryStatus()
 	{
 		MemoryMXBean memoryMXBean = ManagementFactory.getMemoryMXBean();
@@ -465,6 +907,7 @@ public class DebeziumRunner {
 		props.setProperty("incremental.snapshot.watermarking.strategy", myParameters.incrementalSnapshotWatermarkingStrategy);
 		props.setProperty("incremental.snapshot.allow.schema.changes", "false");
 		props.setProperty("min.row.count.to.stream.results", String.valueOf(myParameters.snapshotMinRowToStreamResults));
+		props.setProperty("provide.transaction.metadata", myParameters.transactionMetadata ? "true" : "false");
 
 		//props.setProperty("read.only", "true");
 
@@ -475,6 +918,9 @@ public class DebeziumRunner {
 			lastDbzMessage = message.replace("\n", " ").replace("\r", " ");
 			lastDbzSuccess = success;
 			lastDbzError = error;
+
+			/* let synchdb worker pick up the completion message right away */
+			wakeupSynchdb();
 		};
 		
 		engine = DebeziumEngine.create(Json.class)
@@ -491,7 +937,7 @@ public class DebeziumRunner {
 						}
 						if (activeBatchHash == null)
 						{
-							activeBatchHash = new HashMap<>();
+							activeBatchHash = new ConcurrentHashMap<>();
 						}
 
 						try
@@ -525,16 +971,62 @@ public class DebeziumRunner {
 				throw e;
 			}
 		});
+
+		binaryChangeEvents = myParameters.binaryChangeEvents;
+		if (binaryChangeEvents)
+		{
+			binaryEventEncoder = new BinaryEventEncoder();
+			logger.info("change events are sent in binary format");
+		}
+
+		pipelineBatches = myParameters.pipelineBatches;
+		if (pipelineBatches)
+		{
+			freeBatchBuffers = new LinkedBlockingQueue<>();
+			readyBatchBuffers = new LinkedBlockingQueue<>();
+			for (int i = 0; i < PIPELINE_BUFFER_NUM; i++)
+			{
+				freeBatchBuffers.add(ByteBuffer.allocateDirect(EVENT_BUFFER_INITIAL_SIZE).order(ByteOrder.nativeOrder()));
+			}
+			commitExecutor = Executors.newSingleThreadExecutor();
+			batchPreparerThread = new Thread(new BatchPreparer(), "synchdb-batch-preparer");
+			batchPreparerThread.setDaemon(true);
+			batchPreparerThread.start();
+			logger.info("batch pipelining enabled with " + PIPELINE_BUFFER_NUM + " buffers");
+		}
     }
 
 	public void stopEngine() throws Exception
 	{
 		/* wake up any waiting threads about shutdown */
 		logger.warn("stopping Debezium engine...");
+		if (commitExecutor != null)
+		{
+			/* let pending batch completions reach debezium before it is closed */
+			logger.warn("flushing pending batch completions...");
+			commitExecutor.shutdown();
+			try
+			{
+				if (!commitExecutor.awaitTermination(5, TimeUnit.SECONDS))
+				{
+					commitExecutor.shutdownNow();
+				}
+			}
+			catch (InterruptedException e)
+			{
+				commitExecutor.shutdownNow();
+			}
+			commitExecutor = null;
+		}
 		if (batchManager != null)
 		{
 			batchManager.shutdown();
 		}
+		if (batchPreparerThread != null)
+		{
+			batchPreparerThread.interrupt();
+			batchPreparerThread = null;
+		}
 		if (engine != null)
 		{
 			logger.warn("closing Debezium engine...");
@@ -565,7 +1057,7 @@ public class DebeziumRunner {
 		List<String> listCopy;
 		if (activeBatchHash == null)
 		{
-			activeBatchHash = new HashMap<>();
+			activeBatchHash = new ConcurrentHashMap<>();
 		}
 		if (batchManager == null)
 		{
@@ -575,21 +1067,14 @@ public class DebeziumRunner {
 		//checkMemoryStatus();
         if (!future.isDone())
 		{
-			int i = 0;
 			listCopy = new ArrayList<>();
 			ChangeRecordBatch myNextBatch;
 			myNextBatch = batchManager.getNextBatch();
 			if (myNextBatch != null)
 			{
 				logger.info("Debezium -> Synchdb: sent batchid(" + myNextBatch.batchid + ") with size(" + myNextBatch.records.size() + ")");
-				/* first element: batch id */
-				listCopy.add("B-" + String.valueOf(myNextBatch.batchid));
-
-				/* remaining elements: individual changes*/
-				for (i = 0; i < myNextBatch.records.size(); i++)
-				{
-					listCopy.add(myNextBatch.records.get(i).value());
-				}
+				/* first element: batch id, remaining elements: individual changes */
+				listCopy = batchToEvents(myNextBatch);
 
 				/* save this batch in active batch hash struct */
 				activeBatchHash.put(myNextBatch.batchid, myNextBatch);
@@ -611,6 +1096,119 @@ public class DebeziumRunner {
 		return listCopy;
     }
 
+	/*
+	 * method to return the same content as getChangeEvents() but serialized into
+	 * a single direct ByteBuffer, so synchdb can walk the whole batch without
+	 * making JNI calls per change event. Layout, in native byte order:
+	 *
+	 *   int32 count
+	 *   count x (int32 length, length bytes of UTF-8 data, one null byte)
+	 *
+	 * The first record is the metadata record ("B-" or "K-"). A null change event
+	 * is sent as an empty record. With binary change events enabled, a record may
+	 * instead hold an event encoded by BinaryEventEncoder. The buffer is reused
+	 * across calls because synchdb always consumes it entirely before asking for
+	 * the next batch.
+	 */
+	public ByteBuffer getChangeEventsBuffer()
+	{
+		List<Object> events;
+
+		if (pipelineBatches)
+		{
+			ByteBuffer prepared;
+
+			/* synchdb is done with the buffer it got last time, recycle it */
+			if (currentBatchBuffer != null)
+			{
+				freeBatchBuffers.offer(currentBatchBuffer);
+				currentBatchBuffer = null;
+			}
+
+			/* hand over a batch already prepared by BatchPreparer, if any */
+			prepared = readyBatchBuffers.poll();
+			if (prepared != null)
+			{
+				currentBatchBuffer = prepared;
+				return currentBatchBuffer;
+			}
+
+			/* nothing prepared, send either the completion message or an empty list */
+			events = new ArrayList<>();
+			if (future.isDone())
+			{
+				logger.warn("connector is no longer running");
+				events.add("K-" + lastDbzSuccess + ";" + lastDbzMessage);
+			}
+		}
+		else
+			events = encodeChangeEvents(getChangeEvents());
+
+		if (changeEventsBuffer == null)
+		{
+			changeEventsBuffer = ByteBuffer.allocateDirect(EVENT_BUFFER_INITIAL_SIZE).order(ByteOrder.nativeOrder());
+		}
+
+		while (!serializeChangeEvents(events, changeEventsBuffer, utf8Encoder))
+		{
+			/* not enough room, grow the buffer and serialize again */
+			logger.info("growing change event buffer to " + changeEventsBuffer.capacity() * 2 + " bytes");
+			changeEventsBuffer = ByteBuffer.allocateDirect(changeEventsBuffer.capacity() * 2).order(ByteOrder.nativeOrder());
+		}
+		return changeEventsBuffer;
+	}
+
+	/*
+	 * encode events into buf as described above, returns false if buf is too small.
+	 * An event is either a String, an already encoded byte[] or null
+	 */
+	static boolean serializeChangeEvents(List<Object> events, ByteBuffer buf, CharsetEncoder encoder)
+	{
+		buf.clear();
+		buf.putInt(events.size());
+
+		for (Object event : events)
+		{
+			int lenpos;
+
+			if (buf.remaining() < 5)
+				return false;
+
+			/* reserve room for the length and fill it in after encoding */
+			lenpos = buf.position();
+			buf.putInt(0);
+			if (event instanceof byte[])
+			{
+				byte[] bytes = (byte[]) event;
+
+				if (buf.remaining() < bytes.length)
+					return false;
+
+				buf.put(bytes);
+			}
+			else if (event != null)
+			{
+				CoderResult result;
+
+				encoder.reset();
+				result = encoder.encode(CharBuffer.wrap((String) event), buf, true);
+				if (result.isOverflow())
+					return false;
+
+				result = encoder.flush(buf);
+				if (result.isOverflow())
+					return false;
+			}
+
+			if (!buf.hasRemaining())
+				return false;
+
+			buf.putInt(lenpos, buf.position() - lenpos - 4);
+			buf.put((byte) 0);
+		}
+		return true;
+	}
+
 	/* 
 	 * method to mark a batch as done. This would cause dbz engine to commit the offset.
 	 * if markbatchdone = true, the entire batch task is marked as completed.
@@ -625,7 +1223,7 @@ public class DebeziumRunner {
 
 		if (activeBatchHash == null)
 		{
-			activeBatchHash = new HashMap<>();
+			activeBatchHash = new ConcurrentHashMap<>();
 			return;
 		}
 		
@@ -688,6 +1286,43 @@ public class DebeziumRunner {
 		System.gc();
 	}
 	
+	/*
+	 * method to mark a batch as done without making synchdb wait for it. Debezium
+	 * committer calls are made by a single thread in the order the batches were
+	 * completed. Used when batches are pipelined.
+	 */
+	public void markBatchCompleteAsync(int batchid)
+	{
+		if (commitExecutor == null)
+		{
+			try
+			{
+				markBatchComplete(batchid, true, -1, -1);
+			}
+			catch (InterruptedException e)
+			{
+				Thread.currentThread().interrupt();
+			}
+			return;
+		}
+
+		commitExecutor.submit(() ->
+		{
+			try
+			{
+				markBatchComplete(batchid, true, -1, -1);
+			}
+			catch (InterruptedException e)
+			{
+				Thread.currentThread().interrupt();
+			}
+			catch (Exception e)
+			{
+				logger.error("failed to mark batchid(" + batchid + ") as complete: " + e.getMessage());
+			}
+		});
+	}
+
 	public String getConnectorOffset(int connectorType, String db, String name)
 	{
 		File inputFile = null;
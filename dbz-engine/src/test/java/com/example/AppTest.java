@@ -1,5 +1,12 @@
 package com.example;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+
 import junit.framework.Test;
 import junit.framework.TestCase;
 import junit.framework.TestSuite;
@@ -7,9 +14,114 @@ import junit.framework.TestSuite;
 /**
  * Unit test for simple App.
  */
-public class AppTest 
+public class AppTest
     extends TestCase
 {
+    /* a change event with a decimal, a double, a nested struct and a text column */
+    private static final String SCHEMA =
+        "{\"type\":\"struct\",\"fields\":[" +
+        "{\"type\":\"struct\",\"field\":\"before\",\"optional\":true,\"fields\":[" +
+        "{\"type\":\"int32\",\"field\":\"id\"}," +
+        "{\"type\":\"bytes\",\"field\":\"price\",\"name\":\"org.apache.kafka.connect.data.Decimal\",\"parameters\":{\"scale\":\"2\"}}," +
+        "{\"type\":\"double\",\"field\":\"rate\"}," +
+        "{\"type\":\"struct\",\"field\":\"shape\",\"name\":\"io.debezium.data.geometry.Geometry\"}," +
+        "{\"type\":\"string\",\"field\":\"note\"}]}," +
+        "{\"type\":\"struct\",\"field\":\"source\",\"fields\":[]}]}";
+
+    private static String event(String op, String snapshot, String before, String after)
+    {
+        return "{\"schema\":" + SCHEMA + ",\"payload\":{" +
+            "\"before\":" + before + ",\"after\":" + after + "," +
+            "\"source\":{\"connector\":\"mysql\",\"db\":\"inventory\",\"schema\":null," +
+            "\"table\":\"orders\",\"snapshot\":\"" + snapshot + "\"}," +
+            "\"op\":\"" + op + "\"}}";
+    }
+
+    /* reads back the records written by DebeziumRunner.serializeChangeEvents() */
+    private static List<byte[]> readRecords(ByteBuffer buf)
+    {
+        ByteBuffer in = buf.duplicate().order(ByteOrder.nativeOrder());
+        List<byte[]> records = new ArrayList<>();
+        int count;
+
+        in.flip();
+        count = in.getInt();
+        for (int i = 0; i < count; i++)
+        {
+            byte[] record = new byte[in.getInt()];
+
+            in.get(record);
+            assertEquals("record " + i + " is not null terminated", 0, in.get());
+            records.add(record);
+        }
+        assertFalse("trailing bytes after the last record", in.hasRemaining());
+        return records;
+    }
+
+    /* reads the records the same way format_converter.c decodes a binary event */
+    private static class BinaryEventReader
+    {
+        private final ByteBuffer in;
+
+        BinaryEventReader(byte[] encoded)
+        {
+            in = ByteBuffer.wrap(encoded).order(ByteOrder.nativeOrder());
+        }
+
+        byte getByte()
+        {
+            return in.get();
+        }
+
+        short getShort()
+        {
+            return in.getShort();
+        }
+
+        int getInt()
+        {
+            return in.getInt();
+        }
+
+        long getLong()
+        {
+            return in.getLong();
+        }
+
+        String getString()
+        {
+            int len = in.getInt();
+            byte[] bytes;
+
+            if (len < 0)
+                return null;
+
+            bytes = new byte[len];
+            in.get(bytes);
+            return new String(bytes, StandardCharsets.UTF_8);
+        }
+
+        boolean atEnd()
+        {
+            return !in.hasRemaining();
+        }
+    }
+
+    /* skips the header of an encoded event and returns whether the schema follows it */
+    private static boolean schemaFollows(byte[] encoded)
+    {
+        BinaryEventReader in;
+
+        assertNotNull(encoded);
+        in = new BinaryEventReader(encoded);
+        for (int i = 0; i < 4; i++)
+            in.getByte();
+        for (int i = 0; i < 4; i++)
+            in.getString();
+        in.getLong();
+        return in.getByte() == 1;
+    }
+
     /**
      * Create the test case
      *
@@ -35,4 +147,164 @@ public class AppTest
     {
         assertTrue( true );
     }
+
+    /**
+     * every record is a length prefix, its bytes and a null byte, after a record count
+     */
+    public void testSerializeChangeEventsLayout()
+    {
+        ByteBuffer buf = ByteBuffer.allocate(256).order(ByteOrder.nativeOrder());
+        List<Object> events = Arrays.asList("B-7", null, new byte[] {1, 0, 3}, "caf\u00e9");
+        List<byte[]> records;
+
+        assertTrue(DebeziumRunner.serializeChangeEvents(events, buf, DebeziumRunner.newUtf8Encoder()));
+        assertEquals(4, buf.getInt(0));
+
+        records = readRecords(buf);
+        assertEquals(4, records.size());
+        assertTrue(Arrays.equals("B-7".getBytes(StandardCharsets.UTF_8), records.get(0)));
+        assertEquals("a null change event is an empty record", 0, records.get(1).length);
+        assertTrue(Arrays.equals(new byte[] {1, 0, 3}, records.get(2)));
+        assertTrue(Arrays.equals("caf\u00e9".getBytes(StandardCharsets.UTF_8), records.get(3)));
+    }
+
+    /**
+     * a buffer too small for the batch is reported, whichever record overflows it
+     */
+    public void testSerializeChangeEventsOverflow()
+    {
+        List<Object> events = Arrays.asList("B-1", "0123456789");
+
+        /* no room for the null byte of the last record */
+        assertFalse(DebeziumRunner.serializeChangeEvents(events,
+                    ByteBuffer.allocate(4 + 8 + 4 + 10).order(ByteOrder.nativeOrder()),
+                    DebeziumRunner.newUtf8Encoder()));
+        /* no room for the length prefix of the second record */
+        assertFalse(DebeziumRunner.serializeChangeEvents(events,
+                    ByteBuffer.allocate(4 + 8 + 2).order(ByteOrder.nativeOrder()),
+                    DebeziumRunner.newUtf8Encoder()));
+        assertTrue(DebeziumRunner.serializeChangeEvents(events,
+                   ByteBuffer.allocate(4 + 8 + 10 + 5).order(ByteOrder.nativeOrder()),
+                   DebeziumRunner.newUtf8Encoder()));
+    }
+
+    /**
+     * an encoded event carries its schema once and decodes back to its values
+     */
+    public void testBinaryEventEncoderRoundTrip()
+    {
+        DebeziumRunner.BinaryEventEncoder encoder = new DebeziumRunner.BinaryEventEncoder();
+        String after = "{\"id\":1,\"price\":\"AQI=\",\"rate\":1.50," +
+            "\"shape\":{\"wkb\":\"AQE=\",\"srid\":4326},\"note\":null}";
+        byte[] encoded = encoder.encode(event("c", "first", "null", after));
+        BinaryEventReader in;
+        long fingerprint;
+
+        assertNotNull(encoded);
+        in = new BinaryEventReader(encoded);
+        assertEquals(DebeziumRunner.BinaryEventEncoder.BINARY_EVENT_MAGIC, in.getByte());
+        assertEquals(DebeziumRunner.BinaryEventEncoder.BINARY_EVENT_VERSION, in.getByte());
+        assertEquals('c', in.getByte());
+        assertEquals("first marks a snapshot event", 1, in.getByte());
+        assertEquals("mysql", in.getString());
+        assertEquals("inventory", in.getString());
+        assertNull(in.getString());
+        assertEquals("orders", in.getString());
+        fingerprint = in.getLong();
+
+        /* the schema follows the first event that carries it */
+        assertEquals(1, in.getByte());
+        assertEquals(5, in.getShort());
+        assertEquals("id", in.getString());
+        assertNull(in.getString());
+        assertEquals("a missing scale is sent as Integer.MIN_VALUE", Integer.MIN_VALUE, in.getInt());
+        assertEquals("price", in.getString());
+        assertEquals("org.apache.kafka.connect.data.Decimal", in.getString());
+        assertEquals(2, in.getInt());
+        assertEquals("rate", in.getString());
+        assertNull(in.getString());
+        assertEquals(Integer.MIN_VALUE, in.getInt());
+        assertEquals("shape", in.getString());
+        assertEquals("io.debezium.data.geometry.Geometry", in.getString());
+        assertEquals(Integer.MIN_VALUE, in.getInt());
+        assertEquals("note", in.getString());
+        assertNull(in.getString());
+        assertEquals(Integer.MIN_VALUE, in.getInt());
+
+        /* no before image, after image in event order */
+        assertEquals(-1, in.getShort());
+        assertEquals(5, in.getShort());
+        assertEquals(0, in.getShort());
+        assertEquals(DebeziumRunner.BinaryEventEncoder.BINARY_VALUE_TEXT, in.getByte());
+        assertEquals("1", in.getString());
+        assertEquals(1, in.getShort());
+        assertEquals(DebeziumRunner.BinaryEventEncoder.BINARY_VALUE_TEXT, in.getByte());
+        assertEquals("AQI=", in.getString());
+        assertEquals(2, in.getShort());
+        assertEquals(DebeziumRunner.BinaryEventEncoder.BINARY_VALUE_TEXT, in.getByte());
+        assertEquals("decimals keep their trailing zeros", "1.50", in.getString());
+        assertEquals(3, in.getShort());
+        assertEquals(DebeziumRunner.BinaryEventEncoder.BINARY_VALUE_JSON, in.getByte());
+        assertEquals("{\"wkb\":\"AQE=\",\"srid\":4326}", in.getString());
+        assertEquals(4, in.getShort());
+        assertEquals(DebeziumRunner.BinaryEventEncoder.BINARY_VALUE_NULL, in.getByte());
+        assertTrue(in.atEnd());
+
+        /* the next event of the table refers to the schema by its fingerprint only */
+        encoded = encoder.encode(event("d", "false", "{\"id\":1}", "null"));
+        assertNotNull(encoded);
+        in = new BinaryEventReader(encoded);
+        in.getByte();
+        in.getByte();
+        assertEquals('d', in.getByte());
+        assertEquals("false is change data capture", 0, in.getByte());
+        in.getString();
+        in.getString();
+        in.getString();
+        in.getString();
+        assertEquals(fingerprint, in.getLong());
+        assertEquals(0, in.getByte());
+        assertEquals(1, in.getShort());
+        assertEquals(0, in.getShort());
+        assertEquals(DebeziumRunner.BinaryEventEncoder.BINARY_VALUE_TEXT, in.getByte());
+        assertEquals("1", in.getString());
+        assertEquals(-1, in.getShort());
+        assertTrue(in.atEnd());
+    }
+
+    /**
+     * snapshot markers are encoded the same way is_snapshot_value() reads them
+     */
+    public void testBinaryEventEncoderSnapshotFlag()
+    {
+        String[][] cases = {
+            {"true", "1"}, {"first", "1"}, {"first_in_data_collection", "1"},
+            {"last_in_data_collection", "1"}, {"last", "2"},
+            {"false", "0"}, {"incremental", "0"}
+        };
+
+        for (String[] c : cases)
+        {
+            byte[] encoded = new DebeziumRunner.BinaryEventEncoder().encode(event("r", c[0], "null", "{\"id\":1}"));
+
+            assertNotNull(encoded);
+            assertEquals(c[0], Byte.parseByte(c[1]), encoded[3]);
+        }
+    }
+
+    /**
+     * events the binary format cannot describe are left as JSON
+     */
+    public void testBinaryEventEncoderFallsBackToJson()
+    {
+        DebeziumRunner.BinaryEventEncoder encoder = new DebeziumRunner.BinaryEventEncoder();
+
+        assertNull("not JSON", encoder.encode("{"));
+        assertNull("column missing from the schema", encoder.encode(event("c", "false", "null", "{\"extra\":1}")));
+        assertNull("DDL event", encoder.encode("{\"schema\":{},\"payload\":{\"ddl\":\"CREATE TABLE t (a int)\"}}"));
+
+        /* the event that failed did not send the schema, so the next one still does */
+        assertTrue(schemaFollows(encoder.encode(event("c", "false", "null", "{\"id\":2}"))));
+        assertFalse(schemaFollows(encoder.encode(event("c", "false", "null", "{\"id\":3}"))));
+    }
 }
@@ -28,6 +28,7 @@
 #include "postgres.h"
 #include "fmgr.h"
 #include "utils/jsonb.h"
+#include "utils/json.h"
 #include "utils/builtins.h"
 #include "format_converter.h"
 #include "catalog/pg_type.h"
@@ -36,20 +37,42 @@
 #include "utils/rel.h"
 #include "utils/memutils.h"
 #include "access/table.h"
-#include <time.h>
+#include "utils/inval.h"
+#include "access/sysattr.h"
+#include "utils/date.h"
+#include "utils/datetime.h"
+#include "utils/timestamp.h"
+#include "utils/numeric.h"
 #include "synchdb.h"
 #include "common/base64.h"
 #include "port/pg_bswap.h"
+#include "common/hashfn.h"
+#include "common/jsonapi.h"
+#include "mb/pg_wchar.h"
+#include "utils/formatting.h"
+#include "catalog/pg_collation.h"
+#include "common/md5.h"
+#include "storage/fd.h"
+#include <unistd.h>
 
 /* global external variables */
 extern bool synchdb_dml_use_spi;
+extern bool synchdb_dml_use_streaming_parser;
+extern bool synchdb_snapshot_fast_load;
 extern int myConnectorId;
 extern ExtraConnectionInfo extraConnInfo;
 
 /* data transformation related hash tables */
 static HTAB * dataCacheHash;
+static uint64 dataCacheInvalCount = 0;
+static HTAB * schemaCacheHash;
+static HTAB * jsonSchemaCacheHash;
+static HTAB * jsonPathHash;
 static HTAB * objectMappingHash;
 static HTAB * transformExpressionHash;
+static HTAB * fastLoadHash;
+static char fastLoadFile[MAXPGPATH];	/* deferred primary keys of this connector, see deferPrimaryKey() */
+static bool snapshotInProgress = false;	/* snapshot events seen but not the last one */
 
 /* data type mapping related hash tables */
 static HTAB * mysqlDatatypeHash;
@@ -206,31 +229,319 @@ bytearray_to_escaped_string(const unsigned char *byte_array, size_t length, char
 }
 
 /*
- * derive_value_from_byte
+ * unscaled_bytes_to_limbs
  *
- * computes the int value from given byte
+ * converts the big-endian two's complement unscaled value debezium sends for
+ * decimal types into the base 10^9 limbs of its magnitude, least significant
+ * first. The number of limbs is returned in nlimbs, none for zero
  */
-static long
-derive_value_from_byte(const unsigned char * bytes, int len)
+static uint32 *
+unscaled_bytes_to_limbs(const unsigned char * bytes, int len, int * nlimbs, bool * negative)
 {
-	long value = 0;
-	int i;
+	unsigned char * mag;
+	uint32 * limbs;
+	int i, j;
+
+	*nlimbs = 0;
+	*negative = len > 0 && (bytes[0] & 0x80);
+
+	/* the magnitude of a negative value is its two's complement */
+	mag = (unsigned char *) palloc(len + 1);
+	memcpy(mag, bytes, len);
+	if (*negative)
+	{
+		for (i = 0; i < len; i++)
+			mag[i] = ~mag[i];
+		for (i = len - 1; i >= 0; i--)
+		{
+			if (++mag[i] != 0)
+				break;
+		}
+	}
 
-	/* Convert the byte array to an integer */
+	/* each limb holds 9 decimal digits, which is more than 29 bits */
+	limbs = (uint32 *) palloc0(sizeof(uint32) * (len * 8 / 29 + 2));
 	for (i = 0; i < len; i++)
 	{
-		value = (value << 8) | bytes[i];
+		uint64 carry = mag[i];
+
+		for (j = 0; j < *nlimbs; j++)
+		{
+			uint64 cur = ((uint64) limbs[j] << 8) + carry;
+
+			limbs[j] = (uint32) (cur % 1000000000);
+			carry = cur / 1000000000;
+		}
+		while (carry)
+		{
+			limbs[(*nlimbs)++] = (uint32) (carry % 1000000000);
+			carry /= 1000000000;
+		}
+	}
+
+	pfree(mag);
+	return limbs;
+}
+
+/*
+ * decimal_from_unscaled_bytes
+ *
+ * converts the big-endian two's complement unscaled value debezium sends for
+ * decimal types into an exact decimal string with scale digits after the
+ * decimal point. The value may be of any precision
+ */
+static char *
+decimal_from_unscaled_bytes(const unsigned char * bytes, int len, int scale)
+{
+	StringInfoData strinfo;
+	uint32 * limbs;
+	char * digits;
+	int nlimbs, ndigits, i;
+	bool negative;
+
+	limbs = unscaled_bytes_to_limbs(bytes, len, &nlimbs, &negative);
+
+	initStringInfo(&strinfo);
+	if (nlimbs == 0)
+		appendStringInfoChar(&strinfo, '0');
+	else
+	{
+		appendStringInfo(&strinfo, "%u", limbs[nlimbs - 1]);
+		for (i = nlimbs - 2; i >= 0; i--)
+			appendStringInfo(&strinfo, "%09u", limbs[i]);
+	}
+	digits = strinfo.data;
+	ndigits = strinfo.len;
+
+	/* then place the decimal point, ex: 123 -> 1.23, 123 -> 0.00123 */
+	initStringInfo(&strinfo);
+	if (negative && nlimbs > 0)
+		appendStringInfoChar(&strinfo, '-');
+
+	if (scale <= 0)
+	{
+		appendStringInfoString(&strinfo, digits);
+		for (i = 0; i < -scale && nlimbs > 0; i++)
+			appendStringInfoChar(&strinfo, '0');
+	}
+	else if (ndigits > scale)
+	{
+		appendBinaryStringInfo(&strinfo, digits, ndigits - scale);
+		appendStringInfoChar(&strinfo, '.');
+		appendStringInfoString(&strinfo, digits + ndigits - scale);
 	}
+	else
+	{
+		appendStringInfoString(&strinfo, "0.");
+		for (i = 0; i < scale - ndigits; i++)
+			appendStringInfoChar(&strinfo, '0');
+		appendStringInfoString(&strinfo, digits);
+	}
+
+	pfree(limbs);
+	pfree(digits);
+	return strinfo.data;
+}
+
+/*
+ * numeric_from_unscaled_bytes
+ *
+ * converts the big-endian two's complement unscaled value debezium sends for
+ * decimal types into a Numeric datum with scale digits after the decimal point,
+ * without going through text. The value may be of any precision. The typmod of
+ * the column is applied the same way numeric_in would
+ */
+static Datum
+numeric_from_unscaled_bytes(const unsigned char * bytes, int len, int scale, int32 typmod)
+{
+	uint32 * limbs;
+	Numeric result;
+	int nlimbs, i;
+	bool negative;
+
+	limbs = unscaled_bytes_to_limbs(bytes, len, &nlimbs, &negative);
 
 	/*
-	 * If the value is signed and the most significant bit (MSB) is set,
-	 * sign-extend the value
+	 * two limbs at a time fit in an int64. Each pair is shifted into place by
+	 * its power of ten, the least significant one sets the display scale
 	 */
-	if ((bytes[0] & 0x80))
+	result = int64_div_fast_to_numeric(0, scale);
+	for (i = 0; i < nlimbs; i += 2)
+	{
+		int64 pair = limbs[i];
+		Numeric term;
+		Numeric sum;
+
+		if (i + 1 < nlimbs)
+			pair += (int64) limbs[i + 1] * 1000000000;
+		if (pair == 0)
+			continue;
+
+		term = int64_div_fast_to_numeric(negative ? -pair : pair, scale - i * 9);
+		sum = numeric_add_opt_error(result, term, NULL);
+		pfree(result);
+		pfree(term);
+		result = sum;
+	}
+	pfree(limbs);
+
+	if (typmod >= 0)
+		return DirectFunctionCall2(numeric, NumericGetDatum(result), Int32GetDatum(typmod));
+	return NumericGetDatum(result);
+}
+
+/*
+ * floor_div
+ *
+ * integer division rounding towards negative infinity so values before epoch
+ * land on the right day or second
+ */
+static inline int64
+floor_div(int64 value, int64 divisor)
+{
+	int64 quotient = value / divisor;
+
+	if ((value % divisor) != 0 && ((value < 0) != (divisor < 0)))
+		quotient--;
+	return quotient;
+}
+
+/*
+ * temporal_to_internal
+ *
+ * converts a date, time or timestamp value that debezium sends as a number of
+ * days or time units since epoch or midnight directly into PostgreSQL's internal
+ * representation: DateADT days or Timestamp microseconds since 2000-01-01, or
+ * TimeADT microseconds since midnight. The precision declared by the column's
+ * typemod is applied the same way the type input function would. Returns false
+ * if the value is out of range of the PostgreSQL type
+ */
+static bool
+temporal_to_internal(DBZ_DML_COLUMN_VALUE * colval, int64 * result)
+{
+	int64 input = strtoi64(colval->value, NULL, 10);
+	int64 unitsperusec = 0, usecsperunit = 0;
+
+	switch (colval->timerep)
+	{
+		case TIME_DATE:
+			/* days since epoch, scaled only if stored as a timestamp or time */
+			if (colval->datatype != DATEOID)
+				usecsperunit = USECS_PER_DAY;
+			break;
+		case TIME_TIMESTAMP:
+		case TIME_TIME:
+			/* milliseconds */
+			usecsperunit = 1000;
+			break;
+		case TIME_MICROTIMESTAMP:
+		case TIME_MICROTIME:
+			/* microseconds */
+			usecsperunit = 1;
+			break;
+		case TIME_NANOTIMESTAMP:
+		case TIME_NANOTIME:
+			/* nanoseconds */
+			unitsperusec = 1000;
+			break;
+		case TIME_UNDEF:
+		default:
+		{
+			set_shm_connector_errmsg(myConnectorId, "no time representation available to "
+					"process date/time value");
+			elog(ERROR, "no time representation available to process %s value",
+					format_type_be(colval->datatype));
+		}
+	}
+
+	if (usecsperunit > 1)
+	{
+		if (input > PG_INT64_MAX / usecsperunit || input < PG_INT64_MIN / usecsperunit)
+			return false;
+		input *= usecsperunit;
+	}
+	else if (unitsperusec > 1)
+		input = floor_div(input, unitsperusec);
+
+	/* input now holds days or microseconds since 1970-01-01 or midnight */
+	switch (colval->datatype)
+	{
+		case DATEOID:
+		{
+			int64 days = colval->timerep == TIME_DATE ? input :
+					floor_div(input, USECS_PER_DAY);
+
+			days -= (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE);
+			if (days < PG_INT32_MIN || days > PG_INT32_MAX || !IS_VALID_DATE((DateADT) days))
+				return false;
+			*result = days;
+			return true;
+		}
+		case TIMESTAMPOID:
+		{
+			Timestamp ts;
+
+			if (input < MIN_TIMESTAMP + (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * USECS_PER_DAY ||
+				input >= END_TIMESTAMP + (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * USECS_PER_DAY)
+				return false;
+
+			ts = input - (POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * USECS_PER_DAY;
+			if (!AdjustTimestampForTypmod(&ts, colval->typemod, NULL))
+				return false;
+			*result = ts;
+			return true;
+		}
+		case TIMEOID:
+		{
+			TimeADT time = input;
+
+			if (time < INT64CONST(0) || time > USECS_PER_DAY)
+				return false;
+
+			AdjustTimeForTypmod(&time, colval->typemod);
+			*result = time;
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+/*
+ * temporal_internal_to_text
+ *
+ * formats a value produced by temporal_to_internal() in ISO style with the
+ * encoders of the PostgreSQL date/time types, for the paths that need the
+ * value as text
+ */
+static char *
+temporal_internal_to_text(Oid datatype, int64 value)
+{
+	struct pg_tm tt, *tm = &tt;
+	fsec_t fsec = 0;
+	char buf[MAXDATELEN + 1];
+
+	switch (datatype)
 	{
-		value |= -((long) 1 << (len * 8));
+		case DATEOID:
+			j2date((int) value + POSTGRES_EPOCH_JDATE, &(tm->tm_year), &(tm->tm_mon), &(tm->tm_mday));
+			EncodeDateOnly(tm, USE_ISO_DATES, buf);
+			break;
+		case TIMESTAMPOID:
+			if (timestamp2tm((Timestamp) value, NULL, tm, &fsec, NULL, NULL) != 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+						 errmsg("timestamp out of range")));
+			EncodeDateTime(tm, fsec, false, 0, NULL, USE_ISO_DATES, buf);
+			break;
+		case TIMEOID:
+			time2tm((TimeADT) value, tm, &fsec);
+			EncodeTimeOnly(tm, fsec, false, 0, USE_ISO_DATES, buf);
+			break;
+		default:
+			elog(ERROR, "unexpected date/time type %u", datatype);
 	}
-	return value;
+	return pstrdup(buf);
 }
 
 /*
@@ -466,7 +777,7 @@ transform_data_expression(const char * remoteObjid, const char * colname)
 	 */
 	snprintf(key.extObjName, sizeof(key.extObjName), "%s.%s", remoteObjid, colname);
 	entry = (TransformExpressionHashEntry *) hash_search(transformExpressionHash, &key, HASH_FIND, &found);
-	if (!found)
+	if (!found || entry->pgsqlTransExpress[0] == '\0')
 	{
 		/* no object mapping found, so no transformation done */
 		elog(DEBUG1, "no data transformation needed for %s", key.extObjName);
@@ -481,6 +792,111 @@ transform_data_expression(const char * remoteObjid, const char * colname)
 	return res;
 }
 
+/*
+ * transform_data_function
+ *
+ * return the native transform function to run on the given column name based on
+ * the transform object rule definitions. The function is owned by the rules
+ */
+static TransformFunction *
+transform_data_function(const char * remoteObjid, const char * colname)
+{
+	TransformExpressionHashEntry * entry = NULL;
+	TransformExpressionHashKey key = {0};
+
+	if (!transformExpressionHash || !remoteObjid || !colname)
+		return NULL;
+
+	snprintf(key.extObjName, sizeof(key.extObjName), "%s.%s", remoteObjid, colname);
+	entry = (TransformExpressionHashEntry *) hash_search(transformExpressionHash, &key, HASH_FIND, NULL);
+	if (!entry || entry->function.kind == TRANSFORM_FUNC_NONE)
+		return NULL;
+
+	elog(DEBUG1, "%s needs data transformation with native function %d",
+			key.extObjName, entry->function.kind);
+	return &entry->function;
+}
+
+/*
+ * parseTransformFunction
+ *
+ * this function parses the transform_function value of a rule, written as
+ * name[:arg[:arg]], into func. Returns false if it is not a valid function
+ */
+static bool
+parseTransformFunction(const char * spec, TransformFunction * func)
+{
+	const char * args = strchr(spec, ':');
+	int namelen = args ? args - spec : strlen(spec);
+	char * end = NULL;
+
+	memset(func, 0, sizeof(TransformFunction));
+	if (args)
+		args++;
+
+	if (namelen == 5 && !strncasecmp(spec, "lower", namelen))
+		func->kind = TRANSFORM_FUNC_LOWER;
+	else if (namelen == 5 && !strncasecmp(spec, "upper", namelen))
+		func->kind = TRANSFORM_FUNC_UPPER;
+	else if (namelen == 3 && !strncasecmp(spec, "md5", namelen))
+		func->kind = TRANSFORM_FUNC_MD5;
+	else if (namelen == 8 && !strncasecmp(spec, "geometry", namelen))
+		func->kind = TRANSFORM_FUNC_GEOMETRY;
+	else if (namelen == 8 && !strncasecmp(spec, "constant", namelen))
+	{
+		/* the rest is the value, colons included */
+		if (!args)
+			return false;
+		func->kind = TRANSFORM_FUNC_CONSTANT;
+		strlcpy(func->strarg, args, sizeof(func->strarg));
+		return true;
+	}
+	else if (namelen == 9 && !strncasecmp(spec, "substring", namelen))
+	{
+		/* substring:start[:length], start counts from 1 like SQL substring */
+		if (!args)
+			return false;
+		func->kind = TRANSFORM_FUNC_SUBSTRING;
+		func->arg1 = strtol(args, &end, 10);
+		func->arg2 = -1;
+		if (end == args || func->arg1 < 1)
+			return false;
+		if (*end == ':')
+		{
+			args = end + 1;
+			func->arg2 = strtol(args, &end, 10);
+			if (end == args || func->arg2 < 0)
+				return false;
+		}
+		return *end == '\0';
+	}
+	else if (namelen == 4 && !strncasecmp(spec, "mask", namelen))
+	{
+		/* mask[:keep[:char]], keep the last characters and mask the others */
+		func->kind = TRANSFORM_FUNC_MASK;
+		func->arg1 = 0;
+		strlcpy(func->strarg, "*", sizeof(func->strarg));
+		if (!args)
+			return true;
+		func->arg1 = strtol(args, &end, 10);
+		if (end == args || func->arg1 < 0)
+			return false;
+		if (*end == ':')
+		{
+			if (end[1] == '\0' || end[2] != '\0')
+				return false;
+			strlcpy(func->strarg, end + 1, sizeof(func->strarg));
+			return true;
+		}
+		return *end == '\0';
+	}
+	else
+		return false;
+
+	/* the functions without arguments */
+	return args == NULL;
+}
+
 /*
  * transform_object_name
  *
@@ -644,208 +1060,331 @@ populate_primary_keys(StringInfoData * strinfo, const char * id, const char * js
 }
 
 /*
- * getPathElementString
+ * compileJsonPath
  *
- * Function to get a string element from a JSONB path
+ * this function parses a dot separated JSON path into the text keys taken by
+ * jsonb_get_element(). Compiled paths are cached so each distinct path is only
+ * parsed once; the returned handle stays valid for the life of the worker
  */
-static int
-getPathElementString(Jsonb * jb, char * path, StringInfoData * strinfoout, bool removequotes)
+static CompiledJsonPath *
+compileJsonPath(const char * path)
 {
-	Datum * datum_elems = NULL;
-	char * str_elems = NULL, * p = path;
-	int numPaths = 0, curr = 0;
-	char * pathcopy = pstrdup(path);
-	Datum res;
-	bool isnull;
+	CompiledJsonPath * cpath;
+	MemoryContext oldContext;
+	char * pathcopy, * str_elems;
+	bool found = false;
+	int numPaths = 1;
+	const char * p;
 
-	if (!strinfoout)
+	if (!jsonPathHash)
 	{
-		elog(WARNING, "strinfo is null");
-		return -1;
+		HASHCTL info;
+
+		info.keysize = SYNCHDB_JSON_PATH_SIZE;
+		info.entrysize = sizeof(CompiledJsonPath);
+		info.hcxt = TopMemoryContext;
+
+		jsonPathHash = hash_create("compiled json path hash",
+								   256,
+								   &info,
+								   HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
 	}
 
-    /* Count the number of elements in the path */
-	if (strstr(pathcopy, "."))
+	if (strlen(path) < SYNCHDB_JSON_PATH_SIZE)
 	{
-		while (*p != '\0')
-		{
-			if (*p == '.')
-			{
-				numPaths++;
-			}
-			p++;
-		}
-		numPaths++; /* Add the last one */
+		cpath = (CompiledJsonPath *) hash_search(jsonPathHash, path, HASH_ENTER, &found);
+		if (found)
+			return cpath;
+
+		/* keep compiled keys around as long as the hash */
+		oldContext = MemoryContextSwitchTo(TopMemoryContext);
 	}
 	else
 	{
-		numPaths = 1;
+		/* too long to be cached, compile it for this use only */
+		cpath = (CompiledJsonPath *) palloc0(sizeof(CompiledJsonPath));
+		oldContext = CurrentMemoryContext;
 	}
 
-	datum_elems = palloc0(sizeof(Datum) * numPaths);
-
-    /* Parse the path into elements */
-	if (strstr(pathcopy, "."))
-	{
-		str_elems= strtok(pathcopy, ".");
-		if (str_elems)
-		{
-			datum_elems[curr] = CStringGetTextDatum(str_elems);
-			curr++;
-			while ((str_elems = strtok(NULL, ".")))
-			{
-				datum_elems[curr] = CStringGetTextDatum(str_elems);
-				curr++;
-			}
-		}
-	}
-	else
+	/* count how many elements are in path */
+	for (p = path; *p != '\0'; p++)
 	{
-		/* only one level, just use pathcopy*/
-		datum_elems[curr] = CStringGetTextDatum(pathcopy);
+		if (*p == '.')
+			numPaths++;
 	}
 
-    /* Get the element from JSONB */
-    res = jsonb_get_element(jb, datum_elems, numPaths, &isnull, false);
-    if (isnull)
-    {
-    	resetStringInfo(strinfoout);
-    	appendStringInfoString(strinfoout, "NULL");
-    	elog(DEBUG1, "%s = NULL", path);
-    }
-    else
-    {
-    	Jsonb *resjb = DatumGetJsonbP(res);
-    	resetStringInfo(strinfoout);
-		JsonbToCString(strinfoout, &resjb->root, VARSIZE(resjb));
-
-		/*
-		 * note: buf.data includes double quotes and escape char \.
-		 * We need to remove them
-		 */
-		if (removequotes)
-			remove_double_quotes(strinfoout);
-
-		if (resjb)
-			pfree(resjb);
-		elog(DEBUG1, "%s = %s", path, strinfoout->data);
-    }
+	cpath->elems = palloc0(sizeof(Datum) * numPaths);
+	cpath->nelems = 0;
 
-	pfree(datum_elems);
+	pathcopy = pstrdup(path);
+	for (str_elems = strtok(pathcopy, "."); str_elems; str_elems = strtok(NULL, "."))
+		cpath->elems[cpath->nelems++] = CStringGetTextDatum(str_elems);
 	pfree(pathcopy);
-	return 0;
+
+	MemoryContextSwitchTo(oldContext);
+	return cpath;
 }
 
 /*
- * getPathElementJsonb
+ * getCompiledPathElement
  *
- * Function to get a JSONB element from a path
+ * this function looks up the element at a compiled path, with key appended as
+ * one more path element if given. Returns NULL if there is no such element
  */
 static Jsonb *
-getPathElementJsonb(Jsonb * jb, char * path)
+getCompiledPathElement(Jsonb * jb, CompiledJsonPath * cpath, const char * key)
 {
-	Datum * datum_elems = NULL;
-	char * str_elems = NULL, * p = path;
-	int numPaths = 0, curr = 0;
-	char * pathcopy = pstrdup(path);
+	Datum * elems = cpath->elems;
+	int nelems = cpath->nelems;
 	bool isnull;
-	Datum datout;
-	Jsonb * out = NULL;
+	Datum res;
 
-	if (strstr(pathcopy, "."))
-	{
-		/* count how many elements are in path*/
-		while (*p != '\0')
-		{
-			if (*p == '.')
-			{
-				numPaths++;
-			}
-			p++;
-		}
-		/* add the last one */
-		numPaths++;
-	}
-	else
+	if (key)
 	{
-		numPaths = 1;
+		elems = palloc(sizeof(Datum) * (nelems + 1));
+		memcpy(elems, cpath->elems, sizeof(Datum) * nelems);
+		elems[nelems++] = CStringGetTextDatum(key);
 	}
 
-	datum_elems = palloc0(sizeof(Datum) * numPaths);
-
-	if (strstr(pathcopy, "."))
-	{
-		/* multi level paths, */
-		str_elems= strtok(pathcopy, ".");
-		if (str_elems)
-		{
-			datum_elems[curr] = CStringGetTextDatum(str_elems);
-			curr++;
-			while (str_elems)
-			{
-				/* parse the remaining elements */
-				str_elems = strtok(NULL, ".");
-
-				if (str_elems == NULL)
-					break;
+	res = jsonb_get_element(jb, elems, nelems, &isnull, false);
 
-				datum_elems[curr] = CStringGetTextDatum(str_elems);
-				curr++;
-			}
-		}
-	}
-	else
+	if (key)
 	{
-		/* only one level, just use pathcopy*/
-		datum_elems[curr] = CStringGetTextDatum(pathcopy);
+		pfree(DatumGetPointer(elems[nelems - 1]));
+		pfree(elems);
 	}
-	datout = jsonb_get_element(jb, datum_elems, numPaths, &isnull, false);
-	if (isnull)
-		out = NULL;
-	else
-		out = DatumGetJsonbP(datout);
-
-	pfree(datum_elems);
-	pfree(pathcopy);
-	return out;
+	return isnull ? NULL : DatumGetJsonbP(res);
 }
 
 /*
- * destroyDBZDDL
+ * getCompiledPathElementString
  *
- * Function to destroy DBZ_DDL structure
+ * Function to get a string element from a compiled JSONB path, see
+ * getCompiledPathElement() for key
  */
-static void
-destroyDBZDDL(DBZ_DDL * ddlinfo)
+static int
+getCompiledPathElementString(Jsonb * jb, CompiledJsonPath * cpath, const char * key,
+		StringInfoData * strinfoout, bool removequotes)
 {
-	if (ddlinfo)
+	Jsonb * resjb;
+
+	if (!strinfoout)
 	{
-		if (ddlinfo->id)
-			pfree(ddlinfo->id);
+		elog(WARNING, "strinfo is null");
+		return -1;
+	}
 
-		if (ddlinfo->type)
-			pfree(ddlinfo->type);
+	resjb = getCompiledPathElement(jb, cpath, key);
+	resetStringInfo(strinfoout);
+	if (!resjb)
+	{
+		appendStringInfoString(strinfoout, "NULL");
+		return 0;
+	}
 
-		if (ddlinfo->primaryKeyColumnNames)
-			pfree(ddlinfo->primaryKeyColumnNames);
+	JsonbToCString(strinfoout, &resjb->root, VARSIZE(resjb));
 
-		list_free_deep(ddlinfo->columns);
+	/*
+	 * note: buf.data includes double quotes and escape char \.
+	 * We need to remove them
+	 */
+	if (removequotes)
+		remove_double_quotes(strinfoout);
 
-		pfree(ddlinfo);
-	}
+	pfree(resjb);
+	return 0;
 }
 
 /*
- * destroyPGDDL
+ * getPathElementString
  *
- * Function to destroy PG_DDL structure
+ * Function to get a string element from a JSONB path
  */
-static void
-destroyPGDDL(PG_DDL * ddlinfo)
+static int
+getPathElementString(Jsonb * jb, char * path, StringInfoData * strinfoout, bool removequotes)
 {
-	if (ddlinfo)
-	{
-		if (ddlinfo->ddlquery)
+	int ret;
+
+	ret = getCompiledPathElementString(jb, compileJsonPath(path), NULL, strinfoout, removequotes);
+	if (ret == 0)
+		elog(DEBUG1, "%s = %s", path, strinfoout->data);
+	return ret;
+}
+
+/*
+ * runTransformFunction
+ *
+ * this function runs a native transform function on the given data and returns
+ * the result as a palloc-ed string
+ */
+static char *
+runTransformFunction(const TransformFunction * func, const char * in)
+{
+	switch (func->kind)
+	{
+		case TRANSFORM_FUNC_LOWER:
+			return str_tolower(in, strlen(in), DEFAULT_COLLATION_OID);
+		case TRANSFORM_FUNC_UPPER:
+			return str_toupper(in, strlen(in), DEFAULT_COLLATION_OID);
+		case TRANSFORM_FUNC_SUBSTRING:
+		{
+			const char * start = in;
+			const char * end;
+			int i;
+
+			for (i = 1; i < func->arg1 && *start; i++)
+				start += pg_mblen(start);
+
+			end = start;
+			if (func->arg2 < 0)
+				end += strlen(start);
+			else
+			{
+				for (i = 0; i < func->arg2 && *end; i++)
+					end += pg_mblen(end);
+			}
+			return pnstrdup(start, end - start);
+		}
+		case TRANSFORM_FUNC_MD5:
+		{
+			char hexsum[MD5_PASSWD_LEN + 1];
+			const char * errstr = NULL;
+
+			if (!pg_md5_hash(in, strlen(in), hexsum, &errstr))
+				elog(ERROR, "could not compute MD5 hash: %s", errstr);
+			return pstrdup(hexsum);
+		}
+		case TRANSFORM_FUNC_MASK:
+		{
+			StringInfoData strinfo;
+			int nchars = pg_mbstrlen(in);
+			const char * tail = in;
+			int i;
+
+			initStringInfo(&strinfo);
+			for (i = 0; i < nchars - func->arg1; i++)
+			{
+				appendStringInfoChar(&strinfo, func->strarg[0]);
+				tail += pg_mblen(tail);
+			}
+			appendStringInfoString(&strinfo, tail);
+			return strinfo.data;
+		}
+		case TRANSFORM_FUNC_CONSTANT:
+			return pstrdup(func->strarg);
+		case TRANSFORM_FUNC_GEOMETRY:
+		{
+			/*
+			 * {"wkb": "<base64>", "srid": n} to hex EWKB, which PostGIS geometry
+			 * input accepts: the WKB with the SRID flag set in its type and the
+			 * SRID after it, both in the byte order of the WKB
+			 */
+			StringInfoData strinfo;
+			Jsonb * jb;
+			char * wkb;
+			char * ewkb;
+			char * out;
+			int wkblen;
+			int srid;
+			uint32 type;
+			bool little;
+
+			if (!strstr(in, "\"wkb\""))
+				return pstrdup(in);
+
+			jb = DatumGetJsonbP(DirectFunctionCall1(jsonb_in, CStringGetDatum(in)));
+			initStringInfo(&strinfo);
+			if (getPathElementString(jb, "wkb", &strinfo, true) || !strcasecmp(strinfo.data, "null"))
+				return pstrdup(in);
+
+			wkb = palloc(pg_b64_dec_len(strinfo.len));
+			wkblen = pg_b64_decode(strinfo.data, strinfo.len, wkb, pg_b64_dec_len(strinfo.len));
+			if (wkblen < 5)
+				elog(ERROR, "invalid wkb in geometry value '%s'", in);
+
+			srid = 0;
+			if (getPathElementString(jb, "srid", &strinfo, true) == 0 &&
+				strcasecmp(strinfo.data, "null"))
+				srid = atoi(strinfo.data);
+
+			little = (wkb[0] == 1);
+			memcpy(&type, wkb + 1, sizeof(uint32));
+			type = little ? pg_le32toh(type) : pg_be32toh(type);
+
+			if (srid == 0 || (type & 0x20000000))
+			{
+				out = palloc(wkblen * 2 + 1);
+				out[hex_encode(wkb, wkblen, out)] = '\0';
+				return out;
+			}
+
+			type |= 0x20000000;
+			ewkb = palloc(wkblen + sizeof(int32));
+			ewkb[0] = wkb[0];
+			type = little ? pg_htole32(type) : pg_htobe32(type);
+			memcpy(ewkb + 1, &type, sizeof(uint32));
+			srid = little ? (int32) pg_htole32((uint32) srid) : (int32) pg_htobe32((uint32) srid);
+			memcpy(ewkb + 5, &srid, sizeof(int32));
+			memcpy(ewkb + 9, wkb + 5, wkblen - 5);
+
+			out = palloc((wkblen + sizeof(int32)) * 2 + 1);
+			out[hex_encode(ewkb, wkblen + sizeof(int32), out)] = '\0';
+			pfree(wkb);
+			pfree(ewkb);
+			return out;
+		}
+		default:
+			return pstrdup(in);
+	}
+}
+
+/*
+ * getPathElementJsonb
+ *
+ * Function to get a JSONB element from a path
+ */
+static Jsonb *
+getPathElementJsonb(Jsonb * jb, char * path)
+{
+	return getCompiledPathElement(jb, compileJsonPath(path), NULL);
+}
+
+/*
+ * destroyDBZDDL
+ *
+ * Function to destroy DBZ_DDL structure
+ */
+static void
+destroyDBZDDL(DBZ_DDL * ddlinfo)
+{
+	if (ddlinfo)
+	{
+		if (ddlinfo->id)
+			pfree(ddlinfo->id);
+
+		if (ddlinfo->type)
+			pfree(ddlinfo->type);
+
+		if (ddlinfo->primaryKeyColumnNames)
+			pfree(ddlinfo->primaryKeyColumnNames);
+
+		list_free_deep(ddlinfo->columns);
+
+		pfree(ddlinfo);
+	}
+}
+
+/*
+ * destroyPGDDL
+ *
+ * Function to destroy PG_DDL structure
+ */
+static void
+destroyPGDDL(PG_DDL * ddlinfo)
+{
+	if (ddlinfo)
+	{
+		if (ddlinfo->ddlquery)
 			pfree(ddlinfo->ddlquery);
 		pfree(ddlinfo);
 	}
@@ -1592,6 +2131,241 @@ composeAlterColumnClauses(const char * objid, ConnectorType type, List * dbzcols
 	return ret;
 }
 
+/*
+ * freeDataCacheEntry
+ *
+ * this function frees everything a data cache entry holds except the entry itself
+ */
+static void
+freeDataCacheEntry(DataCacheEntry * cacheentry)
+{
+	if (cacheentry->typeidhash)
+		hash_destroy(cacheentry->typeidhash);
+
+	if (cacheentry->columnhash)
+	{
+		HASH_SEQ_STATUS status;
+		DataCacheColumn * column;
+
+		hash_seq_init(&status, cacheentry->columnhash);
+		while ((column = (DataCacheColumn *) hash_seq_search(&status)) != NULL)
+		{
+			if (column->transformExpression)
+				pfree(column->transformExpression);
+		}
+		hash_destroy(cacheentry->columnhash);
+	}
+
+	if (cacheentry->columnorder)
+		pfree(cacheentry->columnorder);
+
+	if (cacheentry->columnInputs)
+		pfree(cacheentry->columnInputs);
+
+	bms_free(cacheentry->keyattrs);
+
+	if (cacheentry->tupdesc)
+		FreeTupleDesc(cacheentry->tupdesc);
+
+	cacheentry->valid = false;
+	cacheentry->tupdesc = NULL;
+	cacheentry->tableoid = InvalidOid;
+	cacheentry->typeidhash = NULL;
+	cacheentry->remoteObjectId[0] = '\0';
+	cacheentry->columnhash = NULL;
+	cacheentry->columnorder = NULL;
+	cacheentry->ncolumnorder = 0;
+	cacheentry->columnInputs = NULL;
+	cacheentry->crossRowConstraints = false;
+}
+
+/*
+ * removeDataCacheEntry
+ *
+ * this function frees and removes the data cache entry of the given table if exists
+ */
+static void
+removeDataCacheEntry(DataCacheKey * cachekey)
+{
+	DataCacheEntry * cacheentry;
+
+	cacheentry = (DataCacheEntry *) hash_search(dataCacheHash, cachekey, HASH_FIND, NULL);
+	if (cacheentry)
+	{
+		freeDataCacheEntry(cacheentry);
+		hash_search(dataCacheHash, cachekey, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * invalidateDataCacheCallback
+ *
+ * relcache invalidation callback that marks the data cache entries of the given
+ * relation, or of all relations if relid is InvalidOid, as invalid. They are
+ * rebuilt the next time they are looked up. Nothing is freed here because the
+ * callback may run while a change event still refers to the entry
+ */
+static void
+invalidateDataCacheCallback(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	DataCacheEntry * cacheentry;
+
+	if (!dataCacheHash)
+		return;
+
+	dataCacheInvalCount++;
+
+	hash_seq_init(&status, dataCacheHash);
+	while ((cacheentry = (DataCacheEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (relid == InvalidOid || cacheentry->tableoid == relid)
+			cacheentry->valid = false;
+	}
+}
+
+/*
+ * enterDeferredPrimaryKey
+ *
+ * this function remembers pkquery as the statement that adds the deferred
+ * primary key of the table identified by key, replacing any earlier one
+ */
+static FastLoadHashEntry *
+enterDeferredPrimaryKey(DataCacheKey * key, const char * pkquery, ConnectorType type)
+{
+	FastLoadHashEntry * entry;
+	bool found = false;
+
+	if (!fastLoadHash)
+	{
+		HASHCTL info;
+
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(DataCacheKey);
+		info.entrysize = sizeof(FastLoadHashEntry);
+		info.hcxt = TopMemoryContext;
+
+		fastLoadHash = hash_create("snapshot fast load hash",
+								   64,
+								   &info,
+								   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = (FastLoadHashEntry *) hash_search(fastLoadHash, key, HASH_ENTER, &found);
+	if (found)
+		pfree(entry->pkquery);
+
+	entry->pkquery = MemoryContextStrdup(TopMemoryContext, pkquery);
+	entry->type = type;
+	return entry;
+}
+
+/*
+ * saveDeferredPrimaryKey
+ *
+ * this function appends a deferred primary key to the connector's fast load
+ * file, so it is still added if the worker stops before the snapshot ends. The
+ * file is only appended to while the connector runs and is removed once all of
+ * its keys are added and committed. Entries of tables that no longer exist or
+ * already have a primary key are skipped when the file is loaded again
+ */
+static void
+saveDeferredPrimaryKey(FastLoadHashEntry * entry)
+{
+	FILE * fp;
+	int32 len = strlen(entry->pkquery);
+
+	if (fastLoadFile[0] == '\0')
+		return;
+
+	fp = AllocateFile(fastLoadFile, PG_BINARY_A);
+	if (!fp)
+	{
+		set_shm_connector_errmsg(myConnectorId, "could not save deferred primary key");
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", fastLoadFile)));
+	}
+
+	if (fwrite(&entry->key, sizeof(DataCacheKey), 1, fp) != 1 ||
+		fwrite(&len, sizeof(int32), 1, fp) != 1 ||
+		fwrite(entry->pkquery, len, 1, fp) != 1 ||
+		fflush(fp) != 0 ||
+		pg_fsync(fileno(fp)) != 0)
+	{
+		int save_errno = errno;
+
+		FreeFile(fp);
+		errno = save_errno;
+		set_shm_connector_errmsg(myConnectorId, "could not save deferred primary key");
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", fastLoadFile)));
+	}
+
+	if (FreeFile(fp))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", fastLoadFile)));
+
+	/* the file may have just been created */
+	fsync_fname(SYNCHDB_METADATA_DIR, true);
+}
+
+/*
+ * deferPrimaryKey
+ *
+ * this function remembers the statement that adds the primary key of a table
+ * being created during initial snapshot in fast load mode. It returns false if
+ * the primary key should be created with the table as usual, which is the case
+ * if there is no primary key or if the table already exists. An existing table
+ * is left as is by CREATE TABLE IF NOT EXISTS, and a key deferred by an earlier
+ * run of the connector is added when the connector starts
+ */
+static bool
+deferPrimaryKey(DBZ_DDL * dbzddl, const char * schema, const char * table, ConnectorType type)
+{
+	StringInfoData pkinfo;
+	DataCacheKey key = {0};
+	FastLoadHashEntry * entry;
+	Oid schemaoid;
+	int j;
+
+	initStringInfo(&pkinfo);
+	populate_primary_keys(&pkinfo, dbzddl->id, dbzddl->primaryKeyColumnNames, true);
+	if (pkinfo.len == 0)
+	{
+		pfree(pkinfo.data);
+		return false;
+	}
+
+	strlcpy(key.schema, schema, sizeof(key.schema));
+	strlcpy(key.table, table, sizeof(key.table));
+	for (j = 0; j < strlen(key.schema); j++)
+		key.schema[j] = (char) pg_tolower((unsigned char) key.schema[j]);
+	for (j = 0; j < strlen(key.table); j++)
+		key.table[j] = (char) pg_tolower((unsigned char) key.table[j]);
+
+	/* the table may exist from an earlier run of the connector */
+	schemaoid = get_namespace_oid(key.schema, true);
+	if (OidIsValid(schemaoid) && OidIsValid(get_relname_relid(key.table, schemaoid)))
+	{
+		pfree(pkinfo.data);
+		return false;
+	}
+
+	/* populate_primary_keys() starts the clause with ", " */
+	entry = enterDeferredPrimaryKey(&key,
+			psprintf("ALTER TABLE %s.%s %s;", schema, table, pkinfo.data + 2), type);
+
+	/* must be on disk before the table is created without its primary key */
+	saveDeferredPrimaryKey(entry);
+
+	elog(DEBUG1, "deferred until end of initial snapshot: %s", entry->pkquery);
+	pfree(pkinfo.data);
+	return true;
+}
+
 /*
  * convert2PGDDL
  *
@@ -1610,6 +2384,8 @@ convert2PGDDL(DBZ_DDL * dbzddl, ConnectorType type)
 
 	if (!strcmp(dbzddl->type, "CREATE"))
 	{
+		char * pgschema = NULL, * pgtable = NULL;
+
 		mappedObjName = transform_object_name(dbzddl->id, "table");
 		if (mappedObjName)
 		{
@@ -1648,6 +2424,8 @@ convert2PGDDL(DBZ_DDL * dbzddl, ConnectorType type)
 				/* table stays as table but no schema */
 				appendStringInfo(&strinfo, "CREATE TABLE IF NOT EXISTS %s (", table);
 			}
+			pgschema = pstrdup(schema ? schema : "public");
+			pgtable = pstrdup(table);
 		}
 		else
 		{
@@ -1685,6 +2463,8 @@ convert2PGDDL(DBZ_DDL * dbzddl, ConnectorType type)
 			/* table stays as table, schema ignored */
 			appendStringInfo(&strinfo, "CREATE TABLE IF NOT EXISTS %s.%s (", db, table);
 
+			pgschema = pstrdup(db);
+			pgtable = pstrdup(table);
 			pfree(idcopy);
 		}
 
@@ -1737,16 +2517,23 @@ convert2PGDDL(DBZ_DDL * dbzddl, ConnectorType type)
 
 		/*
 		 * finally, declare primary keys if any. iterate dbzddl->primaryKeyColumnNames
-		 * and build into primary key(x, y, z) clauses. todo
+		 * and build into primary key(x, y, z) clauses. In snapshot fast load mode, the
+		 * primary key of a table created during initial snapshot is added after the
+		 * snapshot so rows are loaded without maintaining its index.
 		 */
-		populate_primary_keys(&strinfo, dbzddl->id, dbzddl->primaryKeyColumnNames, false);
+		if (!synchdb_snapshot_fast_load ||
+			get_shm_connector_stage_enum(myConnectorId) != STAGE_INITIAL_SNAPSHOT ||
+			!deferPrimaryKey(dbzddl, pgschema, pgtable, type))
+			populate_primary_keys(&strinfo, dbzddl->id, dbzddl->primaryKeyColumnNames, false);
 
 		appendStringInfo(&strinfo, ");");
+
+		pfree(pgschema);
+		pfree(pgtable);
 	}
 	else if (!strcmp(dbzddl->type, "DROP"))
 	{
 		DataCacheKey cachekey = {0};
-		bool found = false;
 
 		mappedObjName = transform_object_name(dbzddl->id, "table");
 		if (mappedObjName)
@@ -1806,8 +2593,25 @@ convert2PGDDL(DBZ_DDL * dbzddl, ConnectorType type)
 		/* drop data cache for schema.table if exists */
 		strlcpy(cachekey.schema, schema, SYNCHDB_CONNINFO_DB_NAME_SIZE);
 		strlcpy(cachekey.table, table, SYNCHDB_CONNINFO_DB_NAME_SIZE);
-		hash_search(dataCacheHash, &cachekey, HASH_REMOVE, &found);
+		removeDataCacheEntry(&cachekey);
 
+		/* a dropped table no longer needs its deferred primary key */
+		if (fastLoadHash)
+		{
+			FastLoadHashEntry * entry;
+
+			for (int j = 0; j < strlen(cachekey.schema); j++)
+				cachekey.schema[j] = (char) pg_tolower((unsigned char) cachekey.schema[j]);
+			for (int j = 0; j < strlen(cachekey.table); j++)
+				cachekey.table[j] = (char) pg_tolower((unsigned char) cachekey.table[j]);
+
+			entry = (FastLoadHashEntry *) hash_search(fastLoadHash, &cachekey, HASH_FIND, NULL);
+			if (entry)
+			{
+				pfree(entry->pkquery);
+				hash_search(fastLoadHash, &cachekey, HASH_REMOVE, NULL);
+			}
+		}
 	}
 	else if (!strcmp(dbzddl->type, "ALTER"))
 	{
@@ -1885,7 +2689,7 @@ convert2PGDDL(DBZ_DDL * dbzddl, ConnectorType type)
 		/* drop data cache for schema.table if exists */
 		strlcpy(cachekey.schema, schema, SYNCHDB_CONNINFO_DB_NAME_SIZE);
 		strlcpy(cachekey.table, table, SYNCHDB_CONNINFO_DB_NAME_SIZE);
-		hash_search(dataCacheHash, &cachekey, HASH_REMOVE, &found);
+		removeDataCacheEntry(&cachekey);
 
 		/*
 		 * For ALTER, we must obtain the current schema in PostgreSQL and identify
@@ -2077,14 +2881,17 @@ convert2PGDDL(DBZ_DDL * dbzddl, ConnectorType type)
  * processDataByType
  *
  * this function performs necessary data conversions to convert input data
- * as string and output a processed string based on type
+ * as string and output a processed string based on type. If pgcolval is given
+ * and data transforms are deferred, the transform expression is recorded in it
+ * instead of being evaluated
  */
 static char *
-processDataByType(DBZ_DML_COLUMN_VALUE * colval, bool addquote, char * remoteObjectId)
+processDataByType(DBZ_DML_COLUMN_VALUE * colval, bool addquote, char * remoteObjectId,
+		PG_DML_COLUMN_VALUE * pgcolval)
 {
 	char * out = NULL;
 	char * in = colval->value;
-	char * transformExpression = NULL;
+	char * transformExpression = colval->transformExpression;
 
 	if (!in || strlen(in) == 0)
 		return NULL;
@@ -2111,102 +2918,31 @@ processDataByType(DBZ_DML_COLUMN_VALUE * colval, bool addquote, char * remoteObj
 		case MONEYOID:
 		case NUMERICOID:
 		{
-			int newlen = 0, decimalpos = 0;
-			long value = 0;
-			char buffer[32] = {0};
 			int tmpoutlen = pg_b64_dec_len(strlen(in));
 			unsigned char * tmpout = (unsigned char *) palloc0(tmpoutlen + 1);
-
+			int scale = colval->scale;
 
 			tmpoutlen = pg_b64_decode(in, strlen(in), (char *)tmpout, tmpoutlen);
 
-			value = derive_value_from_byte(tmpout, tmpoutlen);
+			/* make scale = 4 to account for cents */
+			if (scale <= 0 && colval->datatype == MONEYOID)
+				scale = 4;
 
-			snprintf(buffer, sizeof(buffer), "%ld", value);
-			if (colval->scale > 0)
+			if (colval->datatype == NUMERICOID && pgcolval &&
+				!transformExpression && !colval->transformFunction)
 			{
-				if (strlen(buffer) > colval->scale)
-				{
-					/* ex: 123 -> 1.23*/
-					newlen = strlen(buffer) + 1;	/* plus 1 decimal */
-					out = (char *) palloc0(newlen + 1);	/* plus 1 terminating null */
-					decimalpos = strlen(buffer) - colval->scale;
-					strncpy(out, buffer, decimalpos);
-					out[decimalpos] = '.';
-					strcpy(out + decimalpos + 1, buffer + decimalpos);
-				}
-				else if (strlen(buffer) == colval->scale)
-				{
-					/* ex: 123 -> 0.123 */
-					newlen = strlen(buffer) + 2;	/* plus 1 decimal and 1 zero */
-					out = (char *) palloc0(newlen + 1);	/* plus 1 terminating null */
-					snprintf(out, newlen + 1, "0.%s", buffer);
-				}
-				else
-				{
-					/* ex: 1 -> 0.001*/
-					int scale_factor = 1, i = 0;
-					double res = 0.0;
-
-					/* plus 1 decimal and 1 zero and the zeros as a result of left shift */
-					newlen = strlen(buffer) + (colval->scale - strlen(buffer)) + 2;
-					out = (char *) palloc0(newlen + 1);	/* plus 1 terminating null */
-
-					for (i = 0; i< colval->scale; i++)
-						scale_factor *= 10;
-
-					res = (double)value / (double)scale_factor;
-					snprintf(out, newlen + 1, "%g", res);
-				}
+				/*
+				 * heap apply stores the Numeric in the slot directly. The value
+				 * as received identifies it when rows are compared
+				 */
+				pgcolval->hasInternalValue = true;
+				pgcolval->numericValue = numeric_from_unscaled_bytes(tmpout, tmpoutlen,
+						scale, colval->typemod);
+				pfree(tmpout);
+				return pstrdup(in);
 			}
-			else
-			{
-				/* make scale = 4 to account for cents */
-				if (colval->datatype == MONEYOID)
-				{
-					colval->scale = 4;
-					if (strlen(buffer) > colval->scale)
-					{
-						newlen = strlen(buffer) + 1;	/* plus 1 decimal */
-						out = (char *) palloc0(newlen + 1);	/* plus 1 terminating null */
-
-						decimalpos = strlen(buffer) - colval->scale;
-						strncpy(out, buffer, decimalpos);
-						out[decimalpos] = '.';
-						strcpy(out + decimalpos + 1, buffer + decimalpos);
-					}
-					else if (strlen(buffer) == colval->scale)
-					{
-						/* ex: 123 -> 0.123 */
-						newlen = strlen(buffer) + 2;	/* plus 1 decimal and 1 zero */
-						out = (char *) palloc0(newlen + 1);	/* plus 1 terminating null */
-						snprintf(out, newlen + 1, "0.%s", buffer);
-					}
-					else
-					{
-						/* ex: 1 -> 0.001*/
-						int scale_factor = 1, i = 0;
-						double res = 0.0;
-
-						/* plus 1 decimal and 1 zero and the zeros as a result of left shift */
-						newlen = strlen(buffer) + (colval->scale - strlen(buffer)) + 2;
-						out = (char *) palloc0(newlen + 1);	/* plus 1 terminating null */
-
-						for (i = 0; i< colval->scale; i++)
-							scale_factor *= 10;
-
-						res = (double)value / (double)scale_factor;
-						snprintf(out, newlen + 1, "%g", res);
-					}
 
-				}
-				else
-				{
-					newlen = strlen(buffer);	/* no decimal */
-					out = (char *) palloc0(newlen + 1);
-					strlcpy(out, buffer, newlen + 1);
-				}
-			}
+			out = decimal_from_unscaled_bytes(tmpout, tmpoutlen, scale);
 			pfree(tmpout);
 			break;
 		}
@@ -2267,237 +3003,75 @@ processDataByType(DBZ_DML_COLUMN_VALUE * colval, bool addquote, char * remoteObj
 			break;
 		}
 		case DATEOID:
+		case TIMESTAMPOID:
+		case TIMEOID:
 		{
 			/*
 			 * we need to process these time related values based on the timerep
-			 * that has been determined during the parsing stage
+			 * that has been determined during the parsing stage. They are converted
+			 * straight into PostgreSQL's internal representation without going
+			 * through text
 			 */
-			long long input = atoll(in);
-			time_t dayssinceepoch = 0;
-			struct tm epoch = {0};
-			time_t epoch_time, target_time;
-			struct tm *target_date;
-			char datestr[10 + 1]; /* YYYY-MM-DD */
-
-			switch (colval->timerep)
+			int64 internal = 0;
+
+			if (colval->timerep == TIME_ZONEDTIMESTAMP)
 			{
-				case TIME_DATE:
-					/* number of days since epoch, no conversion needed */
-					dayssinceepoch = (time_t) input;
-					break;
-				case TIME_TIMESTAMP:
-					/* number of milliseconds since epoch - convert to days since epoch */
-					dayssinceepoch = (time_t)(input / 86400000LL);
-					break;
-				case TIME_MICROTIMESTAMP:
-					/* number of microseconds since epoch - convert to days since epoch */
-					dayssinceepoch = (time_t)(input / 86400000000LL);
-					break;
-				case TIME_NANOTIMESTAMP:
-					/* number of microseconds since epoch - convert to days since epoch */
-					dayssinceepoch = (time_t)(input / 86400000000000LL);
-					break;
-				case TIME_UNDEF:
-				default:
+				/*
+				 * sent as string - just treat it like a string and skip the
+				 * rest of processing logic
+				 */
+				if (addquote)
 				{
-					set_shm_connector_errmsg(myConnectorId, "no time representation available to"
-							"process DATEOID value");
-					elog(ERROR, "no time representation available to process DATEOID value");
+					out = escapeSingleQuote(in, addquote);
+				}
+				else
+				{
+					out = (char *) palloc0(strlen(in) + 1);
+					strlcpy(out, in, strlen(in) + 1);
 				}
-			}
-
-			/* since 1970-01-01 */
-			epoch.tm_year = 70;
-			epoch.tm_mon = 0;
-			epoch.tm_mday = 1;
 
-			epoch_time = mktime(&epoch);
-			target_time = epoch_time + (dayssinceepoch * 24 * 60 * 60);
+				/* skip the rest of processing */
+				return out;
+			}
 
-			/*
-			 * Convert to struct tm in GMT timezone for now
-			 * todo: convert to local timezone?
-			 */
-			target_date = gmtime(&target_time);
-			strftime(datestr, sizeof(datestr), "%Y-%m-%d", target_date);
+			if (!temporal_to_internal(colval, &internal))
+			{
+				set_shm_connector_errmsg(myConnectorId, "date/time value out of range");
+				ereport(ERROR,
+						(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+						 errmsg("%s value %s of column %s is out of range",
+								format_type_be(colval->datatype), in, colval->name)));
+			}
 
-			if (addquote)
+			if (pgcolval && !transformExpression && !colval->transformFunction)
 			{
-				out = (char *) palloc0(strlen(datestr) + 2 + 1);
-				snprintf(out, strlen(datestr) + 2 + 1, "'%s'", datestr);
+				/*
+				 * heap apply stores the internal value in the slot directly. The
+				 * value as received identifies it when rows are compared
+				 */
+				pgcolval->hasInternalValue = true;
+				pgcolval->internalValue = internal;
+				return pstrdup(in);
 			}
-			else
+
+			out = temporal_internal_to_text(colval->datatype, internal);
+			if (addquote)
 			{
-				out = (char *) palloc0(strlen(datestr) + 1);
-				strlcpy(out, datestr,strlen(datestr) + 1);
+				char * quoted = psprintf("'%s'", out);
+
+				pfree(out);
+				out = quoted;
 			}
 			break;
 		}
-		case TIMESTAMPOID:
+		case BYTEAOID:
 		{
-			/*
-			 * we need to process these time related values based on the timerep
-			 * that has been determined during the parsing stage
-			 */
-			long long input = atoll(in);
-			time_t seconds = 0, remains = 0;
-			struct tm *tm_info;
-			char timestamp[26 + 1] = {0};	/* yyyy-MM-ddThh:mm:ss.xxxxxx */
+			int tmpoutlen = pg_b64_dec_len(strlen(in));
+			unsigned char * tmpout = (unsigned char *) palloc0(tmpoutlen);
 
-			switch (colval->timerep)
-			{
-				case TIME_TIMESTAMP:
-					/* milliseconds since epoch - convert to seconds since epoch */
-					seconds = (time_t)(input / 1000);
-					remains = input % 1000;
-					break;
-				case TIME_MICROTIMESTAMP:
-					/* microseconds since epoch - convert to seconds since epoch */
-					seconds = (time_t)(input / 1000 / 1000);
-					remains = input % 1000000;
-					break;
-				case TIME_NANOTIMESTAMP:
-					/* microseconds since epoch - convert to seconds since epoch */
-					seconds = (time_t)(input / 1000 / 1000 / 1000);
-					remains = input % 1000000000;
-					break;
-				case TIME_ZONEDTIMESTAMP:
-					/*
-					 * sent as string - just treat it like a string and skip the
-					 * rest of processing logic
-					 */
-					if (addquote)
-					{
-						out = escapeSingleQuote(in, addquote);
-					}
-					else
-					{
-						out = (char *) palloc0(strlen(in) + 1);
-						strlcpy(out, in, strlen(in) + 1);
-					}
-
-					/* skip the rest of processing */
-					return out;
-				case TIME_UNDEF:
-				default:
-				{
-					set_shm_connector_errmsg(myConnectorId, "no time representation available to"
-							"process TIMESTAMPOID value");
-					elog(ERROR, "no time representation available to process TIMESTAMPOID value");
-				}
-			}
-			tm_info = gmtime(&seconds);
-
-			if (colval->typemod > 0)
-			{
-				/*
-				 * it means we could include additional precision to timestamp. PostgreSQL
-				 * supports up to 6 digits of precision. We always put 6, PostgreSQL will
-				 * round it up or down as defined by table schema
-				 */
-				snprintf(timestamp, sizeof(timestamp), "%04d-%02d-%02dT%02d:%02d:%02d.%06ld",
-						tm_info->tm_year + 1900,
-						tm_info->tm_mon + 1,
-						tm_info->tm_mday,
-						tm_info->tm_hour,
-						tm_info->tm_min,
-						tm_info->tm_sec,
-						remains);
-			}
-			else
-			{
-				snprintf(timestamp, sizeof(timestamp), "%04d-%02d-%02dT%02d:%02d:%02d",
-						tm_info->tm_year + 1900,
-						tm_info->tm_mon + 1,
-						tm_info->tm_mday,
-						tm_info->tm_hour,
-						tm_info->tm_min,
-						tm_info->tm_sec);
-			}
-
-			if (addquote)
-			{
-				out = (char *) palloc0(strlen(timestamp) + 2 + 1);
-				snprintf(out, strlen(timestamp) + 2 + 1, "'%s'", timestamp);
-			}
-			else
-			{
-				out = (char *) palloc0(strlen(timestamp) + 1);
-				strlcpy(out, timestamp, strlen(timestamp) + 1);
-			}
-			break;
-		}
-		case TIMEOID:
-		{
-			/*
-			 * we need to process these time related values based on the timerep
-			 * that has been determined during the parsing stage
-			 */
-			unsigned long long input = atoll(in);
-			time_t seconds = 0, remains = 0;
-			char time[15 + 1] = {0};	/* hh:mm:ss.xxxxxx */
-
-			switch(colval->timerep)
-			{
-				case TIME_TIME:
-					/* milliseconds since midnight - convert to seconds since midnight */
-					seconds = (time_t)(input / 1000);
-					remains = input % 1000;
-					break;
-				case TIME_MICROTIME:
-					/* microseconds since midnight - convert to seconds since midnight */
-					seconds = (time_t)(input / 1000 / 1000);
-					remains = input % 1000000;
-					break;
-				case TIME_NANOTIME:
-					/* nanoseconds since midnight - convert to seconds since midnight */
-					seconds = (time_t)(input / 1000 / 1000 / 1000);
-					remains = input % 1000000000;
-					break;
-				case TIME_UNDEF:
-				default:
-				{
-					set_shm_connector_errmsg(myConnectorId, "no time representation available to"
-							"process TIMEOID value");
-					elog(ERROR, "no time representation available to process TIMEOID value");
-				}
-			}
-			if (colval->typemod > 0)
-			{
-				snprintf(time, sizeof(time), "%02d:%02d:%02d.%06ld",
-						(int)((seconds / (60 * 60)) % 24),
-						(int)((seconds / 60) % 60),
-						(int)(seconds % 60),
-						remains);
-			}
-			else
-			{
-				snprintf(time, sizeof(time), "%02d:%02d:%02d",
-						(int)((seconds / (60 * 60)) % 24),
-						(int)((seconds / 60) % 60),
-						(int)(seconds % 60));
-			}
-
-			if (addquote)
-			{
-				out = (char *) palloc0(strlen(time) + 2 + 1);
-				snprintf(out, strlen(time) + 2 + 1, "'%s'", time);
-			}
-			else
-			{
-				out = (char *) palloc0(strlen(time) + 1);
-				strlcpy(out, time, strlen(time) + 1);
-			}
-			break;
-		}
-		case BYTEAOID:
-		{
-			int tmpoutlen = pg_b64_dec_len(strlen(in));
-			unsigned char * tmpout = (unsigned char *) palloc0(tmpoutlen);
-
-			tmpoutlen = pg_b64_decode(in, strlen(in), (char*)tmpout, tmpoutlen);
-
-			if (addquote)
+			tmpoutlen = pg_b64_decode(in, strlen(in), (char*)tmpout, tmpoutlen);
+
+			if (addquote)
 			{
 				/* hexstring + 2 single quotes + '\x' + terminating null */
 				out = (char *) palloc0((tmpoutlen * 2) + 2 + 2 + 1);
@@ -2539,13 +3113,48 @@ processDataByType(DBZ_DML_COLUMN_VALUE * colval, bool addquote, char * remoteObj
 		}
 	}
 
+	/*
+	 * native transform functions run first, directly on the data. A quoted value
+	 * made for SPI is transformed without its quotes and quoted again.
+	 */
+	if (colval->transformFunction && out)
+	{
+		char * transData;
+
+		if (addquote && out[0] == '\'')
+		{
+			StringInfoData unquoted;
+			char * sp;
+
+			initStringInfo(&unquoted);
+			for (sp = out + 1; *sp && sp[1]; sp++)
+			{
+				appendStringInfoChar(&unquoted, *sp);
+				if (*sp == '\'' && sp[1] == '\'')
+					sp++;
+			}
+			transData = runTransformFunction(colval->transformFunction, unquoted.data);
+			pfree(unquoted.data);
+			pfree(out);
+			out = escapeSingleQuote(transData, true);
+			pfree(transData);
+		}
+		else
+		{
+			transData = runTransformFunction(colval->transformFunction, out);
+			pfree(out);
+			out = transData;
+		}
+		elog(DEBUG1, "transformed remote column %s.%s's data with native function %d to '%s'",
+				remoteObjectId, colval->remoteColumnName, colval->transformFunction->kind, out);
+	}
+
 	/*
 	 * after the data is prepared, we need to check if we need to transform the data
-	 * with a user-defined expression by looking up against transformExpressionHash.
-	 * Note, we have to use colval->remoteColumnName to look up because colval->name
-	 * may have been transformed to something else.
+	 * with a user-defined expression. The expression is looked up when the column
+	 * value is made, using colval->remoteColumnName because colval->name may have
+	 * been transformed to something else.
 	 */
-	transformExpression = transform_data_expression(remoteObjectId, colval->remoteColumnName);
 	if (transformExpression)
 	{
 		StringInfoData strinfo;
@@ -2553,7 +3162,6 @@ processDataByType(DBZ_DML_COLUMN_VALUE * colval, bool addquote, char * remoteObj
 		Jsonb *jb;
 		char * wkb = NULL, * srid = NULL;
 		char * transData = NULL;
-		char * escapedData = NULL;
 
 		elog(DEBUG1, "transforming remote column %s.%s's data '%s' with expression '%s'",
 				remoteObjectId, colval->remoteColumnName, out, transformExpression);
@@ -2586,40 +3194,33 @@ processDataByType(DBZ_DML_COLUMN_VALUE * colval, bool addquote, char * remoteObj
 				srid = pstrdup(strinfo.data);
 
 			elog(DEBUG1,"wkb = %s, srid = %s", wkb, srid);
+		}
 
-			escapedData = escapeSingleQuote(out, false);
-			transData = ra_transformDataExpression(escapedData, wkb, srid, transformExpression);
-			if (transData)
-			{
-				elog(DEBUG1, "transformed remote column %s.%s's data '%s' to '%s' with expression '%s'",
-						remoteObjectId, colval->remoteColumnName, out, transData, transformExpression);
-
-				/* replace return value with transData */
-				pfree(out);
-				out = pstrdup(transData);
-				pfree(transData);
-				pfree(escapedData);
-			}
-			pfree(wkb);
-			pfree(srid);
+		if (pgcolval && ra_deferTransforms())
+		{
+			/* transformed together with the other values of the batch, see ra_executePGDML() */
+			pgcolval->transformExpression = transformExpression;
+			pgcolval->wkb = wkb;
+			pgcolval->srid = srid;
+			return out;
 		}
-		else
+
+		transData = ra_transformDataExpression(out, wkb, srid, transformExpression);
+		if (transData)
 		{
-			/* regular data - no handling needed */
-			escapedData = escapeSingleQuote(out, false);
-			transData = ra_transformDataExpression(escapedData, NULL, NULL, transformExpression);
-			if (transData)
-			{
-				elog(DEBUG1, "transformed remote column %s.%s's data '%s' to '%s' with expression '%s'",
-						remoteObjectId, colval->remoteColumnName, out, transData, transformExpression);
+			elog(DEBUG1, "transformed remote column %s.%s's data '%s' to '%s' with expression '%s'",
+					remoteObjectId, colval->remoteColumnName, out, transData, transformExpression);
 
-				/* replace return value with transData */
-				pfree(out);
-				out = pstrdup(transData);
-				pfree(transData);
-				pfree(escapedData);
-			}
+			/* replace return value with transData */
+			pfree(out);
+			out = pstrdup(transData);
+			pfree(transData);
 		}
+
+		if (wkb)
+			pfree(wkb);
+		if (srid)
+			pfree(srid);
 	}
 	return out;
 }
@@ -2660,6 +3261,8 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 	/* copy identification data to PG_DML */
 	pgdml->op = dbzdml->op;
 	pgdml->tableoid = dbzdml->tableoid;
+	pgdml->columnInputs = dbzdml->columnInputs;
+	pgdml->ncolumnInputs = dbzdml->ncolumnInputs;
 
 	switch(dbzdml->op)
 	{
@@ -2682,7 +3285,7 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 				foreach(cell, dbzdml->columnValuesAfter)
 				{
 					DBZ_DML_COLUMN_VALUE * colval = (DBZ_DML_COLUMN_VALUE *) lfirst(cell);
-					char * data = processDataByType(colval, true, dbzdml->remoteObjectId);
+					char * data = processDataByType(colval, true, dbzdml->remoteObjectId, NULL);
 
 					if (data != NULL)
 					{
@@ -2708,7 +3311,7 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 					DBZ_DML_COLUMN_VALUE * colval = (DBZ_DML_COLUMN_VALUE *) lfirst(cell);
 					PG_DML_COLUMN_VALUE * pgcolval = palloc0(sizeof(PG_DML_COLUMN_VALUE));
 
-					char * data = processDataByType(colval, false, dbzdml->remoteObjectId);
+					char * data = processDataByType(colval, false, dbzdml->remoteObjectId, pgcolval);
 
 					if (data != NULL)
 					{
@@ -2739,7 +3342,7 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 					char * data;
 
 					appendStringInfo(&strinfo, "%s = ", colval->name);
-					data = processDataByType(colval, true, dbzdml->remoteObjectId);
+					data = processDataByType(colval, true, dbzdml->remoteObjectId, NULL);
 					if (data != NULL)
 					{
 						appendStringInfo(&strinfo, "%s", data);
@@ -2765,7 +3368,7 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 					DBZ_DML_COLUMN_VALUE * colval = (DBZ_DML_COLUMN_VALUE *) lfirst(cell);
 					PG_DML_COLUMN_VALUE * pgcolval = palloc0(sizeof(PG_DML_COLUMN_VALUE));
 
-					char * data = processDataByType(colval, false, dbzdml->remoteObjectId);
+					char * data = processDataByType(colval, false, dbzdml->remoteObjectId, pgcolval);
 
 					if (data != NULL)
 					{
@@ -2796,7 +3399,7 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 					char * data;
 
 					appendStringInfo(&strinfo, "%s = ", colval->name);
-					data = processDataByType(colval, true, dbzdml->remoteObjectId);
+					data = processDataByType(colval, true, dbzdml->remoteObjectId, NULL);
 					if (data != NULL)
 					{
 						appendStringInfo(&strinfo, "%s,", data);
@@ -2818,7 +3421,7 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 					char * data;
 
 					appendStringInfo(&strinfo, "%s = ", colval->name);
-					data = processDataByType(colval, true, dbzdml->remoteObjectId);
+					data = processDataByType(colval, true, dbzdml->remoteObjectId, NULL);
 					if (data != NULL)
 					{
 						appendStringInfo(&strinfo, "%s", data);
@@ -2847,7 +3450,7 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 					PG_DML_COLUMN_VALUE * pgcolval_after = palloc0(sizeof(PG_DML_COLUMN_VALUE));
 					PG_DML_COLUMN_VALUE * pgcolval_before = palloc0(sizeof(PG_DML_COLUMN_VALUE));
 
-					char * data = processDataByType(colval_after, false, dbzdml->remoteObjectId);
+					char * data = processDataByType(colval_after, false, dbzdml->remoteObjectId, pgcolval_after);
 
 					if (data != NULL)
 					{
@@ -2861,7 +3464,7 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 					pgcolval_after->position = colval_after->position;
 					pgdml->columnValuesAfter = lappend(pgdml->columnValuesAfter, pgcolval_after);
 
-					data = processDataByType(colval_before, false, dbzdml->remoteObjectId);
+					data = processDataByType(colval_before, false, dbzdml->remoteObjectId, pgcolval_before);
 					if (data != NULL)
 					{
 						pgcolval_before->value = pstrdup(data);
@@ -2895,37 +3498,52 @@ convert2PGDML(DBZ_DML * dbzdml, ConnectorType type)
 }
 
 /*
- * get_additional_parameters
+ * timerep_from_name
  *
- * this function fetches additional parameters from Jsonb based on the given column data types
+ * this function maps the semantic type name of a Debezium field to a TimeRep
  */
-static void
-get_additional_parameters(Jsonb * jb, DBZ_DML_COLUMN_VALUE * colval, bool isbefore, int pos)
+static TimeRep
+timerep_from_name(char * name)
 {
-	StringInfoData strinfo;
-	char path[SYNCHDB_JSON_PATH_SIZE] = {0};
+	if (find_exact_string_match(name, "io.debezium.time.Date"))
+		return TIME_DATE;
+	else if (find_exact_string_match(name, "io.debezium.time.Time"))
+		return TIME_TIME;
+	else if (find_exact_string_match(name, "io.debezium.time.MicroTime"))
+		return TIME_MICROTIME;
+	else if (find_exact_string_match(name, "io.debezium.time.NanoTime"))
+		return TIME_NANOTIME;
+	else if (find_exact_string_match(name, "io.debezium.time.Timestamp"))
+		return TIME_TIMESTAMP;
+	else if (find_exact_string_match(name, "io.debezium.time.MicroTimestamp"))
+		return TIME_MICROTIMESTAMP;
+	else if (find_exact_string_match(name, "io.debezium.time.NanoTimestamp"))
+		return TIME_NANOTIMESTAMP;
+	else if (find_exact_string_match(name, "io.debezium.time.ZonedTimestamp"))
+		return TIME_ZONEDTIMESTAMP;
+
+	return TIME_UNDEF;
+}
 
-	if (!colval || !colval->name || colval->datatype == InvalidOid)
+/*
+ * set_additional_parameters
+ *
+ * this function sets additional parameters of a column value based on its data type
+ * from the schema field describing it. field can be NULL if the schema does not
+ * describe this column, in which case no scale and no time representation is set
+ */
+static void
+set_additional_parameters(DBZ_DML_COLUMN_VALUE * colval, const DbzSchemaField * field)
+{
+	if (!colval || colval->datatype == InvalidOid)
 		return;
 
-	initStringInfo(&strinfo);
-
 	switch (colval->datatype)
 	{
 		case NUMERICOID:
 		{
-			/* spcial numeric case: need to obtain scale and precision from json */
-			elog(DEBUG1, "numeric: retrieving additional scale and precision parameters");
-
-			snprintf(path, SYNCHDB_JSON_PATH_SIZE, "schema.fields.%d.fields.%d.parameters.scale",
-					isbefore ? 0 : 1, pos);
-
-			getPathElementString(jb, path, &strinfo, true);
-
-			if (!strcasecmp(strinfo.data, "NULL"))
-				colval->scale = -1;	/* has no scale */
-			else
-				colval->scale = atoi(strinfo.data);	/* has scale */
+			/* spcial numeric case: scale comes from the schema, none means an integer */
+			colval->scale = field && field->hasscale ? field->scale : 0;
 			break;
 		}
 		case DATEOID:
@@ -2933,121 +3551,168 @@ get_additional_parameters(Jsonb * jb, DBZ_DML_COLUMN_VALUE * colval, bool isbefo
 		case TIMESTAMPOID:
 		case TIMETZOID:
 		{
-			snprintf(path, SYNCHDB_JSON_PATH_SIZE, "schema.fields.%d.fields.%d.name",
-					isbefore ? 0 : 1, pos);
-
-			getPathElementString(jb, path, &strinfo, true);
-
-			if (!strcasecmp(strinfo.data, "NULL"))
-				colval->timerep = TIME_UNDEF;	/* has no specific representation */
-			else
-			{
-				if (find_exact_string_match(strinfo.data, "io.debezium.time.Date"))
-					colval->timerep = TIME_DATE;
-				else if (find_exact_string_match(strinfo.data, "io.debezium.time.Time"))
-					colval->timerep = TIME_TIME;
-				else if (find_exact_string_match(strinfo.data, "io.debezium.time.MicroTime"))
-					colval->timerep = TIME_MICROTIME;
-				else if (find_exact_string_match(strinfo.data, "io.debezium.time.NanoTime"))
-					colval->timerep = TIME_NANOTIME;
-				else if (find_exact_string_match(strinfo.data, "io.debezium.time.Timestamp"))
-					colval->timerep = TIME_TIMESTAMP;
-				else if (find_exact_string_match(strinfo.data, "io.debezium.time.MicroTimestamp"))
-					colval->timerep = TIME_MICROTIMESTAMP;
-				else if (find_exact_string_match(strinfo.data, "io.debezium.time.NanoTimestamp"))
-					colval->timerep = TIME_NANOTIMESTAMP;
-				else if (find_exact_string_match(strinfo.data, "io.debezium.time.ZonedTimestamp"))
-					colval->timerep = TIME_ZONEDTIMESTAMP;
-				else
-					colval->timerep = TIME_UNDEF;
-				elog(DEBUG1, "timerep %d", colval->timerep);
-			}
+			colval->timerep = field ? field->timerep : TIME_UNDEF;
+			elog(DEBUG1, "timerep %d", colval->timerep);
 			break;
 		}
 		default:
 			break;
 	}
-	if(strinfo.data)
-		pfree(strinfo.data);
 }
 
 /*
- * parseDBZDML
+ * buildSchemaCacheEntry
  *
- * this function parses a Jsonb that represents DML operation and produce a DBZ_DML structure
+ * this function parses the fields array of the 'after' struct of a schema section
+ * and saves it in schema cache under the given fingerprint. The 'after' struct
+ * describes the same columns as 'before'.
  */
-static DBZ_DML *
-parseDBZDML(Jsonb * jb, char op, ConnectorType type)
+static DbzSchemaCacheEntry *
+buildSchemaCacheEntry(uint64 fingerprint, Jsonb * fieldsjb)
 {
-	StringInfoData strinfo, objid;
-	Jsonb * dmlpayload = NULL;
-	JsonbIterator *it;
+	JsonbIterator * it;
 	JsonbValue v;
 	JsonbIteratorToken r;
-	char * key = NULL;
-	char * value = NULL;
-	DBZ_DML * dbzdml = NULL;
-	DBZ_DML_COLUMN_VALUE * colval = NULL;
+	DbzSchemaCacheEntry * entry;
+	DbzSchemaField * fields;
+	MemoryContext oldContext;
+	int nfields, i = 0;
+	bool found;
+
+	if (!fieldsjb || !JB_ROOT_IS_ARRAY(fieldsjb))
+		return NULL;
+
+	nfields = JB_ROOT_COUNT(fieldsjb);
+
+	oldContext = MemoryContextSwitchTo(TopMemoryContext);
+	fields = (DbzSchemaField *) palloc0(sizeof(DbzSchemaField) * (nfields + 1));
+	MemoryContextSwitchTo(oldContext);
+
+	it = JsonbIteratorInit(&fieldsjb->root);
+	while ((r = JsonbIteratorNext(&it, &v, true)) != WJB_DONE)
+	{
+		JsonbValue * fieldval, * nameval, * paramsval, * scaleval = NULL;
+
+		if (r != WJB_ELEM || v.type != jbvBinary || i >= nfields)
+			continue;
+
+		fieldval = getKeyJsonValueFromContainer(v.val.binary.data, "field", strlen("field"), NULL);
+		nameval = getKeyJsonValueFromContainer(v.val.binary.data, "name", strlen("name"), NULL);
+		paramsval = getKeyJsonValueFromContainer(v.val.binary.data, "parameters", strlen("parameters"), NULL);
+		if (paramsval && paramsval->type == jbvBinary)
+			scaleval = getKeyJsonValueFromContainer(paramsval->val.binary.data, "scale", strlen("scale"), NULL);
+
+		if (fieldval && fieldval->type == jbvString)
+			fields[i].name = MemoryContextStrdup(TopMemoryContext,
+					pnstrdup(fieldval->val.string.val, fieldval->val.string.len));
+		else
+			fields[i].name = MemoryContextStrdup(TopMemoryContext, "");
+
+		fields[i].hasscale = true;
+		if (scaleval && scaleval->type == jbvString)
+			fields[i].scale = atoi(pnstrdup(scaleval->val.string.val, scaleval->val.string.len));
+		else if (scaleval && scaleval->type == jbvNumeric)
+			fields[i].scale = DatumGetInt32(DirectFunctionCall1(numeric_int4,
+					PointerGetDatum(scaleval->val.numeric)));
+		else
+		{
+			fields[i].scale = 0;
+			fields[i].hasscale = false;
+		}
+
+		if (nameval && nameval->type == jbvString)
+			fields[i].timerep = timerep_from_name(pnstrdup(nameval->val.string.val, nameval->val.string.len));
+		else
+			fields[i].timerep = TIME_UNDEF;	/* has no specific representation */
+		i++;
+	}
+
+	entry = (DbzSchemaCacheEntry *) hash_search(jsonSchemaCacheHash, &fingerprint, HASH_ENTER, &found);
+	entry->nfields = i;
+	entry->fields = fields;
+
+	elog(DEBUG1, "cached schema " UINT64_FORMAT " with %d fields", fingerprint, i);
+	return entry;
+}
+
+/*
+ * getJsonSchemaCacheEntry
+ *
+ * this function returns the schema information of a Jsonb change event from
+ * schema cache. The cache is keyed by a hash of the event's schema section so
+ * the schema is only parsed the first time a table version is seen.
+ */
+static DbzSchemaCacheEntry *
+getJsonSchemaCacheEntry(Jsonb * jb)
+{
+	JsonbValue * schemaval;
+	DbzSchemaCacheEntry * entry;
+	uint64 fingerprint;
+
+	schemaval = getKeyJsonValueFromContainer(&jb->root, "schema", strlen("schema"), NULL);
+	if (!schemaval || schemaval->type != jbvBinary)
+		return NULL;
+
+	/* the schema section is hashed as is, in its binary jsonb form */
+	fingerprint = hash_bytes_extended((const unsigned char *) schemaval->val.binary.data,
+			schemaval->val.binary.len, 0);
+
+	entry = (DbzSchemaCacheEntry *) hash_search(jsonSchemaCacheHash, &fingerprint, HASH_FIND, NULL);
+	if (entry)
+		return entry;
+
+	return buildSchemaCacheEntry(fingerprint, getPathElementJsonb(jb, "schema.fields.1.fields"));
+}
+
+/*
+ * getSchemaField
+ *
+ * this function returns the schema field at the given position, or NULL if
+ * there is no such field
+ */
+static const DbzSchemaField *
+getSchemaField(DbzSchemaCacheEntry * schemaentry, int pos)
+{
+	if (!schemaentry || pos < 0 || pos >= schemaentry->nfields)
+		return NULL;
+
+	return &schemaentry->fields[pos];
+}
+
+/*
+ * resolveDMLTarget
+ *
+ * this function derives the remote and the mapped object IDs of a DML event from
+ * its source db, schema and table names, makes sure the target table exists in
+ * PostgreSQL and returns the cached apply plan of that table
+ */
+static DataCacheEntry *
+resolveDMLTarget(DBZ_DML * dbzdml, const char * db, const char * schema, const char * table)
+{
+	StringInfoData objid;
 	Oid schemaoid;
 	Relation rel;
 	TupleDesc tupdesc;
 	int attnum, j = 0;
 
-	HTAB * typeidhash;
 	HASHCTL hash_ctl;
 	NameOidEntry * entry;
 	bool found;
 	DataCacheKey cachekey = {0};
 	DataCacheEntry * cacheentry;
+	uint64 invalcount;
+	MemoryContext oldcontext;
 
-	/* these are the components that compose of an object ID before transformation */
-	char * db = NULL, * schema = NULL, * table = NULL;
-
-	initStringInfo(&strinfo);
 	initStringInfo(&objid);
-
-	dbzdml = (DBZ_DML *) palloc0(sizeof(DBZ_DML));
-
-	/* fetch database - required */
-	getPathElementString(jb, "payload.source.db", &strinfo, true);
-	if (!strcasecmp(strinfo.data, "NULL"))
-	{
-		elog(WARNING, "malformed DML change request - no database attribute specified");
-		destroyDBZDML(dbzdml);
-
-		if(strinfo.data)
-			pfree(strinfo.data);
-
-		return NULL;
-	}
-	db = pstrdup(strinfo.data);
 	appendStringInfo(&objid, "%s.", db);
 
-	/* fetch schema - optional */
-	getPathElementString(jb, "payload.source.schema", &strinfo, true);
-	if (strcasecmp(strinfo.data, "NULL"))
-	{
-		/* append schema to objid if present */
-		schema = pstrdup(strinfo.data);
+	/* append schema to objid if present */
+	if (schema)
 		appendStringInfo(&objid, "%s.", schema);
-	}
-
-	/* fetch table - required */
-	getPathElementString(jb, "payload.source.table", &strinfo, true);
-	if (!strcasecmp(strinfo.data, "NULL") || !strcasecmp(strinfo.data, "dbzsignal"))
-	{
-		elog(WARNING, "malformed DML change request - no table attribute specified");
-		destroyDBZDML(dbzdml);
-
-		if(strinfo.data)
-			pfree(strinfo.data);
 
-		return NULL;
-	}
-	table = pstrdup(strinfo.data);
 	appendStringInfo(&objid, "%s", table);
 
-	dbzdml->remoteObjectId = pstrdup(objid.data);
+	dbzdml->remoteObjectId = objid.data;
 
 	dbzdml->mappedObjectId = transform_object_name(objid.data, "table");
 	if (dbzdml->mappedObjectId)
@@ -3056,7 +3721,7 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 		char * db2 = NULL, * table2 = NULL, * schema2 = NULL;
 
 		splitIdString(objectIdCopy, &db2, &schema2, &table2, false);
-		if (!table)
+		if (!table2)
 		{
 			/* save the error */
 			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
@@ -3076,41 +3741,19 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 		else
 			dbzdml->schema = pstrdup("public");
 
-		if (table2)
-			dbzdml->table = pstrdup(table2);
+		dbzdml->table = pstrdup(table2);
 	}
 	else
 	{
 		/* by default, remote's db is mapped to schema in pg */
 		dbzdml->schema = pstrdup(db);
 		dbzdml->table = pstrdup(table);
-
-		resetStringInfo(&strinfo);
-		appendStringInfo(&strinfo, "%s.%s", dbzdml->schema, dbzdml->table);
-		dbzdml->mappedObjectId = pstrdup(strinfo.data);
+		dbzdml->mappedObjectId = psprintf("%s.%s", dbzdml->schema, dbzdml->table);
 
 		/* use the untransformed object id and components */
 		elog(DEBUG1, "no object ID transformation done for '%s'",
 				dbzdml->mappedObjectId);
 	}
-	/* free the temporary pointers */
-	if (db)
-	{
-		pfree(db);
-		db = NULL;
-	}
-	if (schema)
-	{
-		pfree(schema);
-		db = NULL;
-	}
-	if (table)
-	{
-		pfree(table);
-		db = NULL;
-	}
-
-	dbzdml->op = op;
 
 	/*
 	 * before parsing, we need to make sure the target namespace and table
@@ -3130,93 +3773,380 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 	strlcpy(cachekey.table, dbzdml->table, sizeof(cachekey.table));
 
 	cacheentry = (DataCacheEntry *) hash_search(dataCacheHash, &cachekey, HASH_ENTER, &found);
-	if (found)
+	if (found && cacheentry->valid)
 	{
-		/* use the cached data type hash for lookup later */
-		typeidhash = cacheentry->typeidhash;
+		/* use the cached apply plan for lookup later */
 		dbzdml->tableoid = cacheentry->tableoid;
+		dbzdml->columnInputs = cacheentry->columnInputs;
+		dbzdml->ncolumnInputs = cacheentry->tupdesc->natts;
+		return cacheentry;
+	}
+
+	if (found)
+	{
+		/* the table has changed since it was cached, build it again */
+		elog(DEBUG1, "rebuilding data cache for %s.%s", dbzdml->schema, dbzdml->table);
+		freeDataCacheEntry(cacheentry);
 	}
 	else
 	{
-		schemaoid = get_namespace_oid(dbzdml->schema, false);
-		if (!OidIsValid(schemaoid))
-		{
-			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
-			snprintf(msg, SYNCHDB_ERRMSG_SIZE, "no valid OID found for schema '%s'", dbzdml->schema);
-			set_shm_connector_errmsg(myConnectorId, msg);
+		memset((char *) cacheentry + sizeof(DataCacheKey), 0,
+				sizeof(DataCacheEntry) - sizeof(DataCacheKey));
+	}
 
-			/* trigger pg's error shutdown routine */
-			elog(ERROR, "%s", msg);
-		}
+	/* an invalidation received while building makes the new entry invalid too */
+	invalcount = dataCacheInvalCount;
 
-		dbzdml->tableoid = get_relname_relid(dbzdml->table, schemaoid);
-		if (!OidIsValid(dbzdml->tableoid))
-		{
-			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
-			snprintf(msg, SYNCHDB_ERRMSG_SIZE, "no valid OID found for table '%s'", dbzdml->table);
-			set_shm_connector_errmsg(myConnectorId, msg);
+	schemaoid = get_namespace_oid(dbzdml->schema, false);
+	if (!OidIsValid(schemaoid))
+	{
+		char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
+		snprintf(msg, SYNCHDB_ERRMSG_SIZE, "no valid OID found for schema '%s'", dbzdml->schema);
+		set_shm_connector_errmsg(myConnectorId, msg);
 
-			/* trigger pg's error shutdown routine */
-			elog(ERROR, "%s", msg);
-		}
+		/* trigger pg's error shutdown routine */
+		elog(ERROR, "%s", msg);
+	}
 
-		elog(DEBUG1, "namespace %s.%s has PostgreSQL OID %d", dbzdml->schema, dbzdml->table, dbzdml->tableoid);
+	dbzdml->tableoid = get_relname_relid(dbzdml->table, schemaoid);
+	if (!OidIsValid(dbzdml->tableoid))
+	{
+		char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
+		snprintf(msg, SYNCHDB_ERRMSG_SIZE, "no valid OID found for table '%s'", dbzdml->table);
+		set_shm_connector_errmsg(myConnectorId, msg);
 
-		/* populate cached information */
-		strlcpy(cacheentry->key.schema, dbzdml->schema, sizeof(cachekey.schema));
-		strlcpy(cacheentry->key.table, dbzdml->table, sizeof(cachekey.table));
-		cacheentry->tableoid = dbzdml->tableoid;
+		/* trigger pg's error shutdown routine */
+		elog(ERROR, "%s", msg);
+	}
 
-		/* prepare a cached hash table for datatype look up with column name */
-		memset(&hash_ctl, 0, sizeof(hash_ctl));
-		hash_ctl.keysize = NAMEDATALEN;
-		hash_ctl.entrysize = sizeof(NameOidEntry);
-		hash_ctl.hcxt = TopMemoryContext;
+	elog(DEBUG1, "namespace %s.%s has PostgreSQL OID %d", dbzdml->schema, dbzdml->table, dbzdml->tableoid);
 
-		cacheentry->typeidhash = hash_create("Name to OID Hash Table",
-											 512, // limit to 512 columns max
-											 &hash_ctl,
-											 HASH_ELEM | HASH_CONTEXT);
+	/* populate cached information */
+	strlcpy(cacheentry->key.schema, dbzdml->schema, sizeof(cachekey.schema));
+	strlcpy(cacheentry->key.table, dbzdml->table, sizeof(cachekey.table));
+	cacheentry->tableoid = dbzdml->tableoid;
 
-		/* point to the cached datatype hash */
-		typeidhash = cacheentry->typeidhash;
+	/* prepare a cached hash table for datatype look up with column name */
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = NAMEDATALEN;
+	hash_ctl.entrysize = sizeof(NameOidEntry);
+	hash_ctl.hcxt = TopMemoryContext;
 
-		/*
-		 * get the column data type IDs for all columns from PostgreSQL catalog
-		 * The type IDs are stored in typeidhash temporarily for the parser
-		 * below to look up
-		 */
-		rel = table_open(dbzdml->tableoid, NoLock);
-		tupdesc = RelationGetDescr(rel);
+	cacheentry->typeidhash = hash_create("Name to OID Hash Table",
+										 512, // limit to 512 columns max
+										 &hash_ctl,
+										 HASH_ELEM | HASH_CONTEXT);
 
-		/* cache tupdesc */
-		cacheentry->tupdesc = CreateTupleDescCopy(tupdesc);
+	/*
+	 * get the column data type IDs for all columns from PostgreSQL catalog
+	 * The type IDs are stored in typeidhash temporarily for the parser
+	 * below to look up
+	 */
+	rel = table_open(dbzdml->tableoid, NoLock);
+	tupdesc = RelationGetDescr(rel);
 
-		for (attnum = 1; attnum <= tupdesc->natts; attnum++)
-		{
-			Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
-			elog(DEBUG2, "column %d: name %s, type %u, length %d",
-					attnum,
-					NameStr(attr->attname),
-					attr->atttypid,
-					attr->attlen);
+	/* cache tupdesc */
+	cacheentry->tupdesc = CreateTupleDescCopy(tupdesc);
 
-			entry = (NameOidEntry *) hash_search(typeidhash, NameStr(attr->attname), HASH_ENTER, &found);
-			if (!found)
-			{
-				strncpy(entry->name, NameStr(attr->attname), NAMEDATALEN);
-				entry->oid = attr->atttypid;
-				entry->position = attnum;
-				entry->typemod = attr->atttypmod;
-				elog(DEBUG2, "Inserted name '%s' with OID %u and position %d", entry->name, entry->oid, entry->position);
-			}
-			else
-			{
-				elog(DEBUG2, "Name '%s' already exists with OID %u and position %d", entry->name, entry->oid, entry->position);
-			}
+	/*
+	 * the column plan maps remote column names to their PostgreSQL column, type
+	 * information and transform expression. It is filled as columns are seen
+	 */
+	strlcpy(cacheentry->remoteObjectId, dbzdml->remoteObjectId, sizeof(cacheentry->remoteObjectId));
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = SYNCHDB_OBJ_NAME_SIZE;
+	hash_ctl.entrysize = sizeof(DataCacheColumn);
+	hash_ctl.hcxt = TopMemoryContext;
+
+	cacheentry->columnhash = hash_create("Remote column plan Hash Table",
+										 64,
+										 &hash_ctl,
+										 HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+
+	cacheentry->ncolumnorder = tupdesc->natts;
+	cacheentry->columnorder = (DataCacheColumn **) MemoryContextAllocZero(TopMemoryContext,
+			sizeof(DataCacheColumn *) * Max(tupdesc->natts, 1));
+	cacheentry->columnInputs = (PG_DML_COLUMN_INPUT *) MemoryContextAllocZero(TopMemoryContext,
+			sizeof(PG_DML_COLUMN_INPUT) * Max(tupdesc->natts, 1));
+
+	for (attnum = 1; attnum <= tupdesc->natts; attnum++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+		PG_DML_COLUMN_INPUT * colinput = &cacheentry->columnInputs[attnum - 1];
+		Oid typinput;
+
+		/* resolve the type input function once instead of once per row */
+		if (!attr->attisdropped)
+		{
+			getTypeInputInfo(attr->atttypid, &typinput, &colinput->typioparam);
+			fmgr_info_cxt(typinput, &colinput->finfo, TopMemoryContext);
+			colinput->typmod = attr->atttypmod;
 		}
-		table_close(rel, NoLock);
+
+		elog(DEBUG2, "column %d: name %s, type %u, length %d",
+				attnum,
+				NameStr(attr->attname),
+				attr->atttypid,
+				attr->attlen);
+
+		entry = (NameOidEntry *) hash_search(cacheentry->typeidhash, NameStr(attr->attname), HASH_ENTER, &found);
+		if (!found)
+		{
+			strncpy(entry->name, NameStr(attr->attname), NAMEDATALEN);
+			entry->oid = attr->atttypid;
+			entry->position = attnum;
+			entry->typemod = attr->atttypmod;
+			elog(DEBUG2, "Inserted name '%s' with OID %u and position %d", entry->name, entry->oid, entry->position);
+		}
+		else
+		{
+			elog(DEBUG2, "Name '%s' already exists with OID %u and position %d", entry->name, entry->oid, entry->position);
+		}
+	}
+
+	/* replica identity columns decide which apply worker a change goes to */
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	cacheentry->keyattrs = RelationGetIndexAttrBitmap(rel, INDEX_ATTR_BITMAP_IDENTITY_KEY);
+	MemoryContextSwitchTo(oldcontext);
+	cacheentry->crossRowConstraints = ra_hasCrossRowConstraints(rel);
+
+	table_close(rel, NoLock);
+
+	cacheentry->valid = (invalcount == dataCacheInvalCount);
+
+	dbzdml->columnInputs = cacheentry->columnInputs;
+	dbzdml->ncolumnInputs = cacheentry->tupdesc->natts;
+
+	return cacheentry;
+}
+
+/*
+ * getDataCacheColumn
+ *
+ * this function returns the column plan of a remote column from the table's apply
+ * plan, building it on first use. Columns tend to arrive in the same order event
+ * after event, so the position of the column in the event is tried first before
+ * falling back to a hash lookup. NULL is returned if the column cannot be cached
+ */
+static DataCacheColumn *
+getDataCacheColumn(DataCacheEntry * cacheentry, const char * remoteObjectId,
+		const char * colname, int ordinal)
+{
+	DataCacheColumn * column = NULL;
+	bool found = false;
+
+	/* the column plan is only valid for the remote object it is built for */
+	if (strcmp(cacheentry->remoteObjectId, remoteObjectId))
+		return NULL;
+
+	if (ordinal >= 0 && ordinal < cacheentry->ncolumnorder)
+	{
+		column = cacheentry->columnorder[ordinal];
+		if (column && !strcmp(column->remoteColumnName, colname))
+			return column;
+	}
+
+	if (strlen(colname) >= SYNCHDB_OBJ_NAME_SIZE)
+		return NULL;
+
+	column = (DataCacheColumn *) hash_search(cacheentry->columnhash, colname, HASH_ENTER, &found);
+	if (!found)
+	{
+		StringInfoData colNameObjId;
+		char * mappedColumnName = NULL;
+		char * expression = NULL;
+
+		/* transform the column name if needed */
+		initStringInfo(&colNameObjId);
+		appendStringInfo(&colNameObjId, "%s.%s", remoteObjectId, colname);
+		mappedColumnName = transform_object_name(colNameObjId.data, "column");
+		if (mappedColumnName)
+			elog(DEBUG1, "transformed column object ID '%s'to '%s'",
+					colNameObjId.data, mappedColumnName);
+
+		strlcpy(column->name, mappedColumnName ? mappedColumnName : colname, NAMEDATALEN);
+		pfree(colNameObjId.data);
+
+		/* look up its data type */
+		column->typeinfo = (NameOidEntry *) hash_search(cacheentry->typeidhash, column->name,
+				HASH_FIND, NULL);
+
+		/* and its data transform expression, looked up by the remote column name */
+		expression = transform_data_expression(remoteObjectId, colname);
+		if (expression)
+		{
+			column->transformExpression = MemoryContextStrdup(TopMemoryContext, expression);
+			pfree(expression);
+		}
+		else
+			column->transformExpression = NULL;
+
+		column->transformFunction = transform_data_function(remoteObjectId, colname);
+	}
+
+	if (ordinal >= 0 && ordinal < cacheentry->ncolumnorder)
+		cacheentry->columnorder[ordinal] = column;
+
+	return column;
+}
+
+/*
+ * makeDMLColumnValue
+ *
+ * this function creates a DBZ_DML_COLUMN_VALUE from a remote column name and its value,
+ * transforms the column name if needed and looks up its data type. *entry is set to the
+ * data type information found, or NULL if the column does not exist in PostgreSQL.
+ * ordinal is the position of the column in the change event
+ */
+static DBZ_DML_COLUMN_VALUE *
+makeDMLColumnValue(DBZ_DML * dbzdml, DataCacheEntry * cacheentry, const char * colname,
+		const char * value, int ordinal, NameOidEntry ** entry)
+{
+	DBZ_DML_COLUMN_VALUE * colval = NULL;
+	DataCacheColumn * column = NULL;
+	char * mappedColumnName = NULL;
+	StringInfoData colNameObjId;
+
+	colval = (DBZ_DML_COLUMN_VALUE *) palloc0(sizeof(DBZ_DML_COLUMN_VALUE));
+	colval->value = pstrdup(value);
+	/* a copy of original column name for expression rule lookup at later stage */
+	colval->remoteColumnName = pstrdup(colname);
+
+	column = getDataCacheColumn(cacheentry, dbzdml->remoteObjectId, colname, ordinal);
+	if (column)
+	{
+		colval->name = pstrdup(column->name);
+		colval->transformExpression = column->transformExpression;
+		colval->transformFunction = column->transformFunction;
+		*entry = column->typeinfo;
+		if (*entry)
+		{
+			colval->datatype = (*entry)->oid;
+			colval->position = (*entry)->position;
+			colval->typemod = (*entry)->typemod;
+		}
+		return colval;
+	}
+
+	colval->name = pstrdup(colname);
+
+	/* transform the column name if needed */
+	initStringInfo(&colNameObjId);
+	appendStringInfo(&colNameObjId, "%s.%s", dbzdml->remoteObjectId, colval->name);
+	mappedColumnName = transform_object_name(colNameObjId.data, "column");
+	if (mappedColumnName)
+	{
+		elog(DEBUG1, "transformed column object ID '%s'to '%s'",
+				colNameObjId.data, mappedColumnName);
+		/* replace the column name with looked up value here */
+		pfree(colval->name);
+		colval->name = pstrdup(mappedColumnName);
+	}
+	if (colNameObjId.data)
+		pfree(colNameObjId.data);
+
+	/* look up its data type */
+	*entry = (NameOidEntry *) hash_search(cacheentry->typeidhash, colval->name, HASH_FIND, NULL);
+	if (*entry)
+	{
+		colval->datatype = (*entry)->oid;
+		colval->position = (*entry)->position;
+		colval->typemod = (*entry)->typemod;
+	}
+	colval->transformExpression = transform_data_expression(dbzdml->remoteObjectId,
+			colval->remoteColumnName);
+	colval->transformFunction = transform_data_function(dbzdml->remoteObjectId,
+			colval->remoteColumnName);
+	return colval;
+}
+
+/*
+ * parseDBZDML
+ *
+ * this function parses a Jsonb that represents DML operation and produce a DBZ_DML structure
+ */
+static DBZ_DML *
+parseDBZDML(Jsonb * jb, char op, ConnectorType type)
+{
+	StringInfoData strinfo;
+	Jsonb * dmlpayload = NULL;
+	JsonbIterator *it;
+	JsonbValue v;
+	JsonbIteratorToken r;
+	char * key = NULL;
+	char * value = NULL;
+	DBZ_DML * dbzdml = NULL;
+	DBZ_DML_COLUMN_VALUE * colval = NULL;
+	DataCacheEntry * cacheentry;
+	NameOidEntry * entry;
+	DbzSchemaCacheEntry * schemaentry;
+	static CompiledJsonPath * dbpath = NULL, * schemapath = NULL, * tablepath = NULL;
+	static CompiledJsonPath * beforepath = NULL, * afterpath = NULL;
+
+	/* these are the components that compose of an object ID before transformation */
+	char * db = NULL, * schema = NULL, * table = NULL;
+
+	initStringInfo(&strinfo);
+
+	dbzdml = (DBZ_DML *) palloc0(sizeof(DBZ_DML));
+
+	/* paths used for every event are compiled once */
+	if (!dbpath)
+	{
+		dbpath = compileJsonPath("payload.source.db");
+		schemapath = compileJsonPath("payload.source.schema");
+		tablepath = compileJsonPath("payload.source.table");
+		beforepath = compileJsonPath("payload.before");
+		afterpath = compileJsonPath("payload.after");
+	}
+
+	/* fetch database - required */
+	getCompiledPathElementString(jb, dbpath, NULL, &strinfo, true);
+	if (!strcasecmp(strinfo.data, "NULL"))
+	{
+		elog(WARNING, "malformed DML change request - no database attribute specified");
+		destroyDBZDML(dbzdml);
+
+		if(strinfo.data)
+			pfree(strinfo.data);
+
+		return NULL;
+	}
+	db = pstrdup(strinfo.data);
+
+	/* fetch schema - optional */
+	getCompiledPathElementString(jb, schemapath, NULL, &strinfo, true);
+	if (strcasecmp(strinfo.data, "NULL"))
+		schema = pstrdup(strinfo.data);
+
+	/* fetch table - required */
+	getCompiledPathElementString(jb, tablepath, NULL, &strinfo, true);
+	if (!strcasecmp(strinfo.data, "NULL") || !strcasecmp(strinfo.data, "dbzsignal"))
+	{
+		elog(WARNING, "malformed DML change request - no table attribute specified");
+		destroyDBZDML(dbzdml);
+
+		if(strinfo.data)
+			pfree(strinfo.data);
+
+		return NULL;
 	}
+	table = pstrdup(strinfo.data);
+
+	dbzdml->op = op;
+
+	cacheentry = resolveDMLTarget(dbzdml, db, schema, table);
+
+	/* scale and time representation of columns come from the event's schema */
+	schemaentry = getJsonSchemaCacheEntry(jb);
+
+	/* free the temporary pointers */
+	pfree(db);
+	if (schema)
+		pfree(schema);
+	pfree(table);
+
 	switch(op)
 	{
 		case 'c':	/* create: data created after initial sync (INSERT) */
@@ -3247,7 +4177,7 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 			 * 	in this case, the parser will parse the entire sub element as string under the key "g"
 			 * 	in the above example.
 			 */
-			dmlpayload = getPathElementJsonb(jb, "payload.after");
+			dmlpayload = getCompiledPathElement(jb, afterpath, NULL);
 			if (dmlpayload)
 			{
 				int pause = 0;
@@ -3272,16 +4202,10 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 								pause = 0;
 								if (key)
 								{
-									int pathsize = strlen("payload.after.") + strlen(key) + 1;
-									char * tmpPath = (char *) palloc0 (pathsize);
-
 									elog(DEBUG1, "parse the entire sub element under %s as string", key);
 
-									snprintf(tmpPath, pathsize, "payload.after.%s", key);
-									getPathElementString(jb, tmpPath, &strinfo, false);
+									getCompiledPathElementString(jb, afterpath, key, &strinfo, false);
 									value = pstrdup(strinfo.data);
-									if(tmpPath)
-										pfree(tmpPath);
 								}
 							}
 							elog(DEBUG1, "end of object (%s) --------------------", key ? key : "null");
@@ -3351,39 +4275,10 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 					/* check if we have a key - value pair */
 					if (key != NULL && value != NULL)
 					{
-						char * mappedColumnName = NULL;
-						StringInfoData colNameObjId;
-
-						colval = (DBZ_DML_COLUMN_VALUE *) palloc0(sizeof(DBZ_DML_COLUMN_VALUE));
-						colval->name = pstrdup(key);
-						colval->value = pstrdup(value);
-						/* a copy of original column name for expression rule lookup at later stage */
-						colval->remoteColumnName = pstrdup(colval->name);
-
-						/* transform the column name if needed */
-						initStringInfo(&colNameObjId);
-						appendStringInfo(&colNameObjId, "%s.%s", objid.data, colval->name);
-						mappedColumnName = transform_object_name(colNameObjId.data, "column");
-						if (mappedColumnName)
-						{
-							elog(DEBUG1, "transformed column object ID '%s'to '%s'",
-									colNameObjId.data, mappedColumnName);
-							/* replace the column name with looked up value here */
-							pfree(colval->name);
-							colval->name = pstrdup(mappedColumnName);
-						}
-						if (colNameObjId.data)
-							pfree(colNameObjId.data);
-
-						/* look up its data type */
-						entry = (NameOidEntry *) hash_search(typeidhash, colval->name, HASH_FIND, &found);
-						if (found)
-						{
-							colval->datatype = entry->oid;
-							colval->position = entry->position;
-							colval->typemod = entry->typemod;
-							get_additional_parameters(jb, colval, false, entry->position - 1);
-						}
+						colval = makeDMLColumnValue(dbzdml, cacheentry, key, value,
+								list_length(dbzdml->columnValuesAfter), &entry);
+						if (entry)
+							set_additional_parameters(colval, getSchemaField(schemaentry, entry->position - 1));
 						else
 							elog(WARNING, "cannot find data type for column %s. None-existent column?", colval->name);
 
@@ -3412,7 +4307,7 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 			 * 		"after": null
 			 * 	}
 			 */
-			dmlpayload = getPathElementJsonb(jb, "payload.before");
+			dmlpayload = getCompiledPathElement(jb, beforepath, NULL);
 			if (dmlpayload)
 			{
 				int pause = 0;
@@ -3437,16 +4332,10 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 								pause = 0;
 								if (key)
 								{
-									int pathsize = strlen("payload.before.") + strlen(key) + 1;
-									char * tmpPath = (char *) palloc0 (pathsize);
-
 									elog(DEBUG1, "parse the entire sub element under %s as string", key);
 
-									snprintf(tmpPath, pathsize, "payload.before.%s", key);
-									getPathElementString(jb, tmpPath, &strinfo, false);
+									getCompiledPathElementString(jb, beforepath, key, &strinfo, false);
 									value = pstrdup(strinfo.data);
-									if(tmpPath)
-										pfree(tmpPath);
 								}
 							}
 							elog(DEBUG1, "end of object (%s) --------------------", key ? key : "null");
@@ -3516,41 +4405,10 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 					/* check if we have a key - value pair */
 					if (key != NULL && value != NULL)
 					{
-						char * mappedColumnName = NULL;
-						StringInfoData colNameObjId;
-
-						colval = (DBZ_DML_COLUMN_VALUE *) palloc0(sizeof(DBZ_DML_COLUMN_VALUE));
-						colval->name = pstrdup(key);
-						colval->value = pstrdup(value);
-						/* a copy of original column name for expression rule lookup at later stage */
-						colval->remoteColumnName = pstrdup(colval->name);
-
-						/* transform the column name if needed */
-						initStringInfo(&colNameObjId);
-						appendStringInfo(&colNameObjId, "%s.%s", objid.data, colval->name);
-						mappedColumnName = transform_object_name(colNameObjId.data, "column");
-
-						if (mappedColumnName)
-						{
-							elog(DEBUG1, "transformed column object ID '%s'to '%s'",
-									colNameObjId.data, mappedColumnName);
-							/* replace the column name with looked up value here */
-							pfree(colval->name);
-							colval->name = pstrdup(mappedColumnName);
-						}
-						if (colNameObjId.data)
-							pfree(colNameObjId.data);
-
-						/* look up its data type */
-						entry = (NameOidEntry *) hash_search(typeidhash, colval->name, HASH_FIND, &found);
-						if (found)
-						{
-							colval->datatype = entry->oid;
-							colval->position = entry->position;
-							colval->typemod = entry->typemod;
-
-							get_additional_parameters(jb, colval, true, entry->position - 1);
-						}
+						colval = makeDMLColumnValue(dbzdml, cacheentry, key, value,
+								list_length(dbzdml->columnValuesBefore), &entry);
+						if (entry)
+							set_additional_parameters(colval, getSchemaField(schemaentry, entry->position - 1));
 						else
 							elog(ERROR, "cannot find data type for column %s. None-existent column?", colval->name);
 
@@ -3591,9 +4449,9 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 			{
 				/* need to parse before and after */
 				if (i == 0)
-					dmlpayload = getPathElementJsonb(jb, "payload.before");
+					dmlpayload = getCompiledPathElement(jb, beforepath, NULL);
 				else
-					dmlpayload = getPathElementJsonb(jb, "payload.after");
+					dmlpayload = getCompiledPathElement(jb, afterpath, NULL);
 				if (dmlpayload)
 				{
 					int pause = 0;
@@ -3618,19 +4476,10 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 									pause = 0;
 									if (key)
 									{
-										int pathsize = (i == 0 ? strlen("payload.before.") + strlen(key) + 1 :
-												strlen("payload.after.") + strlen(key) + 1);
-										char * tmpPath = (char *) palloc0 (pathsize);
-
 										elog(DEBUG1, "parse the entire sub element under %s as string", key);
-										if (i == 0)
-											snprintf(tmpPath, pathsize, "payload.before.%s", key);
-										else
-											snprintf(tmpPath, pathsize, "payload.after.%s", key);
-										getPathElementString(jb, tmpPath, &strinfo, false);
+										getCompiledPathElementString(jb, i == 0 ? beforepath : afterpath,
+												key, &strinfo, false);
 										value = pstrdup(strinfo.data);
-										if(tmpPath)
-											pfree(tmpPath);
 									}
 								}
 								elog(DEBUG1, "end of object (%s) --------------------", key ? key : "null");
@@ -3700,43 +4549,11 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 						/* check if we have a key - value pair */
 						if (key != NULL && value != NULL)
 						{
-							char * mappedColumnName = NULL;
-							StringInfoData colNameObjId;
-
-							colval = (DBZ_DML_COLUMN_VALUE *) palloc0(sizeof(DBZ_DML_COLUMN_VALUE));
-							colval->name = pstrdup(key);
-							colval->value = pstrdup(value);
-							/* a copy of original column name for expression rule lookup at later stage */
-							colval->remoteColumnName = pstrdup(colval->name);
-
-							/* transform the column name if needed */
-							initStringInfo(&colNameObjId);
-							appendStringInfo(&colNameObjId, "%s.%s", objid.data, colval->name);
-							mappedColumnName = transform_object_name(colNameObjId.data, "column");
-							if (mappedColumnName)
-							{
-								elog(DEBUG1, "transformed column object ID '%s'to '%s'",
-										colNameObjId.data, mappedColumnName);
-								/* replace the column name with looked up value here */
-								pfree(colval->name);
-								colval->name = pstrdup(mappedColumnName);
-							}
-							if (colNameObjId.data)
-								pfree(colNameObjId.data);
-
-							/* look up its data type */
-							entry = (NameOidEntry *) hash_search(typeidhash, colval->name, HASH_FIND, &found);
-							if (found)
-							{
-								colval->datatype = entry->oid;
-								colval->position = entry->position;
-								colval->typemod = entry->typemod;
-
-								if (i == 0)
-									get_additional_parameters(jb, colval, true, entry->position - 1);
-								else
-									get_additional_parameters(jb, colval, false, entry->position - 1);
-							}
+							colval = makeDMLColumnValue(dbzdml, cacheentry, key, value,
+									list_length(i == 0 ? dbzdml->columnValuesBefore :
+										dbzdml->columnValuesAfter), &entry);
+							if (entry)
+								set_additional_parameters(colval, getSchemaField(schemaentry, entry->position - 1));
 							else
 								elog(ERROR, "cannot find data type for column %s. None-existent column?", colval->name);
 
@@ -3780,77 +4597,304 @@ parseDBZDML(Jsonb * jb, char op, ConnectorType type)
 	if (strinfo.data)
 		pfree(strinfo.data);
 
-	if (objid.data)
-		pfree(objid.data);
-
 	return dbzdml;
 }
 
 /*
- * fc_get_connector_type
+ * br_read
  *
- * this function takes connector type in string and returns a corresponding enum
+ * this function copies the next len bytes of a binary change event into out
  */
-ConnectorType
-fc_get_connector_type(const char * connector)
+static bool
+br_read(BinaryEventReader * reader, void * out, Size len)
 {
-	if (!strcasecmp(connector, "mysql"))
-	{
-		return TYPE_MYSQL;
-	}
-	else if (!strcasecmp(connector, "oracle"))
-	{
-		return TYPE_ORACLE;
-	}
-	else if (!strcasecmp(connector, "sqlserver"))
-	{
-		return TYPE_SQLSERVER;
-	}
-	/* todo: support more dbz connector types here */
-	else
-	{
-		return TYPE_UNDEF;
-	}
+	if (reader->offset + len > reader->len)
+		return false;
+
+	memcpy(out, reader->data + reader->offset, len);
+	reader->offset += len;
+	return true;
 }
 
 /*
- * init_mysql
+ * br_read_string
  *
- * initialize data type hash table for mysql database
+ * this function reads a length-prefixed string from a binary change event. A
+ * null string is returned as NULL in *out
  */
-static void
-init_mysql(void)
+static bool
+br_read_string(BinaryEventReader * reader, char ** out)
 {
-	HASHCTL	info;
-	int i = 0;
-	DatatypeHashEntry * entry;
-	bool found = 0;
+	int32 len;
 
-	info.keysize = sizeof(DatatypeHashKey);
-	info.entrysize = sizeof(DatatypeHashEntry);
-	info.hcxt = CurrentMemoryContext;
+	*out = NULL;
+	if (!br_read(reader, &len, sizeof(int32)))
+		return false;
 
-	mysqlDatatypeHash = hash_create("mysql datatype hash",
-							 256,
-							 &info,
-							 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	if (len < 0)
+		return true;
 
-	for (i = 0; i < SIZE_MYSQL_DATATYPE_MAPPING; i++)
-	{
-		entry = (DatatypeHashEntry *) hash_search(mysqlDatatypeHash, &(mysql_defaultTypeMappings[i].key), HASH_ENTER, &found);
-		if (!found)
-		{
-			entry->key.autoIncremented = mysql_defaultTypeMappings[i].key.autoIncremented;
-			memset(entry->key.extTypeName, 0, SYNCHDB_DATATYPE_NAME_SIZE);
-			strncpy(entry->key.extTypeName,
-					mysql_defaultTypeMappings[i].key.extTypeName,
-					strlen(mysql_defaultTypeMappings[i].key.extTypeName));
+	if (reader->offset + len > reader->len)
+		return false;
 
-			entry->pgsqlTypeLength = mysql_defaultTypeMappings[i].pgsqlTypeLength;
-			memset(entry->pgsqlTypeName, 0, SYNCHDB_DATATYPE_NAME_SIZE);
-			strncpy(entry->pgsqlTypeName,
-					mysql_defaultTypeMappings[i].pgsqlTypeName,
-					strlen(mysql_defaultTypeMappings[i].pgsqlTypeName));
+	*out = pnstrdup(reader->data + reader->offset, len);
+	reader->offset += len;
+	return true;
+}
+
+/*
+ * decodeBinarySchema
+ *
+ * this function decodes the schema block of a binary change event and saves
+ * it in schema cache under the given fingerprint
+ */
+static DbzSchemaCacheEntry *
+decodeBinarySchema(BinaryEventReader * reader, uint64 fingerprint)
+{
+	DbzSchemaCacheEntry * entry;
+	DbzSchemaField * fields;
+	MemoryContext oldContext;
+	int16 nfields;
+	bool found;
+	int i;
+
+	if (!br_read(reader, &nfields, sizeof(int16)) || nfields < 0)
+		return NULL;
+
+	oldContext = MemoryContextSwitchTo(TopMemoryContext);
+	fields = (DbzSchemaField *) palloc0(sizeof(DbzSchemaField) * (nfields + 1));
+	for (i = 0; i < nfields; i++)
+	{
+		char * semantictype = NULL;
+		int32 scale;
+
+		if (!br_read_string(reader, &fields[i].name) || !fields[i].name ||
+			!br_read_string(reader, &semantictype) ||
+			!br_read(reader, &scale, sizeof(int32)))
+		{
+			int j;
+
+			for (j = 0; j <= i; j++)
+			{
+				if (fields[j].name)
+					pfree(fields[j].name);
+			}
+			if (semantictype)
+				pfree(semantictype);
+			pfree(fields);
+			MemoryContextSwitchTo(oldContext);
+			return NULL;
+		}
+
+		/* PG_INT32_MIN stands for no scale, see BinaryEventEncoder */
+		fields[i].hasscale = (scale != PG_INT32_MIN);
+		fields[i].scale = fields[i].hasscale ? scale : 0;
+		fields[i].timerep = semantictype ? timerep_from_name(semantictype) : TIME_UNDEF;
+		if (semantictype)
+			pfree(semantictype);
+	}
+	MemoryContextSwitchTo(oldContext);
+
+	entry = (DbzSchemaCacheEntry *) hash_search(schemaCacheHash, &fingerprint, HASH_ENTER, &found);
+	if (found)
+	{
+		/* same schema sent again, replace what we have */
+		for (i = 0; i < entry->nfields; i++)
+			pfree(entry->fields[i].name);
+		pfree(entry->fields);
+	}
+	entry->nfields = nfields;
+	entry->fields = fields;
+
+	elog(DEBUG1, "cached schema " UINT64_FORMAT " with %d fields", fingerprint, nfields);
+	return entry;
+}
+
+/*
+ * decodeBinaryDMLValues
+ *
+ * this function decodes the before or after column values of a binary change
+ * event into the column value lists of dbzdml
+ */
+static bool
+decodeBinaryDMLValues(BinaryEventReader * reader, DBZ_DML * dbzdml, DataCacheEntry * cacheentry,
+		DbzSchemaCacheEntry * schemaentry, bool isbefore)
+{
+	int16 nvalues;
+	int i;
+
+	if (!br_read(reader, &nvalues, sizeof(int16)))
+		return false;
+
+	/* nvalues is -1 if the image is null */
+	for (i = 0; i < nvalues; i++)
+	{
+		int16 fieldidx;
+		uint8 tag;
+		char * value = NULL;
+		DBZ_DML_COLUMN_VALUE * colval;
+		NameOidEntry * entry;
+
+		if (!br_read(reader, &fieldidx, sizeof(int16)) ||
+			!br_read(reader, &tag, sizeof(uint8)))
+			return false;
+
+		if (fieldidx < 0 || fieldidx >= schemaentry->nfields)
+			return false;
+
+		switch (tag)
+		{
+			case BINARY_VALUE_NULL:
+				value = pstrdup("NULL");
+				break;
+			case BINARY_VALUE_TEXT:
+			case BINARY_VALUE_JSON:
+				if (!br_read_string(reader, &value) || !value)
+					return false;
+				break;
+			default:
+				return false;
+		}
+
+		colval = makeDMLColumnValue(dbzdml, cacheentry, schemaentry->fields[fieldidx].name,
+				value, i, &entry);
+		if (entry)
+			set_additional_parameters(colval, &schemaentry->fields[fieldidx]);
+		else if (isbefore)
+			elog(ERROR, "cannot find data type for column %s. None-existent column?", colval->name);
+		else
+			elog(WARNING, "cannot find data type for column %s. None-existent column?", colval->name);
+
+		elog(DEBUG1, "consumed %s = %s, type %d", colval->name, colval->value, colval->datatype);
+		if (isbefore)
+			dbzdml->columnValuesBefore = lappend(dbzdml->columnValuesBefore, colval);
+		else
+			dbzdml->columnValuesAfter = lappend(dbzdml->columnValuesAfter, colval);
+
+		pfree(value);
+	}
+	return true;
+}
+
+/*
+ * parseDBZBinaryDML
+ *
+ * this function decodes the column values of a binary change event and produces
+ * a DBZ_DML structure, the same as parseDBZDML() does for a JSON change event
+ */
+static DBZ_DML *
+parseDBZBinaryDML(BinaryEventReader * reader, char op, const char * db, const char * schema,
+		const char * table, DbzSchemaCacheEntry * schemaentry)
+{
+	DBZ_DML * dbzdml = NULL;
+	DataCacheEntry * cacheentry;
+
+	if (!db)
+	{
+		elog(WARNING, "malformed DML change request - no database attribute specified");
+		return NULL;
+	}
+
+	if (!table || !strcasecmp(table, "dbzsignal"))
+	{
+		elog(WARNING, "malformed DML change request - no table attribute specified");
+		return NULL;
+	}
+
+	if (op != 'c' && op != 'r' && op != 'u' && op != 'd')
+	{
+		elog(WARNING, "op %c not supported", op);
+		return NULL;
+	}
+
+	dbzdml = (DBZ_DML *) palloc0(sizeof(DBZ_DML));
+	dbzdml->op = op;
+
+	cacheentry = resolveDMLTarget(dbzdml, db, schema, table);
+
+	if (!decodeBinaryDMLValues(reader, dbzdml, cacheentry, schemaentry, true) ||
+		!decodeBinaryDMLValues(reader, dbzdml, cacheentry, schemaentry, false))
+	{
+		elog(WARNING, "malformed DML change request - bad column values");
+		destroyDBZDML(dbzdml);
+		return NULL;
+	}
+
+	/* sort column values based on position to align with PostgreSQL's attnum */
+	if (dbzdml->columnValuesBefore != NULL)
+		list_sort(dbzdml->columnValuesBefore, list_sort_cmp);
+
+	if (dbzdml->columnValuesAfter != NULL)
+		list_sort(dbzdml->columnValuesAfter, list_sort_cmp);
+
+	return dbzdml;
+}
+
+/*
+ * fc_get_connector_type
+ *
+ * this function takes connector type in string and returns a corresponding enum
+ */
+ConnectorType
+fc_get_connector_type(const char * connector)
+{
+	if (!strcasecmp(connector, "mysql"))
+	{
+		return TYPE_MYSQL;
+	}
+	else if (!strcasecmp(connector, "oracle"))
+	{
+		return TYPE_ORACLE;
+	}
+	else if (!strcasecmp(connector, "sqlserver"))
+	{
+		return TYPE_SQLSERVER;
+	}
+	/* todo: support more dbz connector types here */
+	else
+	{
+		return TYPE_UNDEF;
+	}
+}
+
+/*
+ * init_mysql
+ *
+ * initialize data type hash table for mysql database
+ */
+static void
+init_mysql(void)
+{
+	HASHCTL	info;
+	int i = 0;
+	DatatypeHashEntry * entry;
+	bool found = 0;
+
+	info.keysize = sizeof(DatatypeHashKey);
+	info.entrysize = sizeof(DatatypeHashEntry);
+	info.hcxt = CurrentMemoryContext;
+
+	mysqlDatatypeHash = hash_create("mysql datatype hash",
+							 256,
+							 &info,
+							 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	for (i = 0; i < SIZE_MYSQL_DATATYPE_MAPPING; i++)
+	{
+		entry = (DatatypeHashEntry *) hash_search(mysqlDatatypeHash, &(mysql_defaultTypeMappings[i].key), HASH_ENTER, &found);
+		if (!found)
+		{
+			entry->key.autoIncremented = mysql_defaultTypeMappings[i].key.autoIncremented;
+			memset(entry->key.extTypeName, 0, SYNCHDB_DATATYPE_NAME_SIZE);
+			strncpy(entry->key.extTypeName,
+					mysql_defaultTypeMappings[i].key.extTypeName,
+					strlen(mysql_defaultTypeMappings[i].key.extTypeName));
+
+			entry->pgsqlTypeLength = mysql_defaultTypeMappings[i].pgsqlTypeLength;
+			memset(entry->pgsqlTypeName, 0, SYNCHDB_DATATYPE_NAME_SIZE);
+			strncpy(entry->pgsqlTypeName,
+					mysql_defaultTypeMappings[i].pgsqlTypeName,
+					strlen(mysql_defaultTypeMappings[i].pgsqlTypeName));
 
 			elog(DEBUG1, "Inserted mapping '%s' <-> '%s'", entry->key.extTypeName, entry->pgsqlTypeName);
 		}
@@ -3919,6 +4963,7 @@ fc_initFormatConverter(ConnectorType connectorType)
 {
 	/* init data cache hash */
 	HASHCTL	info;
+	static bool callbackRegistered = false;
 
 	info.keysize = sizeof(DataCacheKey);
 	info.entrysize = sizeof(DataCacheEntry);
@@ -3929,6 +4974,28 @@ fc_initFormatConverter(ConnectorType connectorType)
 							 &info,
 							 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
 
+	/* keep data cache in sync with table changes made by DDLs */
+	if (!callbackRegistered)
+	{
+		CacheRegisterRelcacheCallback(invalidateDataCacheCallback, (Datum) 0);
+		callbackRegistered = true;
+	}
+
+	/* init schema cache hash */
+	info.keysize = sizeof(uint64);
+	info.entrysize = sizeof(DbzSchemaCacheEntry);
+	info.hcxt = CurrentMemoryContext;
+
+	schemaCacheHash = hash_create("schema cache hash",
+							 256,
+							 &info,
+							 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	jsonSchemaCacheHash = hash_create("json schema cache hash",
+							 256,
+							 &info,
+							 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
 	switch (connectorType)
 	{
 		case TYPE_MYSQL:
@@ -4324,6 +5391,8 @@ fc_load_rules(ConnectorType connectorType, const char * rulefile)
 								expressentry.pgsqlTransExpress,
 								strlen(expressentry.pgsqlTransExpress));
 
+						expressentrylookup->function = expressentry.function;
+
 						elog(DEBUG1, "Inserted / updated transform expression mapping '%s' <-> '%s'",
 								expressentrylookup->key.extObjName,
 								expressentrylookup->pgsqlTransExpress);
@@ -4402,6 +5471,15 @@ fc_load_rules(ConnectorType connectorType, const char * rulefile)
 					elog(DEBUG1, "consuming %s = %s", key, value);
 					strncpy(expressentry.pgsqlTransExpress, value, strlen(value));
 				}
+				if (!strcmp(key, "transform_function"))
+				{
+					elog(DEBUG1, "consuming %s = %s", key, value);
+					if (!parseTransformFunction(value, &expressentry.function))
+					{
+						set_shm_connector_errmsg(myConnectorId, "invalid transform_function in rule file");
+						elog(ERROR, "invalid transform_function '%s' in rule file", value);
+					}
+				}
 			}
 
 			pfree(key);
@@ -4441,71 +5519,925 @@ fc_load_rules(ConnectorType connectorType, const char * rulefile)
 }
 
 /*
- * fc_processDBZChangeEvent
+ * is_snapshot_value
  *
- * Main function to process Debezium change event
+ * this function returns true if the snapshot field of a change event's source
+ * marks it as part of the initial snapshot. Besides "true" and "last", Debezium
+ * sends "first", "first_in_data_collection" and "last_in_data_collection"
+ * during the snapshot, so only "false", "incremental" and a missing field
+ * mean change data capture
  */
-int
-fc_processDBZChangeEvent(const char * event, SynchdbStatistics * myBatchStats)
+static bool
+is_snapshot_value(const char * snapshot)
 {
-	Datum jsonb_datum;
-	Jsonb *jb;
-	StringInfoData strinfo;
-	ConnectorType type;
-	MemoryContext tempContext, oldContext;
+	if (!snapshot || snapshot[0] == '\0' || !strcasecmp(snapshot, "NULL"))
+		return false;
 
-	tempContext = AllocSetContextCreate(TopMemoryContext,
-										"FORMAT_CONVERTER",
-										ALLOCSET_DEFAULT_SIZES);
-
-	oldContext = MemoryContextSwitchTo(tempContext);
+	return strcmp(snapshot, "false") && strcmp(snapshot, "incremental");
+}
 
-	initStringInfo(&strinfo);
+/*
+ * update_connector_stage
+ *
+ * this function sets the connector stage based on whether a change event
+ * comes from the initial snapshot or from change data capture. lastsnapshot is
+ * true for the last change event of the snapshot
+ */
+static void
+update_connector_stage(bool insnapshot, bool lastsnapshot)
+{
+	snapshotInProgress = insnapshot && !lastsnapshot;
 
-    /* Convert event string to JSONB */
-    jsonb_datum = DirectFunctionCall1(jsonb_in, CStringGetDatum(event));
-    jb = DatumGetJsonbP(jsonb_datum);
+	if (insnapshot)
+	{
+		if (get_shm_connector_stage_enum(myConnectorId) != STAGE_INITIAL_SNAPSHOT)
+			set_shm_connector_stage(myConnectorId, STAGE_INITIAL_SNAPSHOT);
+	}
+	else
+	{
+		if (get_shm_connector_stage_enum(myConnectorId) != STAGE_CHANGE_DATA_CAPTURE)
+			set_shm_connector_stage(myConnectorId, STAGE_CHANGE_DATA_CAPTURE);
 
-    /* Get connector type */
-    getPathElementString(jb, "payload.source.connector", &strinfo, true);
-    type = fc_get_connector_type(strinfo.data);
+		/* snapshot has ended, tables loaded in fast load mode get their primary keys */
+		fc_finishSnapshotFastLoad();
+	}
+}
 
-    /* Check if it's a DDL or DML event */
-    getPathElementString(jb, "payload.source.snapshot", &strinfo, true);
-    if (!strcmp(strinfo.data, "true") || !strcmp(strinfo.data, "last"))
-    {
-    	if (get_shm_connector_stage_enum(myConnectorId) != STAGE_INITIAL_SNAPSHOT)
-    		set_shm_connector_stage(myConnectorId, STAGE_INITIAL_SNAPSHOT);
-    }
-    else
-    {
-    	if (get_shm_connector_stage_enum(myConnectorId) != STAGE_CHANGE_DATA_CAPTURE)
-    		set_shm_connector_stage(myConnectorId, STAGE_CHANGE_DATA_CAPTURE);
-    }
+/*
+ * applyDBZDML
+ *
+ * this function converts a parsed DBZ_DML to PG_DML and executes it. dbzdml is
+ * destroyed before returning
+ */
+static int
+applyDBZDML(DBZ_DML * dbzdml, ConnectorType type, SynchdbStatistics * myBatchStats)
+{
+	PG_DML * pgdml = NULL;
 
-    getPathElementString(jb, "payload.op", &strinfo, true);
-    if (!strcmp(strinfo.data, "NULL"))
-    {
-        /* Process DDL event */
-    	DBZ_DDL * dbzddl = NULL;
-    	PG_DDL * pgddl = NULL;
+	/* (2) convert */
+	set_shm_connector_state(myConnectorId, STATE_CONVERTING);
+	pgdml = convert2PGDML(dbzdml, type);
+	if (!pgdml)
+	{
+		elog(WARNING, "failed to convert DBZ DML to PG DML change event");
+		set_shm_connector_state(myConnectorId, STATE_SYNCING);
+		increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
+		destroyDBZDML(dbzdml);
+		return -1;
+	}
 
-    	/* increment batch statistics */
-    	increment_connector_statistics(myBatchStats, STATS_DDL, 1);
+	/* (3) execute */
+	set_shm_connector_state(myConnectorId, STATE_EXECUTING);
+	elog(DEBUG1, "executing PG DML change event...");
+	if(ra_executePGDML(pgdml, type, myBatchStats))
+	{
+		elog(WARNING, "failed to execute PG DML change event");
+		set_shm_connector_state(myConnectorId, STATE_SYNCING);
+		increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
+		destroyDBZDML(dbzdml);
+		destroyPGDML(pgdml);
+		return -1;
+	}
 
-    	/* (1) parse */
-    	elog(DEBUG1, "parsing DBZ DDL change event...");
-    	set_shm_connector_state(myConnectorId, STATE_PARSING);
-    	dbzddl = parseDBZDDL(jb);
-    	if (!dbzddl)
-    	{
-    		elog(DEBUG1, "malformed DDL event");
-    		set_shm_connector_state(myConnectorId, STATE_SYNCING);
-    		increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
-    		MemoryContextSwitchTo(oldContext);
-    		MemoryContextDelete(tempContext);
-    		return -1;
-    	}
+	/* (4) clean up */
+	set_shm_connector_state(myConnectorId, STATE_SYNCING);
+	elog(DEBUG1, "execution completed. Clean up...");
+	destroyDBZDML(dbzdml);
+	destroyPGDML(pgdml);
+	return 0;
+}
+
+/*
+ * flatSpanIs
+ *
+ * this function checks if a JSON string in a change event buffer equals str.
+ * Strings with escape sequences never match
+ */
+static bool
+flatSpanIs(const JsonSpan * span, const char * str)
+{
+	int len = strlen(str);
+
+	if (!span->ptr || span->len != len + 2 || span->ptr[0] != '"')
+		return false;
+
+	return !strncmp(span->ptr + 1, str, len);
+}
+
+/*
+ * flat_scalar_capture
+ *
+ * scalar callback used by flatSpanToCString() to have the JSON lexer unescape
+ * a string for us
+ */
+static JsonParseErrorType
+flat_scalar_capture(void * state, char * token, JsonTokenType tokentype)
+{
+	*((char **) state) = token;
+	return JSON_SUCCESS;
+}
+
+/*
+ * flatSpanToCString
+ *
+ * this function converts a JSON value in a change event buffer to the string
+ * representation used by DBZ_DML_COLUMN_VALUE: strings are unquoted and
+ * unescaped, numbers are normalized the same way as jsonb does and objects or
+ * arrays are returned as JSON text. Returns NULL for JSON null or a missing value
+ */
+static char *
+flatSpanToCString(const JsonSpan * span)
+{
+	if (!span->ptr || span->len == 0)
+		return NULL;
+
+	switch (span->ptr[0])
+	{
+		case 'n':
+			return NULL;
+		case 't':
+			return pstrdup("true");
+		case 'f':
+			return pstrdup("false");
+		case '{':
+		case '[':
+			return pnstrdup(span->ptr, span->len);
+		case '"':
+		{
+			JsonLexContext * lex;
+			JsonSemAction sem = {0};
+			char * out = NULL;
+
+			/* common case: nothing to unescape */
+			if (!memchr(span->ptr, '\\', span->len))
+				return pnstrdup(span->ptr + 1, span->len - 2);
+
+			lex = makeJsonLexContextCstringLen((char *) span->ptr, span->len, GetDatabaseEncoding(), true);
+			sem.semstate = &out;
+			sem.scalar = flat_scalar_capture;
+			if (pg_parse_json(lex, &sem) != JSON_SUCCESS || !out)
+				return pnstrdup(span->ptr + 1, span->len - 2);
+
+			return out;
+		}
+		default:
+		{
+			char * num = pnstrdup(span->ptr, span->len);
+
+			/* exponents are expanded by jsonb, do the same */
+			if (strpbrk(num, "eE"))
+			{
+				Datum numeric = DirectFunctionCall3(numeric_in, CStringGetDatum(num),
+						ObjectIdGetDatum(InvalidOid), Int32GetDatum(-1));
+
+				pfree(num);
+				num = DatumGetCString(DirectFunctionCall1(numeric_out, numeric));
+			}
+			return num;
+		}
+	}
+}
+
+/*
+ * flat_field_name
+ *
+ * this function locates the name of the object field whose value starts at
+ * valuestart by scanning back over the colon to the quoted field name. In
+ * valid JSON a quote inside a string is always preceded by an odd number of
+ * backslashes, which tells the opening quote apart
+ */
+static void
+flat_field_name(const char * bufstart, const char * valuestart, JsonSpan * name)
+{
+	const char * p = valuestart - 1;
+	const char * end;
+
+	while (p > bufstart && isspace((unsigned char) *p))
+		p--;
+
+	/* skip the colon */
+	p--;
+	while (p > bufstart && isspace((unsigned char) *p))
+		p--;
+
+	/* p is now at the closing quote */
+	end = p;
+	for (p = end - 1; p > bufstart; p--)
+	{
+		const char * q = p - 1;
+		int nbackslash = 0;
+
+		if (*p != '"')
+			continue;
+
+		while (q >= bufstart && *q == '\\')
+		{
+			nbackslash++;
+			q--;
+		}
+		if (nbackslash % 2 == 0)
+			break;
+	}
+	name->ptr = p;
+	name->len = end - p + 1;
+}
+
+/*
+ * flat_event_field_start
+ *
+ * object field start callback of the streaming event parser. It remembers the
+ * field name and where its value starts at the current nesting level
+ */
+static JsonParseErrorType
+flat_event_field_start(void * state, char * fname, bool isnull)
+{
+	FlatEventParseState * pstate = (FlatEventParseState *) state;
+	int level = pstate->lex->lex_level;
+
+	if (level > FLAT_EVENT_MAX_DEPTH)
+		return JSON_SUCCESS;
+
+	pstate->valuestart[level] = pstate->lex->token_start;
+	flat_field_name(pstate->lex->input, pstate->lex->token_start, &pstate->names[level]);
+	return JSON_SUCCESS;
+}
+
+/*
+ * flat_event_field_end
+ *
+ * object field end callback of the streaming event parser. It saves the span of
+ * the values synchdb needs into the flat event
+ */
+static JsonParseErrorType
+flat_event_field_end(void * state, char * fname, bool isnull)
+{
+	FlatEventParseState * pstate = (FlatEventParseState *) state;
+	DbzFlatEvent * event = pstate->event;
+	int level = pstate->lex->lex_level;
+	JsonSpan value;
+	JsonSpan * name;
+
+	if (level > FLAT_EVENT_MAX_DEPTH)
+		return JSON_SUCCESS;
+
+	value.ptr = pstate->valuestart[level];
+	value.len = pstate->lex->prev_token_terminator - value.ptr;
+	name = &pstate->names[level];
+
+	switch (level)
+	{
+		case 1:
+			if (flatSpanIs(name, "schema"))
+				event->schema = value;
+			break;
+		case 2:
+			if (!flatSpanIs(&pstate->names[1], "payload"))
+				break;
+
+			if (flatSpanIs(name, "op"))
+				event->op = value;
+			else if (flatSpanIs(name, "status"))
+				event->txstatus = value;
+			else if (flatSpanIs(name, "id"))
+				event->txid = value;
+			break;
+		case 3:
+		{
+			if (!flatSpanIs(&pstate->names[1], "payload"))
+				break;
+
+			if (flatSpanIs(&pstate->names[2], "source"))
+			{
+				if (flatSpanIs(name, "connector"))
+					event->connector = value;
+				else if (flatSpanIs(name, "db"))
+					event->db = value;
+				else if (flatSpanIs(name, "schema"))
+					event->schema_name = value;
+				else if (flatSpanIs(name, "table"))
+					event->table = value;
+				else if (flatSpanIs(name, "snapshot"))
+					event->snapshot = value;
+			}
+			else if (flatSpanIs(&pstate->names[2], "transaction"))
+			{
+				if (flatSpanIs(name, "id"))
+					event->txid = value;
+			}
+			else if (flatSpanIs(&pstate->names[2], "before") ||
+					 flatSpanIs(&pstate->names[2], "after"))
+			{
+				DbzFlatColumn * column = (DbzFlatColumn *) palloc(sizeof(DbzFlatColumn));
+
+				column->name = *name;
+				column->value = value;
+				if (flatSpanIs(&pstate->names[2], "before"))
+					event->before = lappend(event->before, column);
+				else
+					event->after = lappend(event->after, column);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	return JSON_SUCCESS;
+}
+
+/*
+ * parseDBZFlatEvent
+ *
+ * this function scans a change event once with PostgreSQL's JSON lexer and
+ * records where the fields synchdb needs are in the event buffer, without
+ * building a jsonb or copying any values
+ */
+static bool
+parseDBZFlatEvent(const char * event, DbzFlatEvent * flat)
+{
+	FlatEventParseState pstate = {0};
+	JsonSemAction sem = {0};
+	JsonParseErrorType res;
+
+	pstate.lex = makeJsonLexContextCstringLen((char *) event, strlen(event), GetDatabaseEncoding(), false);
+	pstate.event = flat;
+
+	sem.semstate = &pstate;
+	sem.object_field_start = flat_event_field_start;
+	sem.object_field_end = flat_event_field_end;
+
+	res = pg_parse_json(pstate.lex, &sem);
+	if (res != JSON_SUCCESS)
+	{
+		elog(DEBUG1, "streaming parser cannot parse change event: %s",
+				json_errdetail(res, pstate.lex));
+		return false;
+	}
+	return true;
+}
+
+/*
+ * getFlatSchemaCacheEntry
+ *
+ * this function is the same as getJsonSchemaCacheEntry() but for a flat event.
+ * The fingerprint is a hash of the schema section text, and the section is only
+ * converted to jsonb when it is not in schema cache yet
+ */
+static DbzSchemaCacheEntry *
+getFlatSchemaCacheEntry(const DbzFlatEvent * flat)
+{
+	DbzSchemaCacheEntry * entry;
+	Jsonb * schemajb;
+	uint64 fingerprint;
+	Datum jsonb_datum;
+
+	if (!flat->schema.ptr || flat->schema.ptr[0] != '{')
+		return NULL;
+
+	fingerprint = hash_bytes_extended((const unsigned char *) flat->schema.ptr, flat->schema.len, 0);
+
+	entry = (DbzSchemaCacheEntry *) hash_search(jsonSchemaCacheHash, &fingerprint, HASH_FIND, NULL);
+	if (entry)
+		return entry;
+
+	jsonb_datum = DirectFunctionCall1(jsonb_in, CStringGetDatum(pnstrdup(flat->schema.ptr, flat->schema.len)));
+	schemajb = DatumGetJsonbP(jsonb_datum);
+
+	return buildSchemaCacheEntry(fingerprint, getPathElementJsonb(schemajb, "fields.1.fields"));
+}
+
+/*
+ * parseDBZFlatDML
+ *
+ * this function produces a DBZ_DML structure from a flat event, the same as
+ * parseDBZDML() does from a jsonb
+ */
+static DBZ_DML *
+parseDBZFlatDML(const DbzFlatEvent * flat, char op)
+{
+	DBZ_DML * dbzdml = NULL;
+	DataCacheEntry * cacheentry;
+	DbzSchemaCacheEntry * schemaentry;
+	char * db, * schema, * table;
+	int i;
+
+	db = flatSpanToCString(&flat->db);
+	if (!db)
+	{
+		elog(WARNING, "malformed DML change request - no database attribute specified");
+		return NULL;
+	}
+
+	table = flatSpanToCString(&flat->table);
+	if (!table || !strcasecmp(table, "dbzsignal"))
+	{
+		elog(WARNING, "malformed DML change request - no table attribute specified");
+		return NULL;
+	}
+
+	if (op != 'c' && op != 'r' && op != 'u' && op != 'd')
+	{
+		elog(WARNING, "op %c not supported", op);
+		return NULL;
+	}
+
+	schema = flatSpanToCString(&flat->schema_name);
+
+	dbzdml = (DBZ_DML *) palloc0(sizeof(DBZ_DML));
+	dbzdml->op = op;
+
+	cacheentry = resolveDMLTarget(dbzdml, db, schema, table);
+
+	/* scale and time representation of columns come from the event's schema */
+	schemaentry = getFlatSchemaCacheEntry(flat);
+
+	/* before values for update and delete, after values for the others */
+	for (i = 0; i < 2; i++)
+	{
+		bool isbefore = (i == 0);
+		ListCell * cell;
+
+		if (isbefore && op != 'u' && op != 'd')
+			continue;
+
+		if (!isbefore && op == 'd')
+			continue;
+
+		foreach(cell, isbefore ? flat->before : flat->after)
+		{
+			DbzFlatColumn * column = (DbzFlatColumn *) lfirst(cell);
+			DBZ_DML_COLUMN_VALUE * colval;
+			NameOidEntry * entry;
+			char * name = flatSpanToCString(&column->name);
+			char * value = flatSpanToCString(&column->value);
+
+			colval = makeDMLColumnValue(dbzdml, cacheentry, name, value ? value : "NULL",
+					foreach_current_index(cell), &entry);
+			if (entry)
+				set_additional_parameters(colval, getSchemaField(schemaentry, entry->position - 1));
+			else if (isbefore)
+				elog(ERROR, "cannot find data type for column %s. None-existent column?", colval->name);
+			else
+				elog(WARNING, "cannot find data type for column %s. None-existent column?", colval->name);
+
+			elog(DEBUG1, "consumed %s = %s, type %d", colval->name, colval->value, colval->datatype);
+			if (isbefore)
+				dbzdml->columnValuesBefore = lappend(dbzdml->columnValuesBefore, colval);
+			else
+				dbzdml->columnValuesAfter = lappend(dbzdml->columnValuesAfter, colval);
+
+			pfree(name);
+			if (value)
+				pfree(value);
+		}
+	}
+
+	/* sort column values based on position to align with PostgreSQL's attnum */
+	if (dbzdml->columnValuesBefore != NULL)
+		list_sort(dbzdml->columnValuesBefore, list_sort_cmp);
+
+	if (dbzdml->columnValuesAfter != NULL)
+		list_sort(dbzdml->columnValuesAfter, list_sort_cmp);
+
+	pfree(db);
+	pfree(table);
+	if (schema)
+		pfree(schema);
+
+	return dbzdml;
+}
+
+/*
+ * processDBZFlatDML
+ *
+ * this function processes a DML change event scanned by the streaming event parser
+ */
+static int
+processDBZFlatDML(const DbzFlatEvent * flat, SynchdbStatistics * myBatchStats)
+{
+	DBZ_DML * dbzdml = NULL;
+	ConnectorType type;
+	char * connector, * snapshot, * op;
+
+	connector = flatSpanToCString(&flat->connector);
+	type = fc_get_connector_type(connector ? connector : "NULL");
+
+	snapshot = flatSpanToCString(&flat->snapshot);
+	update_connector_stage(is_snapshot_value(snapshot), snapshot && !strcmp(snapshot, "last"));
+
+	/* increment batch statistics */
+	increment_connector_statistics(myBatchStats, STATS_DML, 1);
+
+	/* (1) parse */
+	set_shm_connector_state(myConnectorId, STATE_PARSING);
+	op = flatSpanToCString(&flat->op);
+	dbzdml = parseDBZFlatDML(flat, op[0]);
+	if (!dbzdml)
+	{
+		elog(WARNING, "malformed DML event");
+		set_shm_connector_state(myConnectorId, STATE_SYNCING);
+		increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
+		return -1;
+	}
+
+	/* (2) convert, (3) execute and (4) clean up */
+	return applyDBZDML(dbzdml, type, myBatchStats);
+}
+
+/*
+ * hashFlatKey
+ *
+ * this function hashes the replica identity column values found in the before or
+ * after values of a flat event. Values are hashed as they appear in the event so
+ * equal keys hash the same without being converted. Returns false if the table
+ * has no replica identity or a key column cannot be resolved
+ */
+static bool
+hashFlatKey(DataCacheEntry * cacheentry, const char * remoteObjectId, List * columns, uint32 * hash)
+{
+	ListCell * cell;
+	uint32 keyhash = 0;
+	int nkeys = 0;
+
+	if (bms_is_empty(cacheentry->keyattrs))
+		return false;
+
+	foreach(cell, columns)
+	{
+		DbzFlatColumn * column = (DbzFlatColumn *) lfirst(cell);
+		DataCacheColumn * colplan;
+		char * name = flatSpanToCString(&column->name);
+
+		if (!name)
+			return false;
+
+		colplan = getDataCacheColumn(cacheentry, remoteObjectId, name, foreach_current_index(cell));
+		if (!colplan)
+			return false;
+
+		if (colplan->typeinfo &&
+			bms_is_member(colplan->typeinfo->position - FirstLowInvalidHeapAttributeNumber,
+						  cacheentry->keyattrs))
+		{
+			keyhash = hash_combine(keyhash, hash_bytes((const unsigned char *) column->value.ptr,
+													   column->value.len));
+			nkeys++;
+		}
+		pfree(name);
+	}
+
+	if (nkeys != bms_num_members(cacheentry->keyattrs))
+		return false;
+
+	*hash = keyhash;
+	return true;
+}
+
+/*
+ * getFlatEventRoute
+ *
+ * this function computes the dispatch hash of a DML change event held in a flat
+ * event. See fc_getChangeEventRoute()
+ */
+static bool
+getFlatEventRoute(const DbzFlatEvent * flat, char op, uint32 * hash)
+{
+	DBZ_DML * dbzdml;
+	DataCacheEntry * cacheentry;
+	char * db, * schema, * table;
+	uint32 tablehash, beforehash = 0, afterhash = 0;
+	bool hasbefore = false, hasafter = false;
+
+	if (op != 'c' && op != 'r' && op != 'u' && op != 'd')
+		return false;
+
+	db = flatSpanToCString(&flat->db);
+	table = flatSpanToCString(&flat->table);
+	if (!db || !table || !strcasecmp(table, "dbzsignal"))
+		return false;
+
+	schema = flatSpanToCString(&flat->schema_name);
+
+	dbzdml = (DBZ_DML *) palloc0(sizeof(DBZ_DML));
+	cacheentry = resolveDMLTarget(dbzdml, db, schema, table);
+
+	/*
+	 * changes to rows of tables with unique indexes on other columns or foreign
+	 * keys can conflict with changes to other rows, possibly of other tables.
+	 * They all hash the same so one apply worker applies them in source order
+	 */
+	if (cacheentry->crossRowConstraints)
+	{
+		*hash = 0;
+		return true;
+	}
+
+	tablehash = hash_bytes((const unsigned char *) &cacheentry->tableoid, sizeof(Oid));
+
+	if (op == 'u' || op == 'd')
+		hasbefore = hashFlatKey(cacheentry, dbzdml->remoteObjectId, flat->before, &beforehash);
+	if (op != 'd')
+		hasafter = hashFlatKey(cacheentry, dbzdml->remoteObjectId, flat->after, &afterhash);
+
+	/* an update that changes the key has to wait for changes to both keys */
+	if (op == 'u' && hasbefore && hasafter && beforehash != afterhash)
+		return false;
+
+	/* without a usable key all changes of the table go to the same apply worker */
+	if (hasbefore)
+		*hash = hash_combine(tablehash, beforehash);
+	else if (hasafter)
+		*hash = hash_combine(tablehash, afterhash);
+	else
+		*hash = tablehash;
+
+	return true;
+}
+
+/*
+ * jsonbValueToSpan
+ *
+ * this function renders a jsonb value as JSON text and returns it as a span, so
+ * it can be handled the same way as a value found by the streaming event parser
+ */
+static JsonSpan
+jsonbValueToSpan(JsonbValue * v)
+{
+	JsonSpan span = {0};
+	char * text;
+
+	if (!v)
+		return span;
+
+	if (v->type == jbvBinary)
+		text = JsonbToCString(NULL, v->val.binary.data, v->val.binary.len);
+	else
+	{
+		Jsonb * scalar = JsonbValueToJsonb(v);
+
+		text = JsonbToCString(NULL, &scalar->root, VARSIZE(scalar));
+	}
+
+	span.ptr = text;
+	span.len = strlen(text);
+	return span;
+}
+
+/*
+ * getJsonbObject
+ *
+ * this function returns the object stored under key in a jsonb object, or NULL if
+ * there is no such key or its value is not an object
+ */
+static JsonbContainer *
+getJsonbObject(JsonbContainer * container, const char * key)
+{
+	JsonbValue * v;
+
+	if (!container)
+		return NULL;
+
+	v = getKeyJsonValueFromContainer(container, key, strlen(key), NULL);
+	if (!v || v->type != jbvBinary || !JsonContainerIsObject(v->val.binary.data))
+		return NULL;
+
+	return v->val.binary.data;
+}
+
+/*
+ * getJsonbFieldSpan
+ *
+ * this function returns the value stored under key in a jsonb object as a span
+ */
+static JsonSpan
+getJsonbFieldSpan(JsonbContainer * container, const char * key)
+{
+	JsonSpan span = {0};
+
+	if (!container)
+		return span;
+
+	return jsonbValueToSpan(getKeyJsonValueFromContainer(container, key, strlen(key), NULL));
+}
+
+/*
+ * getJsonbFlatColumns
+ *
+ * this function returns the fields of a jsonb object as a list of DbzFlatColumn
+ */
+static List *
+getJsonbFlatColumns(JsonbContainer * container)
+{
+	JsonbIterator * it;
+	JsonbIteratorToken r;
+	JsonbValue v;
+	List * columns = NIL;
+	DbzFlatColumn * column = NULL;
+
+	if (!container)
+		return NIL;
+
+	it = JsonbIteratorInit(container);
+	while ((r = JsonbIteratorNext(&it, &v, true)) != WJB_DONE)
+	{
+		if (r == WJB_KEY)
+		{
+			StringInfoData name;
+
+			initStringInfo(&name);
+			escape_json(&name, pnstrdup(v.val.string.val, v.val.string.len));
+
+			column = (DbzFlatColumn *) palloc(sizeof(DbzFlatColumn));
+			column->name.ptr = name.data;
+			column->name.len = name.len;
+		}
+		else if (r == WJB_VALUE && column)
+		{
+			column->value = jsonbValueToSpan(&v);
+			columns = lappend(columns, column);
+			column = NULL;
+		}
+	}
+	return columns;
+}
+
+/*
+ * jsonbToFlatEvent
+ *
+ * this function fills a flat event from a change event converted to jsonb, so
+ * events can be routed without the streaming event parser. Values are rendered
+ * as JSON text, the same form the streaming event parser records
+ */
+static void
+jsonbToFlatEvent(Jsonb * jb, DbzFlatEvent * flat)
+{
+	JsonbContainer * payload, * source, * transaction;
+
+	if (!JsonContainerIsObject(&jb->root))
+		return;
+
+	payload = getJsonbObject(&jb->root, "payload");
+	if (!payload)
+		return;
+
+	source = getJsonbObject(payload, "source");
+	transaction = getJsonbObject(payload, "transaction");
+
+	flat->op = getJsonbFieldSpan(payload, "op");
+	flat->txstatus = getJsonbFieldSpan(payload, "status");
+	flat->txid = transaction ? getJsonbFieldSpan(transaction, "id") : getJsonbFieldSpan(payload, "id");
+	flat->connector = getJsonbFieldSpan(source, "connector");
+	flat->db = getJsonbFieldSpan(source, "db");
+	flat->schema_name = getJsonbFieldSpan(source, "schema");
+	flat->table = getJsonbFieldSpan(source, "table");
+	flat->snapshot = getJsonbFieldSpan(source, "snapshot");
+	flat->before = getJsonbFlatColumns(getJsonbObject(payload, "before"));
+	flat->after = getJsonbFlatColumns(getJsonbObject(payload, "after"));
+}
+
+/*
+ * fc_getChangeEventRoute
+ *
+ * this function works out how a change event is dispatched to apply workers.
+ * ROUTE_SERIAL is returned for events that have to be applied after all events
+ * before it and before all events after it, which is the case for DDLs, primary
+ * key changes and events that cannot be parsed. The streaming event parser is
+ * only used when synchdb.dml_use_streaming_parser is on, otherwise the event is
+ * converted to jsonb the same way fc_processDBZChangeEvent() does. For DML events ROUTE_KEYED is returned and *hash is set to a hash of the
+ * target table and replica identity values of the event, so changes to the same
+ * row hash the same. *txid is set to the source transaction ID of DML events and
+ * transaction boundaries if Debezium provides one, NULL otherwise. Must be called
+ * within a transaction
+ */
+ChangeEventRoute
+fc_getChangeEventRoute(const char * event, uint32 * hash, char ** txid)
+{
+	MemoryContext tempContext, oldContext;
+	DbzFlatEvent flat = {0};
+	ChangeEventRoute route = ROUTE_SERIAL;
+
+	*txid = NULL;
+	tempContext = AllocSetContextCreate(CurrentMemoryContext,
+										"FORMAT_CONVERTER_ROUTE",
+										ALLOCSET_DEFAULT_SIZES);
+
+	oldContext = MemoryContextSwitchTo(tempContext);
+
+	if (synchdb_dml_use_streaming_parser)
+	{
+		if (!parseDBZFlatEvent(event, &flat))
+			goto end;
+	}
+	else
+		jsonbToFlatEvent(DatumGetJsonbP(DirectFunctionCall1(jsonb_in, CStringGetDatum(event))), &flat);
+
+	if (flat.txstatus.ptr && !flat.op.ptr)
+		route = ROUTE_TXN_BOUNDARY;
+	else if (flat.op.ptr && flat.op.ptr[0] == '"' && flat.op.len == 3)
+	{
+		char * snapshot = flatSpanToCString(&flat.snapshot);
+		bool insnapshot = is_snapshot_value(snapshot);
+
+		/* deferred primary keys are added by the first change after snapshot */
+		if ((insnapshot || !fc_snapshotFastLoadPending()) &&
+			getFlatEventRoute(&flat, flat.op.ptr[1], hash))
+			route = ROUTE_KEYED;
+	}
+
+	if (route != ROUTE_SERIAL && flat.txid.ptr)
+	{
+		char * id = flatSpanToCString(&flat.txid);
+
+		if (id)
+			*txid = MemoryContextStrdup(oldContext, id);
+	}
+
+end:
+	MemoryContextSwitchTo(oldContext);
+	MemoryContextDelete(tempContext);
+	return route;
+}
+
+/*
+ * fc_processDBZChangeEvent
+ *
+ * Main function to process Debezium change event
+ */
+int
+fc_processDBZChangeEvent(const char * event, SynchdbStatistics * myBatchStats)
+{
+	Datum jsonb_datum;
+	Jsonb *jb;
+	StringInfoData strinfo;
+	ConnectorType type;
+	MemoryContext tempContext, oldContext;
+	static CompiledJsonPath * connectorpath = NULL, * snapshotpath = NULL, * oppath = NULL;
+
+	tempContext = AllocSetContextCreate(TopMemoryContext,
+										"FORMAT_CONVERTER",
+										ALLOCSET_DEFAULT_SIZES);
+
+	oldContext = MemoryContextSwitchTo(tempContext);
+
+	if (synchdb_dml_use_streaming_parser)
+	{
+		DbzFlatEvent flat = {0};
+
+		/* DDL events and events the streaming parser cannot handle take the jsonb path */
+		if (parseDBZFlatEvent(event, &flat) && flat.op.ptr && flat.op.ptr[0] == '"')
+		{
+			int ret = processDBZFlatDML(&flat, myBatchStats);
+
+			MemoryContextSwitchTo(oldContext);
+			MemoryContextDelete(tempContext);
+			return ret;
+		}
+	}
+
+	initStringInfo(&strinfo);
+
+    /* Convert event string to JSONB */
+    jsonb_datum = DirectFunctionCall1(jsonb_in, CStringGetDatum(event));
+    jb = DatumGetJsonbP(jsonb_datum);
+
+    /* paths used for every event are compiled once */
+    if (!connectorpath)
+    {
+    	connectorpath = compileJsonPath("payload.source.connector");
+    	snapshotpath = compileJsonPath("payload.source.snapshot");
+    	oppath = compileJsonPath("payload.op");
+    }
+
+    /* Get connector type */
+    getCompiledPathElementString(jb, connectorpath, NULL, &strinfo, true);
+    type = fc_get_connector_type(strinfo.data);
+
+    /* Check if it's a DDL or DML event */
+    getCompiledPathElementString(jb, snapshotpath, NULL, &strinfo, true);
+    update_connector_stage(is_snapshot_value(strinfo.data), !strcmp(strinfo.data, "last"));
+
+    getCompiledPathElementString(jb, oppath, NULL, &strinfo, true);
+    if (!strcmp(strinfo.data, "NULL"))
+    {
+        /* Process DDL event */
+    	DBZ_DDL * dbzddl = NULL;
+    	PG_DDL * pgddl = NULL;
+
+    	/* increment batch statistics */
+    	increment_connector_statistics(myBatchStats, STATS_DDL, 1);
+
+    	/* (1) parse */
+    	elog(DEBUG1, "parsing DBZ DDL change event...");
+    	set_shm_connector_state(myConnectorId, STATE_PARSING);
+    	dbzddl = parseDBZDDL(jb);
+    	if (!dbzddl)
+    	{
+    		elog(DEBUG1, "malformed DDL event");
+    		set_shm_connector_state(myConnectorId, STATE_SYNCING);
+    		increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
+    		MemoryContextSwitchTo(oldContext);
+    		MemoryContextDelete(tempContext);
+    		return -1;
+    	}
 
     	elog(DEBUG1, "converting to PG DDL change event...");
     	/* (2) convert */
@@ -4547,7 +6479,6 @@ fc_processDBZChangeEvent(const char * event, SynchdbStatistics * myBatchStats)
     {
         /* Process DML event */
     	DBZ_DML * dbzdml = NULL;
-    	PG_DML * pgdml = NULL;
 
     	/* increment batch statistics */
     	increment_connector_statistics(myBatchStats, STATS_DML, 1);
@@ -4565,40 +6496,13 @@ fc_processDBZChangeEvent(const char * event, SynchdbStatistics * myBatchStats)
 			return -1;
 		}
 
-    	/* (2) convert */
-    	set_shm_connector_state(myConnectorId, STATE_CONVERTING);
-    	pgdml = convert2PGDML(dbzdml, type);
-    	if (!pgdml)
-    	{
-    		elog(WARNING, "failed to convert DBZ DML to PG DML change event");
-    		set_shm_connector_state(myConnectorId, STATE_SYNCING);
-    		increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
-    		destroyDBZDML(dbzdml);
-    		MemoryContextSwitchTo(oldContext);
-    		MemoryContextDelete(tempContext);
-    		return -1;
-    	}
-
-    	/* (3) execute */
-    	set_shm_connector_state(myConnectorId, STATE_EXECUTING);
-    	elog(DEBUG1, "executing PG DML change event...");
-    	if(ra_executePGDML(pgdml, type, myBatchStats))
+    	/* (2) convert, (3) execute and (4) clean up */
+    	if (applyDBZDML(dbzdml, type, myBatchStats))
     	{
-    		elog(WARNING, "failed to execute PG DML change event");
-    		set_shm_connector_state(myConnectorId, STATE_SYNCING);
-    		increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
-        	destroyDBZDML(dbzdml);
-        	destroyPGDML(pgdml);
         	MemoryContextSwitchTo(oldContext);
         	MemoryContextDelete(tempContext);
     		return -1;
     	}
-
-       	/* (4) clean up */
-    	set_shm_connector_state(myConnectorId, STATE_SYNCING);
-    	elog(DEBUG1, "execution completed. Clean up...");
-    	destroyDBZDML(dbzdml);
-    	destroyPGDML(pgdml);
     }
 
 	if(strinfo.data)
@@ -4611,3 +6515,314 @@ fc_processDBZChangeEvent(const char * event, SynchdbStatistics * myBatchStats)
 	MemoryContextDelete(tempContext);
 	return 0;
 }
+
+/*
+ * fc_processDBZBinaryChangeEvent
+ *
+ * Main function to process Debezium change event sent in binary format. Only DML
+ * events are sent this way, everything else goes through fc_processDBZChangeEvent()
+ */
+int
+fc_processDBZBinaryChangeEvent(const char * event, Size len, SynchdbStatistics * myBatchStats)
+{
+	BinaryEventReader reader = {0};
+	DbzSchemaCacheEntry * schemaentry = NULL;
+	DBZ_DML * dbzdml = NULL;
+	ConnectorType type;
+	MemoryContext tempContext, oldContext;
+	uint8 magic = 0, version = 0, op = 0, snapshot = 0, hasschema = 0;
+	char * connector = NULL, * db = NULL, * schema = NULL, * table = NULL;
+	uint64 fingerprint = 0;
+	int ret = 0;
+
+	tempContext = AllocSetContextCreate(TopMemoryContext,
+										"FORMAT_CONVERTER",
+										ALLOCSET_DEFAULT_SIZES);
+
+	oldContext = MemoryContextSwitchTo(tempContext);
+
+	reader.data = event;
+	reader.len = len;
+
+	/* increment batch statistics */
+	increment_connector_statistics(myBatchStats, STATS_DML, 1);
+
+	/* (1) parse */
+	set_shm_connector_state(myConnectorId, STATE_PARSING);
+	if (!br_read(&reader, &magic, sizeof(uint8)) ||
+		!br_read(&reader, &version, sizeof(uint8)) ||
+		!br_read(&reader, &op, sizeof(uint8)) ||
+		!br_read(&reader, &snapshot, sizeof(uint8)) ||
+		!br_read_string(&reader, &connector) ||
+		!br_read_string(&reader, &db) ||
+		!br_read_string(&reader, &schema) ||
+		!br_read_string(&reader, &table) ||
+		!br_read(&reader, &fingerprint, sizeof(uint64)) ||
+		!br_read(&reader, &hasschema, sizeof(uint8)) ||
+		magic != SYNCHDB_BINARY_EVENT_MAGIC ||
+		version != SYNCHDB_BINARY_EVENT_VERSION ||
+		!connector)
+	{
+		elog(WARNING, "malformed binary change event header");
+		ret = -1;
+		goto end;
+	}
+
+	type = fc_get_connector_type(connector);
+	update_connector_stage(snapshot != BINARY_SNAPSHOT_FALSE, snapshot == BINARY_SNAPSHOT_LAST);
+
+	/* the schema is only sent with the first event that uses it */
+	if (hasschema)
+		schemaentry = decodeBinarySchema(&reader, fingerprint);
+	else
+		schemaentry = (DbzSchemaCacheEntry *) hash_search(schemaCacheHash, &fingerprint, HASH_FIND, NULL);
+
+	/*
+	 * Debezium runner sends a schema only once per encoder, so if the event that
+	 * carried it was lost, every later event of the table would be dropped. Error
+	 * out instead: once the connector is started again, Debezium resends the
+	 * batch through a new encoder, schema included.
+	 */
+	if (!schemaentry)
+	{
+		set_shm_connector_errmsg(myConnectorId, "binary change event refers to unknown or malformed schema");
+		elog(ERROR, "binary change event of %s.%s refers to unknown or malformed schema " UINT64_FORMAT,
+				schema ? schema : db, table ? table : "", fingerprint);
+	}
+
+	dbzdml = parseDBZBinaryDML(&reader, (char) op, db, schema, table, schemaentry);
+	if (!dbzdml)
+	{
+		elog(WARNING, "malformed DML event");
+		ret = -1;
+		goto end;
+	}
+
+	/* (2) convert, (3) execute and (4) clean up */
+	if (applyDBZDML(dbzdml, type, myBatchStats))
+	{
+		MemoryContextSwitchTo(oldContext);
+		MemoryContextDelete(tempContext);
+		return -1;
+	}
+
+end:
+	if (ret)
+	{
+		set_shm_connector_state(myConnectorId, STATE_SYNCING);
+		increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
+	}
+	MemoryContextSwitchTo(oldContext);
+	MemoryContextDelete(tempContext);
+	return ret;
+}
+
+/*
+ * fc_snapshotFastLoadPending
+ *
+ * returns true if there are tables whose primary keys are deferred until the
+ * initial snapshot ends
+ */
+bool
+fc_snapshotFastLoadPending(void)
+{
+	return fastLoadHash && hash_get_num_entries(fastLoadHash) > 0;
+}
+
+/*
+ * fc_snapshotInProgress
+ *
+ * returns true if the last change event seen was part of the initial snapshot
+ * but not its last event, so the snapshot is not over yet
+ */
+bool
+fc_snapshotInProgress(void)
+{
+	return snapshotInProgress;
+}
+
+/*
+ * fast_load_error_callback
+ *
+ * error context callback reporting which deferred primary key was being added
+ */
+static void
+fast_load_error_callback(void * arg)
+{
+	FastLoadHashEntry * entry = (FastLoadHashEntry *) arg;
+
+	errcontext("adding deferred primary key of %s.%s", entry->key.schema, entry->key.table);
+}
+
+/*
+ * fc_finishSnapshotFastLoad
+ *
+ * adds the primary keys deferred by snapshot fast load. Must be called within a
+ * transaction. A key that cannot be added, for example because the table got
+ * duplicate rows, raises an ERROR so the connector stops instead of leaving the
+ * table without its primary key. The keys stay in the fast load file until
+ * fc_clearSnapshotFastLoadFile() is called after the transaction commits
+ */
+void
+fc_finishSnapshotFastLoad(void)
+{
+	HASH_SEQ_STATUS status;
+	FastLoadHashEntry * entry;
+
+	if (!fc_snapshotFastLoadPending())
+		return;
+
+	hash_seq_init(&status, fastLoadHash);
+	while ((entry = (FastLoadHashEntry *) hash_seq_search(&status)) != NULL)
+	{
+		Oid schemaoid, tableoid = InvalidOid;
+		Oid pkoid = InvalidOid;
+
+		/* the table may have been dropped or got its key by an earlier run */
+		schemaoid = get_namespace_oid(entry->key.schema, true);
+		if (OidIsValid(schemaoid))
+			tableoid = get_relname_relid(entry->key.table, schemaoid);
+		if (OidIsValid(tableoid))
+		{
+			Relation rel = table_open(tableoid, AccessShareLock);
+
+			pkoid = RelationGetPrimaryKeyIndex(rel);
+			table_close(rel, AccessShareLock);
+		}
+
+		if (OidIsValid(tableoid) && !OidIsValid(pkoid))
+		{
+			PG_DDL pgddl = {0};
+			ErrorContextCallback errcallback;
+
+			elog(LOG, "adding deferred primary key of %s.%s", entry->key.schema, entry->key.table);
+
+			errcallback.callback = fast_load_error_callback;
+			errcallback.arg = (void *) entry;
+			errcallback.previous = error_context_stack;
+			error_context_stack = &errcallback;
+
+			pgddl.ddlquery = entry->pkquery;
+			if (ra_executePGDDL(&pgddl, entry->type))
+			{
+				set_shm_connector_errmsg(myConnectorId, "failed to add deferred primary key");
+				elog(ERROR, "failed to add deferred primary key of %s.%s",
+						entry->key.schema, entry->key.table);
+			}
+
+			error_context_stack = errcallback.previous;
+		}
+
+		pfree(entry->pkquery);
+		hash_search(fastLoadHash, &entry->key, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * fc_loadSnapshotFastLoad
+ *
+ * reads the primary keys that an earlier run of the connector deferred and may
+ * not have added. They are added by the next fc_finishSnapshotFastLoad(). Keys
+ * deferred from now on are saved in the same file
+ */
+void
+fc_loadSnapshotFastLoad(ConnectorType type, const char * name)
+{
+	FILE * fp;
+	DataCacheKey key;
+	int32 len;
+
+	snprintf(fastLoadFile, MAXPGPATH, SYNCHDB_FASTLOAD_FILE_PATTERN,
+			get_shm_connector_name(type), name);
+
+	fp = AllocateFile(fastLoadFile, PG_BINARY_R);
+	if (!fp)
+	{
+		if (errno != ENOENT)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", fastLoadFile)));
+		return;
+	}
+
+	/* a torn entry at the end belongs to a table whose creation never committed */
+	while (fread(&key, sizeof(DataCacheKey), 1, fp) == 1)
+	{
+		char * pkquery;
+
+		if (fread(&len, sizeof(int32), 1, fp) != 1 || len <= 0 || len >= MaxAllocSize)
+			break;
+
+		pkquery = palloc(len + 1);
+		if (fread(pkquery, len, 1, fp) != 1)
+		{
+			pfree(pkquery);
+			break;
+		}
+		pkquery[len] = '\0';
+
+		enterDeferredPrimaryKey(&key, pkquery, type);
+		elog(LOG, "primary key of %s.%s may still be deferred", key.schema, key.table);
+		pfree(pkquery);
+	}
+	FreeFile(fp);
+}
+
+/*
+ * fc_clearSnapshotFastLoadFile
+ *
+ * removes the fast load file once every deferred primary key has been added.
+ * Must be called outside of the transaction that added them, after it commits
+ */
+void
+fc_clearSnapshotFastLoadFile(void)
+{
+	if (fastLoadFile[0] == '\0' || fc_snapshotFastLoadPending())
+		return;
+
+	if (unlink(fastLoadFile) == 0)
+		fsync_fname(SYNCHDB_METADATA_DIR, true);
+	else if (errno != ENOENT)
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not remove file \"%s\": %m", fastLoadFile)));
+}
+
+/*
+ * fc_decodeUnscaledDecimal
+ *
+ * decodes an unscaled decimal value the same way as one received in a change
+ * event, as text and as a Numeric datum with the given typmod. Used by the
+ * regression tests
+ */
+char *
+fc_decodeUnscaledDecimal(const unsigned char * bytes, int len, int scale, int32 typmod, Datum * numeric)
+{
+	*numeric = numeric_from_unscaled_bytes(bytes, len, scale, typmod);
+	return decimal_from_unscaled_bytes(bytes, len, scale);
+}
+
+/*
+ * fc_decodeTemporal
+ *
+ * decodes a date/time value of the given Debezium semantic type the same way as
+ * one received in a change event, and returns it as text of the given type.
+ * NULL is returned if the value is out of range. Used by the regression tests
+ */
+char *
+fc_decodeTemporal(const char * value, const char * semantictype, Oid datatype, int32 typmod)
+{
+	DBZ_DML_COLUMN_VALUE colval = {0};
+	int64 internal;
+
+	colval.name = "value";
+	colval.value = (char *) value;
+	colval.datatype = datatype;
+	colval.typemod = typmod;
+	colval.timerep = timerep_from_name((char *) semantictype);
+
+	if (!temporal_to_internal(&colval, &internal))
+		return NULL;
+
+	return temporal_internal_to_text(datatype, internal);
+}
@@ -21,6 +21,8 @@
 
 #include "utils/hsearch.h"
 #include "nodes/pg_list.h"
+#include "nodes/bitmapset.h"
+#include "common/jsonapi.h"
 #include "replication_agent.h"
 #include "synchdb.h"
 
@@ -29,6 +31,16 @@
 #define RULEFILE_OBJECTNAME_TRANSFORM 2
 #define RULEFILE_EXPRESSION_TRANSFORM 3
 
+/* binary change event format, see BinaryEventEncoder in DebeziumRunner.java */
+#define SYNCHDB_BINARY_EVENT_MAGIC 0x01
+#define SYNCHDB_BINARY_EVENT_VERSION 2
+#define BINARY_VALUE_NULL 0
+#define BINARY_VALUE_TEXT 1
+#define BINARY_VALUE_JSON 2
+#define BINARY_SNAPSHOT_FALSE 0
+#define BINARY_SNAPSHOT_TRUE 1
+#define BINARY_SNAPSHOT_LAST 2
+
 /* structure to hold possible time representations in DBZ engine */
 typedef enum _timeRep
 {
@@ -75,6 +87,28 @@ typedef struct
 	int typemod;
 } NameOidEntry;
 
+/* native data transform functions, selected with transform_function in rule file */
+typedef enum _TransformFunctionKind
+{
+	TRANSFORM_FUNC_NONE = 0,
+	TRANSFORM_FUNC_LOWER,		/* lower */
+	TRANSFORM_FUNC_UPPER,		/* upper */
+	TRANSFORM_FUNC_SUBSTRING,	/* substring:start[:length] */
+	TRANSFORM_FUNC_MD5,			/* md5 */
+	TRANSFORM_FUNC_MASK,		/* mask[:keep[:char]] */
+	TRANSFORM_FUNC_CONSTANT,	/* constant:value */
+	TRANSFORM_FUNC_GEOMETRY		/* geometry, wkb and srid to PostGIS hex EWKB */
+} TransformFunctionKind;
+
+/* a native data transform function with its arguments */
+typedef struct transformFunction
+{
+	TransformFunctionKind kind;
+	int arg1;
+	int arg2;
+	char strarg[SYNCHDB_TRANSFORM_EXPRESSION_SIZE];
+} TransformFunction;
+
 /* Structure to represent a column value in a DML event */
 typedef struct dbz_dml_column_value
 {
@@ -86,6 +120,8 @@ typedef struct dbz_dml_column_value
 	int scale;		/* location of decimal point - decimal type only */
 	int timerep;	/* how dbz represents time related fields */
 	int typemod;	/* extra data type modifier */
+	char * transformExpression;	/* data transform expression, NULL if none. Owned by data cache */
+	TransformFunction * transformFunction;	/* native transform function, NULL if none. Owned by rules */
 } DBZ_DML_COLUMN_VALUE;
 
 /* Structure to represent a DML event */
@@ -99,6 +135,8 @@ typedef struct dbz_dml
 	Oid tableoid;
 	List * columnValuesBefore;	/* list of DBZ_DML_COLUMN_VALUE */
 	List * columnValuesAfter;	/* list of DBZ_DML_COLUMN_VALUE */
+	PG_DML_COLUMN_INPUT * columnInputs;	/* type input info per attribute. Owned by data cache */
+	int ncolumnInputs;
 } DBZ_DML;
 
 /* dml cache structure */
@@ -107,14 +145,115 @@ typedef struct dataCacheKey
 	char schema[SYNCHDB_CONNINFO_DB_NAME_SIZE];
 	char table[SYNCHDB_CONNINFO_DB_NAME_SIZE];
 } DataCacheKey;
+/* per column part of a table's apply plan, keyed by remote column name */
+typedef struct dataCacheColumn
+{
+	char remoteColumnName[SYNCHDB_OBJ_NAME_SIZE];
+	char name[NAMEDATALEN];		/* column name in PostgreSQL after transformation */
+	NameOidEntry * typeinfo;	/* NULL if the column does not exist in PostgreSQL */
+	char * transformExpression;	/* data transform expression, NULL if none */
+	TransformFunction * transformFunction;	/* native transform function, NULL if none */
+} DataCacheColumn;
+
 typedef struct dataCacheEntry
 {
 	DataCacheKey key;
+	bool valid;					/* false once the table is invalidated in relcache */
 	TupleDesc tupdesc;
 	Oid tableoid;
 	HTAB * typeidhash;
+	char remoteObjectId[SYNCHDB_OBJ_NAME_SIZE];	/* remote object the column plan is built for */
+	HTAB * columnhash;			/* remote column name to DataCacheColumn */
+	DataCacheColumn ** columnorder;	/* columns in the order last seen in change events */
+	int ncolumnorder;
+	PG_DML_COLUMN_INPUT * columnInputs;	/* type input info per attribute, tupdesc->natts entries */
+	Bitmapset * keyattrs;		/* replica identity columns, offset by FirstLowInvalidHeapAttributeNumber */
+	bool crossRowConstraints;	/* changes to different rows can conflict, see ra_hasCrossRowConstraints() */
 } DataCacheEntry;
 
+/* schema information of a field in a change event */
+typedef struct dbzSchemaField
+{
+	char * name;
+	int scale;		/* location of decimal point, 0 if not given */
+	bool hasscale;	/* false if the schema gives no scale */
+	TimeRep timerep;	/* derived from the semantic type name */
+} DbzSchemaField;
+
+/* schema cache structure, keyed by fingerprint of an event's schema */
+typedef struct dbzSchemaCacheEntry
+{
+	uint64 fingerprint;
+	int nfields;
+	DbzSchemaField * fields;
+} DbzSchemaCacheEntry;
+
+/* a JSON path parsed once into the text keys taken by jsonb_get_element() */
+typedef struct compiledJsonPath
+{
+	char path[SYNCHDB_JSON_PATH_SIZE];	/* hash key */
+	int nelems;
+	Datum * elems;		/* text Datums, one per path element */
+} CompiledJsonPath;
+
+/* how a change event is dispatched to apply workers, see fc_getChangeEventRoute() */
+typedef enum _changeEventRoute
+{
+	ROUTE_SERIAL,			/* apply after all events before it and before all events after it */
+	ROUTE_KEYED,			/* apply in order with events of the same hash */
+	ROUTE_TXN_BOUNDARY		/* source transaction BEGIN or END, nothing to apply */
+} ChangeEventRoute;
+
+/* maximum object nesting level tracked by the streaming event parser */
+#define FLAT_EVENT_MAX_DEPTH 3
+
+/* location of a JSON value in a change event buffer, strings include their quotes */
+typedef struct jsonSpan
+{
+	const char * ptr;
+	int len;
+} JsonSpan;
+
+/* a column value of a flat event */
+typedef struct dbzFlatColumn
+{
+	JsonSpan name;
+	JsonSpan value;
+} DbzFlatColumn;
+
+/* fields of a change event needed by synchdb, as found by the streaming event parser */
+typedef struct dbzFlatEvent
+{
+	JsonSpan schema;		/* entire schema section */
+	JsonSpan op;
+	JsonSpan connector;
+	JsonSpan db;
+	JsonSpan schema_name;	/* payload.source.schema */
+	JsonSpan table;
+	JsonSpan snapshot;
+	JsonSpan txid;			/* payload.transaction.id, or payload.id of a transaction boundary */
+	JsonSpan txstatus;		/* payload.status of a transaction boundary */
+	List * before;			/* list of DbzFlatColumn */
+	List * after;			/* list of DbzFlatColumn */
+} DbzFlatEvent;
+
+/* state of the streaming event parser */
+typedef struct flatEventParseState
+{
+	JsonLexContext * lex;
+	DbzFlatEvent * event;
+	JsonSpan names[FLAT_EVENT_MAX_DEPTH + 1];			/* current field name per level */
+	const char * valuestart[FLAT_EVENT_MAX_DEPTH + 1];	/* where its value starts */
+} FlatEventParseState;
+
+/* read position in a binary change event */
+typedef struct binaryEventReader
+{
+	const char * data;
+	Size len;
+	Size offset;
+} BinaryEventReader;
+
 typedef struct datatypeHashKey
 {
 	char extTypeName[SYNCHDB_DATATYPE_NAME_SIZE];
@@ -149,13 +288,31 @@ typedef struct transformExpressionHashEntry
 {
 	TransformExpressionHashKey key;
 	char pgsqlTransExpress[SYNCHDB_TRANSFORM_EXPRESSION_SIZE];
+	TransformFunction function;	/* kind is TRANSFORM_FUNC_NONE if none */
 } TransformExpressionHashEntry;
 
+/* table created without its primary key during initial snapshot */
+typedef struct fastLoadHashEntry
+{
+	DataCacheKey key;
+	char * pkquery;		/* ALTER TABLE statement that adds the primary key */
+	ConnectorType type;
+} FastLoadHashEntry;
+
 /* Function prototypes */
 int fc_processDBZChangeEvent(const char * event, SynchdbStatistics * myBatchStats);
+int fc_processDBZBinaryChangeEvent(const char * event, Size len, SynchdbStatistics * myBatchStats);
 ConnectorType fc_get_connector_type(const char * connector);
 void fc_initFormatConverter(ConnectorType connectorType);
 void fc_deinitFormatConverter(ConnectorType connectorType);
 bool fc_load_rules(ConnectorType connectorType, const char * rulefile);
+bool fc_snapshotFastLoadPending(void);
+bool fc_snapshotInProgress(void);
+void fc_finishSnapshotFastLoad(void);
+void fc_loadSnapshotFastLoad(ConnectorType type, const char * name);
+void fc_clearSnapshotFastLoadFile(void);
+ChangeEventRoute fc_getChangeEventRoute(const char * event, uint32 * hash, char ** txid);
+char * fc_decodeUnscaledDecimal(const unsigned char * bytes, int len, int scale, int32 typmod, Datum * numeric);
+char * fc_decodeTemporal(const char * value, const char * semantictype, Oid datatype, int32 typmod);
 
 #endif /* SYNCHDB_FORMAT_CONVERTER_H_ */
@@ -0,0 +1,893 @@
+/*
+ * parallel_apply.c
+ *
+ * Implementation of parallel apply for SynchDB
+ *
+ * In parallel apply mode, a connector worker no longer applies the
+ * change events it receives from Debezium by itself. It dispatches
+ * them to a fixed set of apply workers through shared memory queues,
+ * by a hash of their target table and primary key values, so changes
+ * to the same row are always applied by the same apply worker and in
+ * order. Events that cannot be routed this way, such as DDLs, are
+ * applied by the connector worker once all apply workers have caught
+ * up. A batch is reported complete to Debezium only after all apply
+ * workers have committed their share of it.
+ *
+ * With Debezium's transaction metadata, change events are instead
+ * dispatched a source transaction at a time. The writeset of a source
+ * transaction, the hashes of the rows it changes, tells which earlier
+ * transactions it depends on. It is sent to the apply worker of its
+ * latest dependency and waits for the other ones to commit before it
+ * is applied, so transactions that do not touch the same rows are
+ * applied and committed concurrently.
+ *
+ * Parts of a batch are committed before Debezium is told the batch is
+ * complete: at every event applied by the connector worker and, with
+ * source transactions, at every transaction. If the batch fails after
+ * that, Debezium sends it again, so parallel apply requires inserts to
+ * be applied as upserts. Each apply worker keeps one transaction open
+ * for its share of a batch, so changes that could conflict across rows,
+ * those of tables with unique indexes on other columns than their key
+ * or foreign keys, are all sent to the same apply worker.
+ *
+ * Copyright (c) Hornetlabs Technology, Inc.
+ *
+ */
+
+#include "postgres.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "access/xact.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/dsm.h"
+#include "storage/latch.h"
+#include "storage/shm_mq.h"
+#include "tcop/tcopprot.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+#include "utils/wait_event.h"
+#include "format_converter.h"
+#include "replication_agent.h"
+#include "parallel_apply.h"
+
+/* external global variables */
+extern int myConnectorId;
+extern bool synchdb_parallel_apply_transactions;
+extern bool synchdb_dml_upsert;
+extern bool synchdb_dml_use_spi;
+
+/* true in apply worker processes */
+bool am_parallel_apply_worker = false;
+
+/* connector worker side state of the parallel apply group */
+static dsm_segment * paSegment = NULL;
+static ParallelApplyShared * paShared = NULL;
+static int paNumWorkers = 0;
+static shm_mq_handle * paQueues[SYNCHDB_PARALLEL_APPLY_MAX_WORKERS];
+static BackgroundWorkerHandle * paHandles[SYNCHDB_PARALLEL_APPLY_MAX_WORKERS];
+static uint64 paSyncSeq = 0;
+
+/* source transaction tracking of the connector worker */
+static bool paTransactions = false;		/* dispatch source transactions as a whole */
+static MemoryContext paTxnContext = NULL;
+static char * paTxnId = NULL;			/* source transaction being collected */
+static List * paTxnEvents = NIL;		/* its change events */
+static List * paTxnHashes = NIL;		/* and its writeset */
+static uint64 paTxnSeq = 0;
+static int paNextWorker = 0;
+static HTAB * paWriterHash = NULL;		/* row hash to ParallelApplyWriter */
+static bool paTxnsSinceSync = false;	/* transactions dispatched since last sync */
+static bool paKeyedSinceSync = false;	/* events dispatched outside of transactions since last sync */
+
+PGDLLEXPORT void synchdb_apply_worker_main(Datum main_arg);
+
+/*
+ * pa_header_size - Size of the parallel apply header in dynamic shared memory
+ *
+ * @param nworkers: number of apply workers
+ *
+ * @return size of ParallelApplyShared with nworkers worker states
+ */
+static Size
+pa_header_size(int nworkers)
+{
+	return MAXALIGN(offsetof(ParallelApplyShared, workers) +
+					sizeof(ParallelApplyWorker) * nworkers);
+}
+
+/*
+ * pa_queue_address - Locate the shared memory queue of an apply worker
+ *
+ * @param shared: parallel apply header in dynamic shared memory
+ * @param workerno: apply worker number
+ *
+ * @return address of the queue
+ */
+static shm_mq *
+pa_queue_address(ParallelApplyShared * shared, int workerno)
+{
+	return (shm_mq *) ((char *) shared + pa_header_size(shared->nworkers) +
+					   (Size) workerno * SYNCHDB_PARALLEL_APPLY_QUEUE_SIZE);
+}
+
+/*
+ * pa_addStatistics - Add the statistics of applied change events
+ *
+ * This function adds the change event counters collected by an apply
+ * worker to the batch statistics of the connector worker. Batch and
+ * JNI counters are kept by the connector worker itself.
+ *
+ * @param dst: statistics to add to
+ * @param src: statistics to add
+ */
+static void
+pa_addStatistics(SynchdbStatistics * dst, const SynchdbStatistics * src)
+{
+	dst->stats_ddl += src->stats_ddl;
+	dst->stats_dml += src->stats_dml;
+	dst->stats_read += src->stats_read;
+	dst->stats_create += src->stats_create;
+	dst->stats_update += src->stats_update;
+	dst->stats_delete += src->stats_delete;
+	dst->stats_bad_change_event += src->stats_bad_change_event;
+}
+
+/*
+ * pa_send - Send a message to an apply worker
+ *
+ * @param workerno: apply worker number
+ * @param iov: message parts
+ * @param iovcnt: number of message parts
+ * @param flush: true to make the message visible to the apply worker right away
+ */
+static void
+pa_send(int workerno, shm_mq_iovec * iov, int iovcnt, bool flush)
+{
+	shm_mq_result res;
+
+	res = shm_mq_sendv(paQueues[workerno], iov, iovcnt, false, flush);
+	if (res != SHM_MQ_SUCCESS)
+	{
+		/* the apply worker has reported the error that made it exit */
+		elog(ERROR, "synchdb apply worker %d exited unexpectedly", workerno);
+	}
+}
+
+/*
+ * pa_leaderDetach - Let apply workers know the connector worker is gone
+ *
+ * Apply workers waiting for a dependency to commit are not waiting on their
+ * queues, so they are woken up explicitly to notice.
+ *
+ * @param seg: the parallel apply segment
+ * @param arg: parallel apply header in the segment
+ */
+static void
+pa_leaderDetach(dsm_segment * seg, Datum arg)
+{
+	ParallelApplyShared * shared = (ParallelApplyShared *) DatumGetPointer(arg);
+	int i;
+
+	shared->leaderExited = true;
+	for (i = 0; i < shared->nworkers; i++)
+	{
+		ParallelApplyWorker * worker = &shared->workers[i];
+		PGPROC * proc;
+
+		SpinLockAcquire(&worker->mutex);
+		proc = worker->proc;
+		SpinLockRelease(&worker->mutex);
+
+		if (proc)
+			SetLatch(&proc->procLatch);
+	}
+}
+
+/*
+ * pa_startWorkers - Start the apply workers of this connector worker
+ *
+ * This function creates the dynamic shared memory used to talk to the
+ * apply workers and registers them. If not all of them can be registered,
+ * the ones already started are stopped and change events are applied by
+ * the connector worker as usual.
+ *
+ * @param nworkers: number of apply workers to start
+ * @param type: connector type
+ * @param conninfo: connection information of this connector
+ *
+ * @return true if apply workers are started, false otherwise
+ */
+bool
+pa_startWorkers(int nworkers, ConnectorType type, const ConnectionInfo * conninfo)
+{
+	MemoryContext oldcontext;
+	Size segsize;
+	int i;
+
+	if (nworkers <= 0)
+		return false;
+
+	/* changes committed before a batch fails are applied again when it is sent again */
+	if (!synchdb_dml_upsert || synchdb_dml_use_spi)
+	{
+		elog(WARNING, "synchdb.parallel_apply_workers requires synchdb.dml_upsert on and "
+			 "synchdb.dml_use_spi off, change events are applied without apply workers");
+		return false;
+	}
+
+	nworkers = Min(nworkers, SYNCHDB_PARALLEL_APPLY_MAX_WORKERS);
+	segsize = pa_header_size(nworkers) + (Size) nworkers * SYNCHDB_PARALLEL_APPLY_QUEUE_SIZE;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	/* the segment lives as long as this connector worker */
+	paSegment = dsm_create(segsize, 0);
+	dsm_pin_mapping(paSegment);
+	paShared = (ParallelApplyShared *) dsm_segment_address(paSegment);
+	on_dsm_detach(paSegment, pa_leaderDetach, PointerGetDatum(paShared));
+
+	memset(paShared, 0, pa_header_size(nworkers));
+	paShared->connectorId = myConnectorId;
+	paShared->type = type;
+	paShared->nworkers = nworkers;
+	paShared->leader = MyProc;
+	strlcpy(paShared->dstdb, conninfo->dstdb, sizeof(paShared->dstdb));
+	strlcpy(paShared->rulefile, conninfo->rulefile, sizeof(paShared->rulefile));
+
+	for (i = 0; i < nworkers; i++)
+	{
+		shm_mq * mq;
+
+		SpinLockInit(&paShared->workers[i].mutex);
+		paShared->workers[i].pid = InvalidPid;
+
+		mq = shm_mq_create(pa_queue_address(paShared, i), SYNCHDB_PARALLEL_APPLY_QUEUE_SIZE);
+		shm_mq_set_sender(mq, MyProc);
+	}
+
+	for (i = 0; i < nworkers; i++)
+	{
+		BackgroundWorker worker;
+
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+		worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+		worker.bgw_restart_time = BGW_NEVER_RESTART;
+		strcpy(worker.bgw_library_name, "synchdb");
+		strcpy(worker.bgw_function_name, "synchdb_apply_worker_main");
+		snprintf(worker.bgw_name, BGW_MAXLEN, "synchdb apply worker %d for connector %d",
+				 i, myConnectorId);
+		snprintf(worker.bgw_type, BGW_MAXLEN, "synchdb apply worker");
+		worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(paSegment));
+		memcpy(worker.bgw_extra, &i, sizeof(int));
+		worker.bgw_notify_pid = MyProcPid;
+
+		if (!RegisterDynamicBackgroundWorker(&worker, &paHandles[i]))
+		{
+			elog(WARNING, "could not register synchdb apply worker %d, "
+				 "change events are applied without apply workers", i);
+			MemoryContextSwitchTo(oldcontext);
+			pa_stopWorkers();
+			return false;
+		}
+
+		paQueues[i] = shm_mq_attach(pa_queue_address(paShared, i), paSegment, paHandles[i]);
+		paNumWorkers = i + 1;
+	}
+
+	paTransactions = synchdb_parallel_apply_transactions;
+	if (paTransactions)
+	{
+		HASHCTL hash_ctl;
+
+		paTxnContext = AllocSetContextCreate(TopMemoryContext,
+											 "SYNCHDB_PARALLEL_APPLY_TXN",
+											 ALLOCSET_DEFAULT_SIZES);
+
+		memset(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(uint32);
+		hash_ctl.entrysize = sizeof(ParallelApplyWriter);
+		hash_ctl.hcxt = TopMemoryContext;
+
+		paWriterHash = hash_create("Parallel apply writeset Hash Table",
+								   4096,
+								   &hash_ctl,
+								   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	elog(LOG, "started %d synchdb apply workers for connector %d%s", nworkers, myConnectorId,
+		 paTransactions ? " applying source transactions" : "");
+	return true;
+}
+
+/*
+ * pa_stopWorkers - Stop the apply workers of this connector worker
+ *
+ * Apply workers exit when their queues are detached. Changes they have
+ * not been asked to commit are rolled back.
+ */
+void
+pa_stopWorkers(void)
+{
+	int i;
+
+	if (!paSegment)
+		return;
+
+	for (i = 0; i < paNumWorkers; i++)
+	{
+		if (paQueues[i])
+		{
+			shm_mq_detach(paQueues[i]);
+			paQueues[i] = NULL;
+		}
+	}
+
+	for (i = 0; i < SYNCHDB_PARALLEL_APPLY_MAX_WORKERS; i++)
+	{
+		if (paHandles[i])
+		{
+			(void) WaitForBackgroundWorkerShutdown(paHandles[i]);
+			pfree(paHandles[i]);
+			paHandles[i] = NULL;
+		}
+	}
+
+	dsm_detach(paSegment);
+	paSegment = NULL;
+	paShared = NULL;
+	paNumWorkers = 0;
+
+	if (paWriterHash)
+	{
+		hash_destroy(paWriterHash);
+		paWriterHash = NULL;
+	}
+	if (paTxnContext)
+	{
+		MemoryContextDelete(paTxnContext);
+		paTxnContext = NULL;
+	}
+	paTransactions = false;
+	paTxnId = NULL;
+	paTxnEvents = NIL;
+	paTxnHashes = NIL;
+}
+
+/*
+ * pa_isActive - Check if change events are dispatched to apply workers
+ *
+ * @return true if apply workers are running for this connector worker
+ */
+bool
+pa_isActive(void)
+{
+	return paNumWorkers > 0;
+}
+
+/*
+ * pa_applyTransactions - Check if source transactions are dispatched as a whole
+ *
+ * @return true if apply workers apply change events in source transactions
+ */
+bool
+pa_applyTransactions(void)
+{
+	return pa_isActive() && paTransactions;
+}
+
+/*
+ * pa_flushTransaction - Dispatch the source transaction collected so far
+ *
+ * This function finds the last transactions that changed the rows in the
+ * writeset of the collected transaction. Apply workers apply transactions
+ * in the order they receive them, so the transaction is sent to the worker
+ * of its latest dependency and only waits for dependencies on other workers.
+ * Transactions without dependencies are spread round robin.
+ */
+static void
+pa_flushTransaction(void)
+{
+	uint64 deps[SYNCHDB_PARALLEL_APPLY_MAX_WORKERS] = {0};
+	char msg[1 + sizeof(uint64) * (SYNCHDB_PARALLEL_APPLY_MAX_WORKERS + 1)];
+	char msgtype = PA_MSG_EVENT;
+	shm_mq_iovec iov[2];
+	ListCell * cell;
+	ParallelApplyWriter * writer;
+	int workerno = -1, i;
+	uint64 seq;
+
+	if (paTxnEvents == NIL)
+	{
+		paTxnId = NULL;
+		return;
+	}
+
+	seq = ++paTxnSeq;
+	foreach(cell, paTxnHashes)
+	{
+		uint32 hash = (uint32) lfirst_int(cell);
+
+		writer = (ParallelApplyWriter *) hash_search(paWriterHash, &hash, HASH_FIND, NULL);
+		if (writer && writer->txnseq > deps[writer->workerno])
+			deps[writer->workerno] = writer->txnseq;
+	}
+
+	for (i = 0; i < paNumWorkers; i++)
+	{
+		if (deps[i] > 0 && (workerno < 0 || deps[i] > deps[workerno]))
+			workerno = i;
+	}
+
+	if (workerno < 0)
+	{
+		workerno = paNextWorker;
+		paNextWorker = (paNextWorker + 1) % paNumWorkers;
+	}
+	deps[workerno] = 0;
+
+	elog(DEBUG1, "dispatching source transaction %s (%d events) as %llu to apply worker %d",
+		 paTxnId, list_length(paTxnEvents), (unsigned long long) seq, workerno);
+
+	msg[0] = PA_MSG_TXN_BEGIN;
+	memcpy(&msg[1], &seq, sizeof(uint64));
+	memcpy(&msg[1 + sizeof(uint64)], deps, sizeof(uint64) * paNumWorkers);
+	iov[0].data = msg;
+	iov[0].len = 1 + sizeof(uint64) * (paNumWorkers + 1);
+	pa_send(workerno, iov, 1, false);
+
+	foreach(cell, paTxnEvents)
+	{
+		const char * event = (const char *) lfirst(cell);
+
+		iov[0].data = &msgtype;
+		iov[0].len = 1;
+		iov[1].data = event;
+		iov[1].len = strlen(event) + 1;
+		pa_send(workerno, iov, 2, false);
+	}
+
+	msg[0] = PA_MSG_TXN_COMMIT;
+	iov[0].data = msg;
+	iov[0].len = 1 + sizeof(uint64);
+	pa_send(workerno, iov, 1, true);
+
+	/* this transaction is now the last writer of its rows */
+	foreach(cell, paTxnHashes)
+	{
+		uint32 hash = (uint32) lfirst_int(cell);
+
+		writer = (ParallelApplyWriter *) hash_search(paWriterHash, &hash, HASH_ENTER, NULL);
+		writer->workerno = workerno;
+		writer->txnseq = seq;
+	}
+
+	paTxnsSinceSync = true;
+	paTxnId = NULL;
+	paTxnEvents = NIL;
+	paTxnHashes = NIL;
+	MemoryContextReset(paTxnContext);
+}
+
+/*
+ * pa_syncWorkers - Wait for all apply workers to commit
+ *
+ * This function asks all apply workers to commit the change events
+ * dispatched to them so far and waits for them to acknowledge. The
+ * statistics of the change events they have applied are then added
+ * to myBatchStats.
+ *
+ * @param myBatchStats: batch statistics of the connector worker
+ */
+void
+pa_syncWorkers(SynchdbStatistics * myBatchStats)
+{
+	char msg[1 + sizeof(uint64)];
+	shm_mq_iovec iov;
+	int i;
+
+	if (!pa_isActive())
+		return;
+
+	/* a source transaction split across batches is committed in parts */
+	if (paTransactions)
+		pa_flushTransaction();
+
+	paSyncSeq++;
+	msg[0] = PA_MSG_SYNC;
+	memcpy(&msg[1], &paSyncSeq, sizeof(uint64));
+	iov.data = msg;
+	iov.len = sizeof(msg);
+
+	for (i = 0; i < paNumWorkers; i++)
+		pa_send(i, &iov, 1, true);
+
+	for (;;)
+	{
+		int nacked = 0;
+
+		for (i = 0; i < paNumWorkers; i++)
+		{
+			ParallelApplyWorker * worker = &paShared->workers[i];
+			bool acked;
+			pid_t pid;
+
+			SpinLockAcquire(&worker->mutex);
+			acked = (worker->ackedSync >= paSyncSeq);
+			SpinLockRelease(&worker->mutex);
+
+			if (acked)
+				nacked++;
+			else if (GetBackgroundWorkerPid(paHandles[i], &pid) == BGWH_STOPPED)
+				elog(ERROR, "synchdb apply worker %d exited unexpectedly", i);
+		}
+
+		if (nacked == paNumWorkers)
+			break;
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 1000,
+						 PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	for (i = 0; i < paNumWorkers; i++)
+	{
+		ParallelApplyWorker * worker = &paShared->workers[i];
+
+		SpinLockAcquire(&worker->mutex);
+		pa_addStatistics(myBatchStats, &worker->stats);
+		memset(&worker->stats, 0, sizeof(SynchdbStatistics));
+		SpinLockRelease(&worker->mutex);
+	}
+
+	/* everything is committed, there is nothing left to depend on */
+	if (paWriterHash && paTxnsSinceSync)
+	{
+		HASH_SEQ_STATUS status;
+		ParallelApplyWriter * writer;
+
+		hash_seq_init(&status, paWriterHash);
+		while ((writer = (ParallelApplyWriter *) hash_seq_search(&status)) != NULL)
+			hash_search(paWriterHash, &writer->hash, HASH_REMOVE, NULL);
+	}
+	paTxnsSinceSync = false;
+	paKeyedSinceSync = false;
+}
+
+/*
+ * pa_dispatchEvent - Dispatch a change event to an apply worker
+ *
+ * This function sends a JSON change event to the apply worker chosen by
+ * the hash of its target table and primary key values, or adds it to the
+ * source transaction being collected. Events that cannot be routed are
+ * applied right here after all apply workers have committed, and committed
+ * before anything else is dispatched. Must be called within a transaction,
+ * which may be committed and restarted by this function.
+ *
+ * @param event: JSON change event
+ * @param myBatchStats: batch statistics of the connector worker
+ */
+void
+pa_dispatchEvent(const char * event, SynchdbStatistics * myBatchStats)
+{
+	uint32 hash = 0;
+	char * txid = NULL;
+	char msgtype = PA_MSG_EVENT;
+	shm_mq_iovec iov[2];
+	ChangeEventRoute route;
+
+	route = fc_getChangeEventRoute(event, &hash, &txid);
+	if (route == ROUTE_TXN_BOUNDARY)
+	{
+		if (paTransactions)
+			pa_flushTransaction();
+		return;
+	}
+
+	if (route == ROUTE_SERIAL)
+	{
+		/* everything dispatched so far must be applied before this event */
+		pa_syncWorkers(myBatchStats);
+
+		if (fc_processDBZChangeEvent(event, myBatchStats) != 0)
+			elog(DEBUG1, "pa_dispatchEvent: Failed to process event");
+
+		/* and this event must be visible to everything dispatched after it */
+		ra_endBatchApply();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+
+		StartTransactionCommand();
+		PushActiveSnapshot(GetTransactionSnapshot());
+		ra_beginBatchApply();
+		return;
+	}
+
+	if (paTransactions && txid)
+	{
+		MemoryContext oldcontext;
+
+		if (paTxnId && strcmp(paTxnId, txid))
+			pa_flushTransaction();
+
+		/* rows changed outside of source transactions are not tracked in writesets */
+		if (!paTxnId && paKeyedSinceSync)
+			pa_syncWorkers(myBatchStats);
+
+		oldcontext = MemoryContextSwitchTo(paTxnContext);
+		if (!paTxnId)
+			paTxnId = pstrdup(txid);
+		paTxnEvents = lappend(paTxnEvents, pstrdup(event));
+		paTxnHashes = lappend_int(paTxnHashes, (int) hash);
+		MemoryContextSwitchTo(oldcontext);
+
+		pfree(txid);
+		return;
+	}
+
+	/* and neither are the writesets of source transactions by hash routing */
+	if (paTransactions && (paTxnId || paTxnsSinceSync))
+		pa_syncWorkers(myBatchStats);
+	paKeyedSinceSync = true;
+
+	iov[0].data = &msgtype;
+	iov[0].len = 1;
+	iov[1].data = event;
+	iov[1].len = strlen(event) + 1;
+
+	pa_send(hash % paNumWorkers, iov, 2, false);
+}
+
+/*
+ * pa_waitForDependencies - Wait for the dependencies of a source transaction
+ *
+ * This function returns once every apply worker has committed the source
+ * transaction the connector worker found a dependency on. It exits the
+ * apply worker if the connector worker goes away meanwhile.
+ *
+ * @param shared: parallel apply header in dynamic shared memory
+ * @param deps: sequence number of the last dependency per apply worker, 0 for none
+ */
+static void
+pa_waitForDependencies(ParallelApplyShared * shared, const uint64 * deps)
+{
+	for (;;)
+	{
+		bool ready = true;
+		int i;
+
+		for (i = 0; i < shared->nworkers; i++)
+		{
+			ParallelApplyWorker * worker = &shared->workers[i];
+			uint64 committed;
+
+			if (deps[i] == 0)
+				continue;
+
+			SpinLockAcquire(&worker->mutex);
+			committed = worker->committedTxn;
+			SpinLockRelease(&worker->mutex);
+
+			if (committed < deps[i])
+			{
+				ready = false;
+				break;
+			}
+		}
+
+		if (ready)
+			return;
+
+		if (shared->leaderExited)
+		{
+			elog(LOG, "synchdb connector worker has exited, apply worker shutting down");
+			proc_exit(0);
+		}
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 1000,
+						 PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * synchdb_apply_worker_main - Main entry point for SynchDB apply workers
+ *
+ * An apply worker applies the change events it receives from its connector
+ * worker in a transaction that is committed when the connector worker asks
+ * for it. It exits when the connector worker detaches from its queue.
+ */
+void
+synchdb_apply_worker_main(Datum main_arg)
+{
+	dsm_segment * seg;
+	ParallelApplyShared * shared;
+	ParallelApplyWorker * self;
+	shm_mq_handle * mqh;
+	SynchdbStatistics myStats = {0};
+	bool intxn = false;
+	int workerno;
+
+	am_parallel_apply_worker = true;
+
+	/* Establish signal handlers */
+	pqsignal(SIGTERM, die);
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	BackgroundWorkerUnblockSignals();
+
+	seg = dsm_attach(DatumGetUInt32(main_arg));
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map synchdb parallel apply shared memory segment")));
+	dsm_pin_mapping(seg);
+
+	shared = (ParallelApplyShared *) dsm_segment_address(seg);
+	memcpy(&workerno, MyBgworkerEntry->bgw_extra, sizeof(int));
+	if (workerno < 0 || workerno >= shared->nworkers)
+		elog(ERROR, "invalid synchdb apply worker number %d", workerno);
+
+	self = &shared->workers[workerno];
+
+	/* errors are reported as the connector's errors */
+	myConnectorId = shared->connectorId;
+	synchdb_init_shmem();
+
+	shm_mq_set_receiver(pa_queue_address(shared, workerno), MyProc);
+	mqh = shm_mq_attach(pa_queue_address(shared, workerno), seg, NULL);
+
+	/* Connect to the connector's destination database */
+	BackgroundWorkerInitializeConnection(shared->dstdb, NULL, 0);
+
+	fc_initFormatConverter(shared->type);
+	if (strlen(shared->rulefile) > 0 && strcasecmp(shared->rulefile, "null"))
+		fc_load_rules(shared->type, shared->rulefile);
+
+	SpinLockAcquire(&self->mutex);
+	self->pid = MyProcPid;
+	self->proc = MyProc;
+	SpinLockRelease(&self->mutex);
+
+	elog(LOG, "synchdb apply worker %d started for connector %d", workerno, myConnectorId);
+
+	for (;;)
+	{
+		shm_mq_result res;
+		Size nbytes;
+		void * data;
+		const char * msg;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		res = shm_mq_receive(mqh, &nbytes, &data, false);
+		if (res != SHM_MQ_SUCCESS)
+			break;
+
+		msg = (const char *) data;
+		if (nbytes < 1)
+			continue;
+
+		switch (msg[0])
+		{
+			case PA_MSG_EVENT:
+			{
+				if (!intxn)
+				{
+					StartTransactionCommand();
+					PushActiveSnapshot(GetTransactionSnapshot());
+					ra_beginBatchApply();
+					intxn = true;
+				}
+
+				elog(DEBUG1, "Processing DBZ Event: %s", msg + 1);
+				if (fc_processDBZChangeEvent(msg + 1, &myStats) != 0)
+					elog(DEBUG1, "synchdb apply worker %d: Failed to process event", workerno);
+				break;
+			}
+			case PA_MSG_SYNC:
+			{
+				uint64 seq;
+
+				memcpy(&seq, msg + 1, sizeof(uint64));
+				if (intxn)
+				{
+					ra_endBatchApply();
+					PopActiveSnapshot();
+					CommitTransactionCommand();
+					intxn = false;
+				}
+
+				SpinLockAcquire(&self->mutex);
+				pa_addStatistics(&self->stats, &myStats);
+				self->ackedSync = seq;
+				SpinLockRelease(&self->mutex);
+
+				memset(&myStats, 0, sizeof(myStats));
+				SetLatch(&shared->leader->procLatch);
+				break;
+			}
+			case PA_MSG_TXN_BEGIN:
+			{
+				uint64 seq;
+				uint64 deps[SYNCHDB_PARALLEL_APPLY_MAX_WORKERS];
+
+				memcpy(&seq, msg + 1, sizeof(uint64));
+				memcpy(deps, msg + 1 + sizeof(uint64), sizeof(uint64) * shared->nworkers);
+
+				pa_waitForDependencies(shared, deps);
+
+				elog(DEBUG1, "synchdb apply worker %d: applying source transaction %llu",
+					 workerno, (unsigned long long) seq);
+				if (!intxn)
+				{
+					StartTransactionCommand();
+					PushActiveSnapshot(GetTransactionSnapshot());
+					ra_beginBatchApply();
+					intxn = true;
+				}
+				break;
+			}
+			case PA_MSG_TXN_COMMIT:
+			{
+				uint64 seq;
+				int i;
+
+				memcpy(&seq, msg + 1, sizeof(uint64));
+				if (intxn)
+				{
+					ra_endBatchApply();
+					PopActiveSnapshot();
+					CommitTransactionCommand();
+					intxn = false;
+				}
+
+				SpinLockAcquire(&self->mutex);
+				self->committedTxn = seq;
+				SpinLockRelease(&self->mutex);
+
+				/* wake up apply workers that may wait for this transaction */
+				for (i = 0; i < shared->nworkers; i++)
+				{
+					ParallelApplyWorker * worker = &shared->workers[i];
+					PGPROC * proc;
+
+					if (worker == self)
+						continue;
+
+					SpinLockAcquire(&worker->mutex);
+					proc = worker->proc;
+					SpinLockRelease(&worker->mutex);
+
+					if (proc)
+						SetLatch(&proc->procLatch);
+				}
+				break;
+			}
+			default:
+				elog(ERROR, "unexpected message type %d received by synchdb apply worker", msg[0]);
+				break;
+		}
+	}
+
+	/* the connector worker has gone away, anything not committed is rolled back */
+	elog(LOG, "synchdb apply worker %d shutting down", workerno);
+	fc_deinitFormatConverter(shared->type);
+	proc_exit(0);
+}
@@ -0,0 +1,87 @@
+/*
+ * parallel_apply.h
+ *
+ * Header file for the SynchDB parallel apply module
+ *
+ * This file defines the data structures and function prototypes used
+ * by a connector worker to dispatch change events to a set of apply
+ * workers through shared memory queues.
+ *
+ * Key components:
+ * - Dynamic shared memory layout shared by a connector worker and its
+ *   apply workers
+ * - Function prototypes for starting, feeding, synchronizing and stopping
+ *   apply workers
+ *
+ * Copyright (c) 2024 Hornetlabs Technology, Inc.
+ *
+ */
+
+#ifndef SYNCHDB_PARALLEL_APPLY_H_
+#define SYNCHDB_PARALLEL_APPLY_H_
+
+#include "storage/proc.h"
+#include "storage/spin.h"
+#include "synchdb.h"
+
+#define SYNCHDB_PARALLEL_APPLY_MAX_WORKERS 32
+#define SYNCHDB_PARALLEL_APPLY_QUEUE_SIZE (1024 * 1024)
+
+/* message types sent from a connector worker to its apply workers */
+#define PA_MSG_EVENT 'E'	/* a JSON change event to apply */
+#define PA_MSG_SYNC 'S'		/* commit changes applied so far and acknowledge */
+#define PA_MSG_TXN_BEGIN 'B'	/* start a source transaction once its dependencies commit */
+#define PA_MSG_TXN_COMMIT 'C'	/* commit a source transaction */
+
+/**
+ * ParallelApplyWorker - state of one apply worker in dynamic shared memory
+ */
+typedef struct _ParallelApplyWorker
+{
+	slock_t mutex;					/* protects the fields below */
+	pid_t pid;						/* apply worker process ID */
+	PGPROC * proc;					/* apply worker to wake up when a dependency commits */
+	uint64 ackedSync;				/* last sync request acknowledged */
+	uint64 committedTxn;			/* last source transaction committed */
+	SynchdbStatistics stats;		/* statistics not yet collected by connector worker */
+} ParallelApplyWorker;
+
+/**
+ * ParallelApplyShared - dynamic shared memory header of a parallel apply group.
+ * One shm_mq per apply worker follows the worker states
+ */
+typedef struct _ParallelApplyShared
+{
+	int connectorId;
+	ConnectorType type;
+	int nworkers;
+	PGPROC * leader;				/* connector worker to wake up on acknowledgement */
+	bool leaderExited;				/* set when the connector worker goes away */
+	char dstdb[SYNCHDB_CONNINFO_DB_NAME_SIZE];
+	char rulefile[SYNCHDB_CONNINFO_RULEFILENAME_SIZE];
+	ParallelApplyWorker workers[FLEXIBLE_ARRAY_MEMBER];
+} ParallelApplyShared;
+
+/**
+ * ParallelApplyWriter - last source transaction that wrote a row, keyed by the
+ * row hash computed by fc_getChangeEventRoute()
+ */
+typedef struct _ParallelApplyWriter
+{
+	uint32 hash;
+	int workerno;					/* apply worker the transaction went to */
+	uint64 txnseq;					/* sequence number of the transaction */
+} ParallelApplyWriter;
+
+/* true in apply worker processes */
+extern bool am_parallel_apply_worker;
+
+/* Function prototypes */
+bool pa_startWorkers(int nworkers, ConnectorType type, const ConnectionInfo * conninfo);
+void pa_stopWorkers(void);
+bool pa_isActive(void);
+bool pa_applyTransactions(void);
+void pa_dispatchEvent(const char * event, SynchdbStatistics * myBatchStats);
+void pa_syncWorkers(SynchdbStatistics * myBatchStats);
+
+#endif /* SYNCHDB_PARALLEL_APPLY_H_ */
@@ -23,6 +23,7 @@
 #include "utils/rel.h"
 #include "utils/lsyscache.h"
 #include "access/tableam.h"
+#include "access/heapam.h"
 #include "executor/executor.h"
 #include "utils/snapmgr.h"
 #include "parser/parse_relation.h"
@@ -30,12 +31,66 @@
 #include "synchdb.h"
 #include "utils/builtins.h"
 #include "utils/jsonb.h"
+#include "utils/memutils.h"
+#include "access/sysattr.h"
+#include "common/hashfn.h"
+#include "catalog/pg_am_d.h"
+#include "catalog/pg_type.h"
+#include "access/genam.h"
+#include "access/stratnum.h"
+#include "utils/array.h"
+#include "utils/datum.h"
+#include "storage/lmgr.h"
+#include "parser/parse_param.h"
+#include "utils/date.h"
+#include "utils/timestamp.h"
+#include "utils/syscache.h"
+#include "catalog/heap.h"
+#include "catalog/pg_index.h"
+#include "parallel_apply.h"
+#include "utils/portal.h"
 
 /* external global variables */
 extern bool synchdb_dml_use_spi;
+extern bool synchdb_snapshot_fast_load;
+extern bool synchdb_dml_batch_compaction;
+extern bool synchdb_dml_upsert;
+extern bool synchdb_batch_transform_expressions;
 extern uint64 SPI_processed;
 extern int myConnectorId;
 
+/* tables opened by the current batch, NULL if no batch is being applied */
+static HTAB * batchApplyHash = NULL;
+static MemoryContext batchApplyContext = NULL;
+
+/* row changes deferred by batch compaction, in the order they are first seen */
+static HTAB * batchCompactHash = NULL;
+static List * batchCompactList = NIL;
+static MemoryContext batchCompactContext = NULL;
+
+/* statistics of the batch being applied, to count changes that fail when deferred */
+static SynchdbStatistics * batchApplyStats = NULL;
+
+/* tables already reported to locate rows by sequential scan */
+static List * seqScanLookupTables = NIL;
+
+/* prepared plans of data transform expressions, keyed by expression */
+static HTAB * transformPlanHash = NULL;
+
+/* changes of the current batch waiting for their transform expressions, in arrival order */
+static List * transformQueue = NIL;
+static MemoryContext transformQueueContext = NULL;
+
+static int synchdb_handle_insert(List * colval, Oid tableoid, ConnectorType type,
+		PG_DML_COLUMN_INPUT * colinputs, int ncolinputs, bool bulk);
+static int synchdb_handle_update(List * colvalbefore, List * colvalafter, Oid tableoid,
+		ConnectorType type, PG_DML_COLUMN_INPUT * colinputs, int ncolinputs);
+static int synchdb_handle_delete(List * colvalbefore, Oid tableoid, ConnectorType type,
+		PG_DML_COLUMN_INPUT * colinputs, int ncolinputs);
+static bool defer_transformed_change(PG_DML * pgdml, ConnectorType type);
+static void flush_transform_queue(void);
+static void flush_deferred_changes(void);
+
 /*
  * swap_tokens
  *
@@ -63,11 +118,25 @@ swap_tokens(const char * expression, const char * data, const char * wkb, const
 			switch (sp[1])
 			{
 				case 'd':
-					/* %d: data */
+				{
+					/* %d: data, with single quotes escaped */
+					const char *cp;
+
 					sp++;
-					strlcpy(dp, data == NULL ? "null" : data, endp - dp);
-					dp += strlen(dp);
+					if (data == NULL)
+					{
+						strlcpy(dp, "null", endp - dp);
+						dp += strlen(dp);
+						break;
+					}
+					for (cp = data; *cp && dp < endp; cp++)
+					{
+						if (*cp == '\'' && dp + 1 < endp)
+							*dp++ = '\'';
+						*dp++ = *cp;
+					}
 					break;
+				}
 				case 'w':
 					/* %w: well-known-binary for geometry, aka wkb */
 					sp++;
@@ -292,443 +361,403 @@ spi_execute(const char * query, ConnectorType type)
 }
 
 /*
- * synchdb_handle_insert - Custom handler for INSERT operations
+ * colval_to_datum
  *
- * This function performs an INSERT operation without using SPI.
- * It creates a tuple from the provided column values and inserts it into the table.
+ * this function converts the value of a PG_DML_COLUMN_VALUE into a datum of the
+ * attribute at attidx. The type input information prepared in colinputs is used
+ * if available, otherwise it is looked up
  */
-static int
-synchdb_handle_insert(List * colval, Oid tableoid, ConnectorType type)
+static Datum
+colval_to_datum(TupleDesc tupdesc, PG_DML_COLUMN_VALUE * colval, int attidx,
+		PG_DML_COLUMN_INPUT * colinputs)
 {
-	Relation rel;
-	TupleDesc tupdesc;
-	TupleTableSlot *slot;
-	EState	   *estate;
-	RangeTblEntry *rte;
-	List	   *perminfos = NIL;
-	ResultRelInfo *resultRelInfo;
-	ListCell * cell;
-	int i = 0;
+	Form_pg_attribute attr;
+	Oid			typinput;
+	Oid			typioparam;
 
-	/*
-	 * we put in TRY and CATCH block to capture potential exceptions raised
-	 * from PostgreSQL, which would cause this worker to exit. The last error
-	 * messages related with the exception will be stored in synchdb's shared
-	 * memory state so user will have an idea what is wrong.
-	 */
-	PG_TRY();
+	/* date/time and numeric values converted to their internal representation already */
+	if (colval->hasInternalValue)
 	{
-		rel = table_open(tableoid, NoLock);
-
-		/* initialize estate */
-		estate = CreateExecutorState();
-
-		rte = makeNode(RangeTblEntry);
-		rte->rtekind = RTE_RELATION;
-		rte->relid = RelationGetRelid(rel);
-		rte->relkind = rel->rd_rel->relkind;
-		rte->rellockmode = AccessShareLock;
-
-		addRTEPermissionInfo(&perminfos, rte);
-
-		ExecInitRangeTable(estate, list_make1(rte), perminfos);
-		estate->es_output_cid = GetCurrentCommandId(true);
-
-		/* initialize resultRelInfo */
-		resultRelInfo = makeNode(ResultRelInfo);
-		InitResultRelInfo(resultRelInfo, rel, 1, NULL, 0);
-
-		/* turn colval into TupleTableSlot */
-		tupdesc = RelationGetDescr(rel);
-		slot = ExecInitExtraTupleSlot(estate, tupdesc, &TTSOpsVirtual);
-
-		ExecClearTuple(slot);
-
-		/* initialize all values in slot to null */
-		for (i = 0; i < tupdesc->natts; i++)
+		switch (colval->datatype)
 		{
-			slot->tts_isnull[i] = true;
-		}
-
-		/* then we fill valid data to slot */
-		foreach(cell, colval)
-		{
-			PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
-			Form_pg_attribute attr = TupleDescAttr(slot->tts_tupleDescriptor, colval->position - 1);
-			Oid			typinput;
-			Oid			typioparam;
-
-			if (!strcasecmp(colval->value, "NULL"))
-				slot->tts_isnull[colval->position - 1] = true;
-			else
-			{
-				getTypeInputInfo(colval->datatype, &typinput, &typioparam);
-				slot->tts_values[colval->position - 1] =
-					OidInputFunctionCall(typinput, colval->value,
-										 typioparam, attr->atttypmod);
-				slot->tts_isnull[colval->position - 1] = false;
-			}
+			case NUMERICOID:
+				return colval->numericValue;
+			case DATEOID:
+				return DateADTGetDatum((DateADT) colval->internalValue);
+			case TIMEOID:
+				return TimeADTGetDatum((TimeADT) colval->internalValue);
+			case TIMESTAMPOID:
+				return TimestampGetDatum((Timestamp) colval->internalValue);
+			default:
+				break;
 		}
-		ExecStoreVirtualTuple(slot);
+	}
 
-		/* We must open indexes here. */
-		ExecOpenIndices(resultRelInfo, false);
+	if (colinputs)
+		return InputFunctionCall(&colinputs[attidx].finfo, colval->value,
+								 colinputs[attidx].typioparam,
+								 colinputs[attidx].typmod);
 
-		/* Do the insert. */
-		ExecSimpleRelationInsert(resultRelInfo, estate, slot);
+	attr = TupleDescAttr(tupdesc, attidx);
+	getTypeInputInfo(colval->datatype, &typinput, &typioparam);
+	return OidInputFunctionCall(typinput, colval->value,
+								typioparam, attr->atttypmod);
+}
 
-		/* increment command ID */
-		CommandCounterIncrement();
+/*
+ * fill_slot_from_colvals
+ *
+ * this function stores the given list of PG_DML_COLUMN_VALUE into slot as a virtual
+ * tuple. Attributes without a value are set to null. The type input information
+ * prepared in colinputs is used if available, otherwise it is looked up per value
+ */
+static void
+fill_slot_from_colvals(TupleTableSlot * slot, List * colvals,
+		PG_DML_COLUMN_INPUT * colinputs, int ncolinputs)
+{
+	TupleDesc tupdesc = slot->tts_tupleDescriptor;
+	ListCell * cell;
+	int i;
 
-		/* Cleanup. */
-		ExecCloseIndices(resultRelInfo);
+	/* the prepared input information is only good for the tupdesc it was built on */
+	if (ncolinputs != tupdesc->natts)
+		colinputs = NULL;
 
-		table_close(rel, NoLock);
+	ExecClearTuple(slot);
 
-		ExecResetTupleTable(estate->es_tupleTable, false);
-		FreeExecutorState(estate);
+	/* initialize all values in slot to null */
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		slot->tts_isnull[i] = true;
 	}
-	PG_CATCH();
+
+	/* then we fill valid data to slot */
+	foreach(cell, colvals)
 	{
-		ErrorData  *errdata = CopyErrorData();
-		if (errdata)
-		{
-			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
-			snprintf(msg, SYNCHDB_ERRMSG_SIZE, "table %d: %s",
-					tableoid, errdata->message);
-			set_shm_connector_errmsg(myConnectorId, msg);
-			pfree(msg);
-		}
+		PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
+		int attidx = colval->position - 1;
 
-		FreeErrorData(errdata);
-		PG_RE_THROW();
+		/* skip values of columns that do not exist in PostgreSQL */
+		if (attidx < 0 || attidx >= tupdesc->natts)
+			continue;
+
+		if (!strcasecmp(colval->value, "NULL"))
+			continue;
+
+		slot->tts_values[attidx] = colval_to_datum(tupdesc, colval, attidx, colinputs);
+		slot->tts_isnull[attidx] = false;
 	}
-	PG_END_TRY();
-	return 0;
+	ExecStoreVirtualTuple(slot);
 }
 
 /*
- * synchdb_handle_update - Custom handler for UPDATE operations
+ * changed_colvals
  *
- * This function performs an UPDATE operation without using SPI.
- * It locates the existing tuple, creates a new tuple with updated values,
- * and replaces the old tuple with the new one.
+ * this function returns the values of colvalafter that differ from the value of
+ * the same column in colvalbefore. Values are compared as received so no type
+ * input function is called for the columns that did not change
  */
-static int
-synchdb_handle_update(List * colvalbefore, List * colvalafter, Oid tableoid, ConnectorType type)
+static List *
+changed_colvals(List * colvalbefore, List * colvalafter, int natts)
 {
-	Relation rel;
-	TupleDesc tupdesc;
-	TupleTableSlot * remoteslot, * localslot;
-	EState	   *estate;
-	RangeTblEntry *rte;
-	List	   *perminfos = NIL;
-	ResultRelInfo *resultRelInfo;
+	char ** beforevalues = palloc0(sizeof(char *) * natts);
+	List * changed = NIL;
 	ListCell * cell;
-	int i = 0, ret = 0;
-	EPQState	epqstate;
-	bool found;
-	Oid idxoid = InvalidOid;
 
-	/*
-	 * we put in TRY and CATCH block to capture potential exceptions raised
-	 * from PostgreSQL, which would cause this worker to exit. The last error
-	 * messages related with the exception will be stored in synchdb's shared
-	 * memory state so user will have an idea what is wrong.
-	 */
-	PG_TRY();
+	foreach(cell, colvalbefore)
 	{
-		rel = table_open(tableoid, NoLock);
+		PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
 
-		/* initialize estate */
-		estate = CreateExecutorState();
+		if (colval->position >= 1 && colval->position <= natts)
+			beforevalues[colval->position - 1] = colval->value;
+	}
 
-		rte = makeNode(RangeTblEntry);
-		rte->rtekind = RTE_RELATION;
-		rte->relid = RelationGetRelid(rel);
-		rte->relkind = rel->rd_rel->relkind;
-		rte->rellockmode = AccessShareLock;
+	foreach(cell, colvalafter)
+	{
+		PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
+		int attidx = colval->position - 1;
 
-		addRTEPermissionInfo(&perminfos, rte);
+		if (attidx < 0 || attidx >= natts)
+			continue;
 
-		ExecInitRangeTable(estate, list_make1(rte), perminfos);
-		estate->es_output_cid = GetCurrentCommandId(true);
+		if (!beforevalues[attidx] || strcmp(beforevalues[attidx], colval->value))
+			changed = lappend(changed, colval);
+	}
 
-		/* initialize resultRelInfo */
-		resultRelInfo = makeNode(ResultRelInfo);
-		InitResultRelInfo(resultRelInfo, rel, 1, NULL, 0);
+	pfree(beforevalues);
+	return changed;
+}
 
-		/* turn colvalbefore into TupleTableSlot */
-		tupdesc = RelationGetDescr(rel);
+/*
+ * modify_slot_from_colvals
+ *
+ * this function stores the tuple in localslot into slot as a virtual tuple and
+ * replaces the attributes given in colvals only, so the new tuple shares the
+ * unchanged values of the existing one
+ */
+static void
+modify_slot_from_colvals(TupleTableSlot * slot, TupleTableSlot * localslot, List * colvals,
+		PG_DML_COLUMN_INPUT * colinputs, int ncolinputs)
+{
+	TupleDesc tupdesc = slot->tts_tupleDescriptor;
+	ListCell * cell;
+	int natts = tupdesc->natts;
 
-		remoteslot = ExecInitExtraTupleSlot(estate, tupdesc, &TTSOpsVirtual);
-		localslot = table_slot_create(rel, &estate->es_tupleTable);
+	if (ncolinputs != natts)
+		colinputs = NULL;
 
-		ExecClearTuple(remoteslot);
+	/* start from the existing tuple */
+	slot_getallattrs(localslot);
+	ExecClearTuple(slot);
+	memcpy(slot->tts_values, localslot->tts_values, natts * sizeof(Datum));
+	memcpy(slot->tts_isnull, localslot->tts_isnull, natts * sizeof(bool));
 
-		/* initialize all values in slot to null */
-		for (i = 0; i < tupdesc->natts; i++)
-		{
-			remoteslot->tts_isnull[i] = true;
-		}
+	foreach(cell, colvals)
+	{
+		PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
+		int attidx = colval->position - 1;
 
-		/* then we fill valid data to slot */
-		foreach(cell, colvalbefore)
+		if (!strcasecmp(colval->value, "NULL"))
 		{
-			PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
-			Form_pg_attribute attr = TupleDescAttr(remoteslot->tts_tupleDescriptor, colval->position - 1);
-			Oid			typinput;
-			Oid			typioparam;
-
-			if (!strcasecmp(colval->value, "NULL"))
-				remoteslot->tts_isnull[colval->position - 1] = true;
-			else
-			{
-				getTypeInputInfo(colval->datatype, &typinput, &typioparam);
-				remoteslot->tts_values[colval->position - 1] =
-					OidInputFunctionCall(typinput, colval->value,
-										 typioparam, attr->atttypmod);
-				remoteslot->tts_isnull[colval->position - 1] = false;
-			}
+			slot->tts_values[attidx] = (Datum) 0;
+			slot->tts_isnull[attidx] = true;
+			continue;
 		}
-		ExecStoreVirtualTuple(remoteslot);
-		EvalPlanQualInit(&epqstate, estate, NULL, NIL, -1, NIL);
 
-		/* We must open indexes here. */
-		ExecOpenIndices(resultRelInfo, false);
+		slot->tts_values[attidx] = colval_to_datum(tupdesc, colval, attidx, colinputs);
+		slot->tts_isnull[attidx] = false;
+	}
+	ExecStoreVirtualTuple(slot);
+}
 
-		/*
-		 * check if there is a PK or relation identity index that we could use to
-		 * locate the old tuple. If no identity or PK, there may potentially be
-		 * other indexes created on other columns that can be used. But for now,
-		 * we do not bother checking for them. Mark it as todo for later.
-		 */
-		idxoid = GetRelationIdentityOrPK(rel);
-		if (OidIsValid(idxoid))
-		{
-			elog(DEBUG1, "attempt to find old tuple by index");
-			found = RelationFindReplTupleByIndex(rel, idxoid,
-												 LockTupleExclusive,
-												 remoteslot, localslot);
-		}
-		else
-		{
-			elog(DEBUG1, "attempt to find old tuple by seq scan");
-			found = RelationFindReplTupleSeq(rel, LockTupleExclusive,
-											 remoteslot, localslot);
-		}
+/*
+ * find_lookup_index
+ *
+ * This function picks an index of a table without PK or replica identity that
+ * can locate the old tuple from the before image instead of a sequential scan.
+ * Only btree indexes on plain columns without predicate qualify, and unique
+ * ones are preferred because they return at most one candidate row.
+ */
+static Oid
+find_lookup_index(ResultRelInfo * resultRelInfo)
+{
+	Relation rel = resultRelInfo->ri_RelationDesc;
+	Oid lookupidxoid = InvalidOid;
+	bool unique = false;
+	int i, j;
 
-		/*
-		 * localslot should now contain the reference to the old tuple that is yet
-		 * to be updated
-		 */
-		if (found)
-		{
-			/* turn colvalafter into TupleTableSlot */
-			ExecClearTuple(remoteslot);
+	for (i = 0; i < resultRelInfo->ri_NumIndices; i++)
+	{
+		Relation idxrel = resultRelInfo->ri_IndexRelationDescs[i];
+		IndexInfo * indexInfo = resultRelInfo->ri_IndexRelationInfo[i];
+		bool usable;
 
-			/* initialize all values in slot to null */
-			for (i = 0; i < tupdesc->natts; i++)
-			{
-				remoteslot->tts_isnull[i] = true;
-			}
+		if (idxrel->rd_rel->relam != BTREE_AM_OID ||
+			indexInfo->ii_Predicate != NIL ||
+			!indexInfo->ii_ReadyForInserts)
+			continue;
 
-			/* then we fill valid data to slot */
-			foreach(cell, colvalafter)
+		usable = true;
+		for (j = 0; j < indexInfo->ii_NumIndexKeyAttrs; j++)
+		{
+			if (indexInfo->ii_IndexAttrNumbers[j] <= 0)
 			{
-				PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
-				Form_pg_attribute attr = TupleDescAttr(remoteslot->tts_tupleDescriptor, colval->position - 1);
-				Oid			typinput;
-				Oid			typioparam;
-
-				if (!strcasecmp(colval->value, "NULL"))
-					remoteslot->tts_isnull[colval->position - 1] = true;
-				else
-				{
-					getTypeInputInfo(colval->datatype, &typinput, &typioparam);
-					remoteslot->tts_values[colval->position - 1] =
-						OidInputFunctionCall(typinput, colval->value,
-											 typioparam, attr->atttypmod);
-					remoteslot->tts_isnull[colval->position - 1] = false;
-				}
+				usable = false;
+				break;
 			}
-			ExecStoreVirtualTuple(remoteslot);
-
-			EvalPlanQualSetSlot(&epqstate, remoteslot);
-
-			ExecSimpleRelationUpdate(resultRelInfo, estate, &epqstate, localslot,
-									 remoteslot);
 		}
-		else
+		if (!usable)
+			continue;
+
+		if (!OidIsValid(lookupidxoid) || (indexInfo->ii_Unique && !unique))
 		{
-			elog(DEBUG1, "tuple to update not found");
-			ret = -1;
+			lookupidxoid = RelationGetRelid(idxrel);
+			unique = indexInfo->ii_Unique;
 		}
+	}
 
-		/* increment command ID */
-		CommandCounterIncrement();
+	if (OidIsValid(lookupidxoid))
+		elog(DEBUG1, "table %s locates old tuples by index %u",
+			 RelationGetRelationName(rel), lookupidxoid);
 
-		/* Cleanup. */
-		ExecCloseIndices(resultRelInfo);
-		EvalPlanQualEnd(&epqstate);
-		ExecResetTupleTable(estate->es_tupleTable, false);
-		FreeExecutorState(estate);
-		table_close(rel, NoLock);
-	}
-	PG_CATCH();
-	{
-		ErrorData  *errdata = CopyErrorData();
-		if (errdata)
-		{
-			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
-			snprintf(msg, SYNCHDB_ERRMSG_SIZE, "table %d: %s",
-					tableoid, errdata->message);
-			set_shm_connector_errmsg(myConnectorId, msg);
-			pfree(msg);
-		}
+	return lookupidxoid;
+}
 
-		FreeErrorData(errdata);
-		PG_RE_THROW();
-	}
-	PG_END_TRY();
-	return ret;
+/*
+ * use_upsert
+ *
+ * This function returns true if inserts are applied as upserts. Parallel apply
+ * commits parts of a batch early and is only started in upsert mode, which it
+ * keeps even if synchdb.dml_upsert is turned off while it runs.
+ */
+static bool
+use_upsert(void)
+{
+	return synchdb_dml_upsert || am_parallel_apply_worker || pa_isActive();
 }
 
 /*
- * synchdb_handle_delete - Custom handler for DELETE operations
+ * open_apply_table
  *
- * This function performs a DELETE operation without using SPI.
- * It locates the existing tuple based on the provided column values and deletes it.
+ * This function opens the given table and prepares the executor state needed
+ * to apply changes to it: an estate with a result relation, the slots and the
+ * indexes.
  */
-static int
-synchdb_handle_delete(List * colvalbefore, Oid tableoid, ConnectorType type)
+static void
+open_apply_table(BATCH_APPLY_TABLE * applytable, Oid tableoid)
 {
-	Relation rel;
-	TupleDesc tupdesc;
-	TupleTableSlot * remoteslot, * localslot;
-	EState	   *estate;
 	RangeTblEntry *rte;
 	List	   *perminfos = NIL;
-	ResultRelInfo *resultRelInfo;
-	ListCell * cell;
-	int i = 0, ret = 0;
-	EPQState	epqstate;
-	bool found;
-	Oid idxoid = InvalidOid;
+	TupleDesc tupdesc;
+
+	applytable->tableoid = tableoid;
+	applytable->rel = table_open(tableoid, RowExclusiveLock);
+
+	/* initialize estate */
+	applytable->estate = CreateExecutorState();
+
+	rte = makeNode(RangeTblEntry);
+	rte->rtekind = RTE_RELATION;
+	rte->relid = RelationGetRelid(applytable->rel);
+	rte->relkind = applytable->rel->rd_rel->relkind;
+	rte->rellockmode = AccessShareLock;
+
+	addRTEPermissionInfo(&perminfos, rte);
+
+	ExecInitRangeTable(applytable->estate, list_make1(rte), perminfos);
+
+	/* initialize resultRelInfo */
+	applytable->resultRelInfo = makeNode(ResultRelInfo);
+	InitResultRelInfo(applytable->resultRelInfo, applytable->rel, 1, NULL, 0);
+
+	/* remoteslot holds the tuple from change event, localslot the one found in table */
+	tupdesc = RelationGetDescr(applytable->rel);
+	applytable->remoteslot = ExecInitExtraTupleSlot(applytable->estate, tupdesc, &TTSOpsVirtual);
+	applytable->localslot = table_slot_create(applytable->rel, &applytable->estate->es_tupleTable);
+
+	EvalPlanQualInit(&applytable->epqstate, applytable->estate, NULL, NIL, -1, NIL);
+
+	/* We must open indexes here, ready for speculative insertion in upsert mode. */
+	ExecOpenIndices(applytable->resultRelInfo, use_upsert());
 
 	/*
-	 * we put in TRY and CATCH block to capture potential exceptions raised
-	 * from PostgreSQL, which would cause this worker to exit. The last error
-	 * messages related with the exception will be stored in synchdb's shared
-	 * memory state so user will have an idea what is wrong.
+	 * check if there is a PK or relation identity index that we could use to
+	 * locate the old tuple. If no identity or PK, there may potentially be
+	 * other indexes created on other columns that can be used.
 	 */
-	PG_TRY();
+	applytable->idxoid = GetRelationIdentityOrPK(applytable->rel);
+	applytable->lookupidxoid = OidIsValid(applytable->idxoid) ?
+		applytable->idxoid : find_lookup_index(applytable->resultRelInfo);
+	applytable->keyattrs = NULL;
+	if (OidIsValid(applytable->idxoid))
 	{
-		rel = table_open(tableoid, NoLock);
+		applytable->keyattrs = RelationGetIndexAttrBitmap(applytable->rel,
+														  INDEX_ATTR_BITMAP_IDENTITY_KEY);
+		if (bms_is_empty(applytable->keyattrs))
+			applytable->keyattrs = RelationGetIndexAttrBitmap(applytable->rel,
+															  INDEX_ATTR_BITMAP_PRIMARY_KEY);
+	}
+
+	/*
+	 * snapshot rows may be buffered and inserted with table_multi_insert, except
+	 * for tables that need per row processing which ExecSimpleRelationInsert does,
+	 * such as triggers, partition routing or checks and generated columns.
+	 */
+	applytable->multiinsert =
+		applytable->rel->rd_rel->relkind == RELKIND_RELATION &&
+		!applytable->rel->rd_rel->relispartition &&
+		applytable->rel->trigdesc == NULL &&
+		!(tupdesc->constr && tupdesc->constr->has_generated_stored);
 
-		/* initialize estate */
-		estate = CreateExecutorState();
+	/*
+	 * in upsert mode, inserts into tables with a PK or replica identity update
+	 * the existing row on conflict. This is done for the same tables that do
+	 * not need the per row processing of ExecSimpleRelationInsert.
+	 */
+	applytable->upsert = use_upsert() && applytable->multiinsert &&
+		OidIsValid(applytable->idxoid);
 
-		rte = makeNode(RangeTblEntry);
-		rte->rtekind = RTE_RELATION;
-		rte->relid = RelationGetRelid(rel);
-		rte->relkind = rel->rd_rel->relkind;
-		rte->rellockmode = AccessShareLock;
+	/*
+	 * in snapshot fast load mode, rows are inserted frozen like COPY FREEZE does
+	 * and under the same conditions as in CopyFrom(): the table must be created
+	 * or truncated in the current subtransaction so no one else can see them
+	 * before it commits. That is only the case for the batch that creates the
+	 * table, rows of later batches are inserted normally and left to vacuum to
+	 * freeze.
+	 */
+	applytable->frozen = applytable->multiinsert && synchdb_snapshot_fast_load &&
+		(applytable->rel->rd_createSubid == GetCurrentSubTransactionId() ||
+		 applytable->rel->rd_newRelfilelocatorSubid == GetCurrentSubTransactionId()) &&
+		ThereAreNoPriorRegisteredSnapshots() && ThereAreNoReadyPortals();
 
-		addRTEPermissionInfo(&perminfos, rte);
+	/*
+	 * batch compaction applies the net changes of a batch in the order their rows
+	 * are first seen with deletes first, not in the order of the source. This is
+	 * only safe if no constraint other than the key relates different rows, so
+	 * tables with another unique index or a foreign key in either direction are
+	 * not compacted.
+	 */
+	applytable->compact = synchdb_dml_batch_compaction && applytable->keyattrs &&
+		!ra_hasCrossRowConstraints(applytable->rel);
 
-		ExecInitRangeTable(estate, list_make1(rte), perminfos);
-		estate->es_output_cid = GetCurrentCommandId(true);
+	applytable->ownedInputs = NULL;
+	applytable->ownedInputsSource = NULL;
 
-		/* initialize resultRelInfo */
-		resultRelInfo = makeNode(ResultRelInfo);
-		InitResultRelInfo(resultRelInfo, rel, 1, NULL, 0);
+	applytable->bistate = NULL;
+	applytable->bufferedslots = NULL;
+	applytable->nbuffered = 0;
+	applytable->bufferedbytes = 0;
+}
 
-		/* turn colvalbefore into TupleTableSlot */
-		tupdesc = RelationGetDescr(rel);
+/*
+ * flush_apply_table
+ *
+ * This function inserts the snapshot rows buffered for the table with
+ * table_multi_insert and then inserts their index entries.
+ */
+static void
+flush_apply_table(BATCH_APPLY_TABLE * applytable)
+{
+	EState * estate = applytable->estate;
+	ResultRelInfo * resultRelInfo = applytable->resultRelInfo;
+	int i;
 
-		remoteslot = ExecInitExtraTupleSlot(estate, tupdesc, &TTSOpsVirtual);
-		localslot = table_slot_create(rel, &estate->es_tupleTable);
+	if (applytable->nbuffered == 0)
+		return;
 
-		ExecClearTuple(remoteslot);
+	PG_TRY();
+	{
+		estate->es_output_cid = GetCurrentCommandId(true);
 
-		/* initialize all values in slot to null */
-		for (i = 0; i < tupdesc->natts; i++)
-		{
-			localslot->tts_isnull[i] = true;
-		}
+		table_multi_insert(applytable->rel, applytable->bufferedslots,
+						   applytable->nbuffered, estate->es_output_cid,
+						   applytable->frozen ? TABLE_INSERT_FROZEN : 0,
+						   applytable->bistate);
 
-		/* then we fill valid data to slot */
-		foreach(cell, colvalbefore)
+		for (i = 0; i < applytable->nbuffered; i++)
 		{
-			PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
-			Form_pg_attribute attr = TupleDescAttr(remoteslot->tts_tupleDescriptor, colval->position - 1);
-			Oid			typinput;
-			Oid			typioparam;
+			TupleTableSlot * slot = applytable->bufferedslots[i];
 
-			if (!strcasecmp(colval->value, "NULL"))
-				remoteslot->tts_isnull[colval->position - 1] = true;
-			else
+			if (resultRelInfo->ri_NumIndices > 0)
 			{
-				getTypeInputInfo(colval->datatype, &typinput, &typioparam);
-				remoteslot->tts_values[colval->position - 1] =
-					OidInputFunctionCall(typinput, colval->value,
-										 typioparam, attr->atttypmod);
-				remoteslot->tts_isnull[colval->position - 1] = false;
-			}
-		}
-		ExecStoreVirtualTuple(remoteslot);
-		EvalPlanQualInit(&epqstate, estate, NULL, NIL, -1, NIL);
+				List * recheckIndexes;
 
-		/* We must open indexes here. */
-		ExecOpenIndices(resultRelInfo, false);
-
-		/*
-		 * check if there is a PK or relation identity index that we could use to
-		 * locate the old tuple. If no identity or PK, there may potentially be
-		 * other indexes created on other columns that can be used. But for now,
-		 * we do not bother checking for them. Mark it as todo for later.
-		 */
-		idxoid = GetRelationIdentityOrPK(rel);
-		if (OidIsValid(idxoid))
-		{
-			elog(DEBUG1, "attempt to find old tuple by index");
-			found = RelationFindReplTupleByIndex(rel, idxoid,
-												 LockTupleExclusive,
-												 remoteslot, localslot);
-		}
-		else
-		{
-			elog(DEBUG1, "attempt to find old tuple by seq scan");
-			found = RelationFindReplTupleSeq(rel, LockTupleExclusive,
-											 remoteslot, localslot);
+				recheckIndexes = ExecInsertIndexTuples(resultRelInfo, slot, estate,
+													   false, false, NULL, NIL, false);
+				list_free(recheckIndexes);
+				ResetPerTupleExprContext(estate);
+			}
+			ExecClearTuple(slot);
 		}
 
-		/*
-		 * localslot should now contain the reference to the old tuple that is yet
-		 * to be updated
-		 */
-		if (found)
-		{
-			EvalPlanQualSetSlot(&epqstate, localslot);
+		elog(DEBUG1, "inserted %d buffered rows into table %d",
+				applytable->nbuffered, applytable->tableoid);
 
-			ExecSimpleRelationDelete(resultRelInfo, estate, &epqstate, localslot);
-		}
-		else
-		{
-			elog(DEBUG1, "tuple to delete not found");
-			ret = -1;
-		}
+		applytable->nbuffered = 0;
+		applytable->bufferedbytes = 0;
 
 		/* increment command ID */
 		CommandCounterIncrement();
-
-		/* Cleanup. */
-		ExecCloseIndices(resultRelInfo);
-		EvalPlanQualEnd(&epqstate);
-		ExecResetTupleTable(estate->es_tupleTable, false);
-		FreeExecutorState(estate);
-		table_close(rel, NoLock);
 	}
 	PG_CATCH();
 	{
@@ -737,7 +766,7 @@ synchdb_handle_delete(List * colvalbefore, Oid tableoid, ConnectorType type)
 		{
 			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
 			snprintf(msg, SYNCHDB_ERRMSG_SIZE, "table %d: %s",
-					tableoid, errdata->message);
+					applytable->tableoid, errdata->message);
 			set_shm_connector_errmsg(myConnectorId, msg);
 			pfree(msg);
 		}
@@ -746,43 +775,1156 @@ synchdb_handle_delete(List * colvalbefore, Oid tableoid, ConnectorType type)
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
-	return ret;
 }
 
 /*
- * ra_executePGDDL - Execute a PostgreSQL DDL operation
+ * buffer_apply_table_row
  *
- * This function is the entry point for executing DDL operations.
- * It uses SPI to execute the DDL query.
+ * This function copies the row in remoteslot into the table's multi insert
+ * buffer, flushing the buffer when it is full.
  */
-int
-ra_executePGDDL(PG_DDL * pgddl, ConnectorType type)
+static void
+buffer_apply_table_row(BATCH_APPLY_TABLE * applytable, Size rowbytes)
 {
-	if (!pgddl || !pgddl->ddlquery)
-    {
-        elog(WARNING, "Invalid DDL query");
-        return -1;
-    }
-	return spi_execute(pgddl->ddlquery, type);
+	TupleTableSlot * slot;
+	MemoryContext oldContext;
+
+	/* buffered rows skip ExecSimpleRelationInsert so check the constraints here */
+	if (applytable->rel->rd_att->constr)
+		ExecConstraints(applytable->resultRelInfo, applytable->remoteslot,
+						applytable->estate);
+
+	oldContext = MemoryContextSwitchTo(batchApplyContext);
+	if (!applytable->bufferedslots)
+	{
+		applytable->bufferedslots = (TupleTableSlot **)
+			palloc0(sizeof(TupleTableSlot *) * SYNCHDB_MULTI_INSERT_MAX_TUPLES);
+		applytable->bistate = GetBulkInsertState();
+	}
+
+	/* slots are created as needed and reused once flushed */
+	slot = applytable->bufferedslots[applytable->nbuffered];
+	if (!slot)
+	{
+		slot = table_slot_create(applytable->rel, &applytable->estate->es_tupleTable);
+		applytable->bufferedslots[applytable->nbuffered] = slot;
+	}
+	MemoryContextSwitchTo(oldContext);
+
+	ExecCopySlot(slot, applytable->remoteslot);
+	applytable->nbuffered++;
+	applytable->bufferedbytes += rowbytes;
+
+	if (applytable->nbuffered >= SYNCHDB_MULTI_INSERT_MAX_TUPLES ||
+		applytable->bufferedbytes >= SYNCHDB_MULTI_INSERT_MAX_BYTES)
+		flush_apply_table(applytable);
 }
 
 /*
- * ra_executePGDML - Execute a PostgreSQL DML operation
+ * close_apply_table
+ *
+ * This function releases the executor state and the table opened by
+ * open_apply_table().
+ */
+static void
+close_apply_table(BATCH_APPLY_TABLE * applytable)
+{
+	flush_apply_table(applytable);
+
+	if (applytable->bistate)
+		FreeBulkInsertState(applytable->bistate);
+
+	ExecCloseIndices(applytable->resultRelInfo);
+	EvalPlanQualEnd(&applytable->epqstate);
+	ExecResetTupleTable(applytable->estate->es_tupleTable, false);
+	FreeExecutorState(applytable->estate);
+	table_close(applytable->rel, NoLock);
+}
+
+/*
+ * close_batch_tables
+ *
+ * This function closes all the tables opened for the current batch.
+ */
+static void
+close_batch_tables(void)
+{
+	HASH_SEQ_STATUS status;
+	BATCH_APPLY_TABLE * applytable;
+
+	flush_deferred_changes();
+
+	hash_seq_init(&status, batchApplyHash);
+	while ((applytable = (BATCH_APPLY_TABLE *) hash_seq_search(&status)) != NULL)
+	{
+		close_apply_table(applytable);
+		hash_search(batchApplyHash, &applytable->tableoid, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * flush_batch_tables
+ *
+ * This function inserts the snapshot rows buffered by all tables of the current
+ * batch. It is called before any change that must see those rows.
+ */
+static void
+flush_batch_tables(void)
+{
+	HASH_SEQ_STATUS status;
+	BATCH_APPLY_TABLE * applytable;
+
+	hash_seq_init(&status, batchApplyHash);
+	while ((applytable = (BATCH_APPLY_TABLE *) hash_seq_search(&status)) != NULL)
+		flush_apply_table(applytable);
+}
+
+/*
+ * get_apply_table
+ *
+ * This function returns the executor state to apply a change to the given table.
+ * Within a batch, the state opened by the first change to the table is reused.
+ * Outside of a batch, standalone is filled and must be released with
+ * release_apply_table() once the change is applied.
+ */
+static BATCH_APPLY_TABLE *
+get_apply_table(Oid tableoid, BATCH_APPLY_TABLE * standalone)
+{
+	BATCH_APPLY_TABLE * applytable = standalone;
+	MemoryContext oldContext;
+	bool found = false;
+
+	if (!batchApplyHash)
+		open_apply_table(standalone, tableoid);
+	else
+	{
+		applytable = (BATCH_APPLY_TABLE *) hash_search(batchApplyHash, &tableoid, HASH_ENTER, &found);
+		if (!found)
+		{
+			oldContext = MemoryContextSwitchTo(batchApplyContext);
+			open_apply_table(applytable, tableoid);
+			MemoryContextSwitchTo(oldContext);
+		}
+	}
+
+	/* every change is applied as a command of its own */
+	applytable->estate->es_output_cid = GetCurrentCommandId(true);
+	return applytable;
+}
+
+/*
+ * release_apply_table
+ *
+ * This function is called after a change is applied with the state returned by
+ * get_apply_table(). The state is closed unless it belongs to the current batch.
+ */
+static void
+release_apply_table(BATCH_APPLY_TABLE * applytable, BATCH_APPLY_TABLE * standalone)
+{
+	if (applytable == standalone)
+		close_apply_table(applytable);
+	else
+		ResetPerTupleExprContext(applytable->estate);
+}
+
+/*
+ * find_local_tuple
+ *
+ * This function locates the tuple in table that matches the one in remoteslot
+ * and stores it in localslot. Returns true if found.
+ */
+static bool
+find_local_tuple(BATCH_APPLY_TABLE * applytable)
+{
+	bool found;
+
+	if (OidIsValid(applytable->lookupidxoid))
+	{
+		elog(DEBUG1, "attempt to find old tuple by index");
+		found = RelationFindReplTupleByIndex(applytable->rel, applytable->lookupidxoid,
+											 LockTupleExclusive,
+											 applytable->remoteslot,
+											 applytable->localslot);
+	}
+	else
+	{
+		/* report each table once, this is slow on large tables */
+		if (!list_member_oid(seqScanLookupTables, applytable->tableoid))
+		{
+			MemoryContext oldContext = MemoryContextSwitchTo(TopMemoryContext);
+
+			seqScanLookupTables = lappend_oid(seqScanLookupTables, applytable->tableoid);
+			MemoryContextSwitchTo(oldContext);
+
+			elog(WARNING, "table %s has no primary key, replica identity or usable index; "
+				 "updates and deletes locate rows by sequential scan",
+				 RelationGetRelationName(applytable->rel));
+		}
+		elog(DEBUG1, "attempt to find old tuple by seq scan");
+		found = RelationFindReplTupleSeq(applytable->rel, LockTupleExclusive,
+										 applytable->remoteslot,
+										 applytable->localslot);
+	}
+	return found;
+}
+
+/*
+ * upsert_apply_table_row
+ *
+ * This function inserts the tuple in remoteslot or, if a row with the same PK
+ * or replica identity exists, updates that row instead. The insertion is done
+ * speculatively like INSERT ... ON CONFLICT DO UPDATE, so a conflicting row
+ * inserted at the same time is detected and the whole operation is retried.
+ */
+static void
+upsert_apply_table_row(BATCH_APPLY_TABLE * applytable)
+{
+	ResultRelInfo * resultRelInfo = applytable->resultRelInfo;
+	EState * estate = applytable->estate;
+	TupleTableSlot * slot = applytable->remoteslot;
+	List * arbiterIndexes = list_make1_oid(applytable->idxoid);
+	ItemPointerData conflictTid;
+	uint32 specToken;
+	bool specConflict;
+	List * recheckIndexes;
+
+	if (applytable->rel->rd_att->constr)
+		ExecConstraints(resultRelInfo, slot, estate);
+
+	for (;;)
+	{
+		if (!ExecCheckIndexConstraints(resultRelInfo, slot, estate, &conflictTid,
+									   arbiterIndexes))
+		{
+			/* the row exists already, replace it with the new values */
+			if (find_local_tuple(applytable))
+			{
+				elog(DEBUG1, "row to insert exists, updating it instead");
+				EvalPlanQualSetSlot(&applytable->epqstate, slot);
+				ExecSimpleRelationUpdate(resultRelInfo, estate, &applytable->epqstate,
+										 applytable->localslot, slot);
+				break;
+			}
+
+			/* it was deleted in the meantime, try inserting again */
+			continue;
+		}
+
+		specToken = SpeculativeInsertionLockAcquire(GetCurrentTransactionId());
+		table_tuple_insert_speculative(applytable->rel, slot, estate->es_output_cid,
+									   0, NULL, specToken);
+		recheckIndexes = ExecInsertIndexTuples(resultRelInfo, slot, estate, false, true,
+											   &specConflict, arbiterIndexes, false);
+		table_tuple_complete_speculative(applytable->rel, slot, specToken, !specConflict);
+		SpeculativeInsertionLockRelease(GetCurrentTransactionId());
+		list_free(recheckIndexes);
+
+		if (!specConflict)
+			break;
+	}
+	list_free(arbiterIndexes);
+}
+
+/*
+ * compact_key_hash
+ *
+ * hash function of BATCH_COMPACT_KEY
+ */
+static uint32
+compact_key_hash(const void * key, Size keysize)
+{
+	const BATCH_COMPACT_KEY * k = (const BATCH_COMPACT_KEY *) key;
+
+	return hash_combine(murmurhash32((uint32) k->tableoid),
+						hash_bytes((const unsigned char *) k->keyvalues, strlen(k->keyvalues)));
+}
+
+/*
+ * compact_key_match
+ *
+ * match function of BATCH_COMPACT_KEY, returns 0 if the keys are equal
+ */
+static int
+compact_key_match(const void * key1, const void * key2, Size keysize)
+{
+	const BATCH_COMPACT_KEY * k1 = (const BATCH_COMPACT_KEY *) key1;
+	const BATCH_COMPACT_KEY * k2 = (const BATCH_COMPACT_KEY *) key2;
+
+	if (k1->tableoid != k2->tableoid)
+		return 1;
+
+	return strcmp(k1->keyvalues, k2->keyvalues);
+}
+
+/*
+ * build_compact_key
+ *
+ * This function builds the key values of a row from its column values. NULL
+ * is returned if not all key columns have a value.
+ */
+static char *
+build_compact_key(Bitmapset * keyattrs, List * colvals)
+{
+	StringInfoData strinfo;
+	ListCell * cell;
+	int nkeys = 0;
+
+	initStringInfo(&strinfo);
+	foreach(cell, colvals)
+	{
+		PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
+
+		if (!bms_is_member(colval->position - FirstLowInvalidHeapAttributeNumber, keyattrs))
+			continue;
+
+		if (!strcasecmp(colval->value, "NULL"))
+			break;
+
+		/* length prefixed so values cannot run into each other */
+		appendStringInfo(&strinfo, "%d:%zu:%s", colval->position, strlen(colval->value),
+						 colval->value);
+		nkeys++;
+	}
+
+	if (nkeys != bms_num_members(keyattrs))
+	{
+		pfree(strinfo.data);
+		return NULL;
+	}
+	return strinfo.data;
+}
+
+/*
+ * copy_colvals
+ *
+ * This function copies a list of PG_DML_COLUMN_VALUE into the current memory
+ * context.
+ */
+static List *
+copy_colvals(List * colvals)
+{
+	List * copy = NIL;
+	ListCell * cell;
+
+	foreach(cell, colvals)
+	{
+		PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
+		PG_DML_COLUMN_VALUE * newval = (PG_DML_COLUMN_VALUE *) palloc(sizeof(PG_DML_COLUMN_VALUE));
+
+		newval->value = pstrdup(colval->value);
+		newval->datatype = colval->datatype;
+		newval->position = colval->position;
+		newval->transformExpression = colval->transformExpression;
+		newval->wkb = colval->wkb ? pstrdup(colval->wkb) : NULL;
+		newval->srid = colval->srid ? pstrdup(colval->srid) : NULL;
+		newval->hasInternalValue = colval->hasInternalValue;
+		newval->internalValue = colval->internalValue;
+		newval->numericValue = colval->hasInternalValue && colval->datatype == NUMERICOID ?
+			datumCopy(colval->numericValue, false, -1) : (Datum) 0;
+		copy = lappend(copy, newval);
+	}
+	return copy;
+}
+
+/*
+ * compact_row_change
+ *
+ * This function folds a new change into the net change of a row: an insert
+ * followed by updates stays an insert, updates stay one update, an insert
+ * followed by a delete cancels out and updates followed by a delete become
+ * a delete of the row as it was before the batch. Returns false for changes
+ * that do not fold, such as a delete followed by an insert.
+ *
+ * In upsert mode an insert does not mean the row was missing before the batch,
+ * a replayed batch inserts rows that are already there. An insert followed by
+ * a delete then becomes a delete so the row does not stay behind.
+ */
+static bool
+compact_row_change(BATCH_COMPACT_ROW * row, PG_DML * pgdml, bool upsert)
+{
+	switch (row->op)
+	{
+		case 0:
+		{
+			/* the row does not exist as far as the batch is concerned */
+			if (pgdml->op == 'c')
+			{
+				row->op = 'c';
+				row->columnValuesAfter = copy_colvals(pgdml->columnValuesAfter);
+				return true;
+			}
+			if (pgdml->op == 'd' && upsert)
+			{
+				row->op = 'd';
+				row->columnValuesBefore = copy_colvals(pgdml->columnValuesBefore);
+				return true;
+			}
+			return pgdml->op == 'd';
+		}
+		case 'c':
+		case 'u':
+		{
+			if (pgdml->op == 'u')
+			{
+				row->columnValuesAfter = copy_colvals(pgdml->columnValuesAfter);
+				return true;
+			}
+			if (pgdml->op == 'd')
+			{
+				if (row->op == 'c' && upsert)
+					row->columnValuesBefore = copy_colvals(pgdml->columnValuesBefore);
+				row->op = (row->op == 'c' && !upsert) ? 0 : 'd';
+				row->columnValuesAfter = NIL;
+				return true;
+			}
+			return false;
+		}
+		default:
+			return false;
+	}
+}
+
+/*
+ * own_column_inputs
+ *
+ * This function returns a copy of the column inputs of a change to applytable
+ * that lasts until the end of the batch. Changes applied later in the batch
+ * refer to it instead of the data cache entry, which can be rebuilt or removed
+ * in the meantime. The copy is made once per table and batch
+ */
+static PG_DML_COLUMN_INPUT *
+own_column_inputs(BATCH_APPLY_TABLE * applytable, PG_DML_COLUMN_INPUT * colinputs,
+		int ncolinputs)
+{
+	int i;
+
+	if (!colinputs || ncolinputs <= 0)
+		return NULL;
+
+	if (applytable->ownedInputsSource != colinputs)
+	{
+		applytable->ownedInputs = (PG_DML_COLUMN_INPUT *)
+			MemoryContextAlloc(batchApplyContext, sizeof(PG_DML_COLUMN_INPUT) * ncolinputs);
+		for (i = 0; i < ncolinputs; i++)
+		{
+			fmgr_info_copy(&applytable->ownedInputs[i].finfo, &colinputs[i].finfo,
+						   batchApplyContext);
+			applytable->ownedInputs[i].typioparam = colinputs[i].typioparam;
+			applytable->ownedInputs[i].typmod = colinputs[i].typmod;
+		}
+		applytable->ownedInputsSource = colinputs;
+	}
+	return applytable->ownedInputs;
+}
+
+/*
+ * defer_row_change
+ *
+ * This function defers an insert, update or delete to the end of the batch,
+ * folding it into the changes already deferred for the same row. Returns
+ * false if the change cannot be deferred and has to be applied right away,
+ * which is the case for tables without a primary key or replica identity, for
+ * tables with constraints across rows (see open_apply_table) and for updates
+ * that change the key.
+ */
+static bool
+defer_row_change(PG_DML * pgdml, ConnectorType type)
+{
+	BATCH_APPLY_TABLE standalone;
+	BATCH_APPLY_TABLE * applytable;
+	BATCH_COMPACT_KEY key;
+	BATCH_COMPACT_ROW * row = NULL;
+	MemoryContext oldContext;
+	char * keyvalues;
+
+	applytable = get_apply_table(pgdml->tableoid, &standalone);
+	if (!applytable->compact)
+		return false;
+
+	keyvalues = build_compact_key(applytable->keyattrs,
+			pgdml->op == 'c' ? pgdml->columnValuesAfter : pgdml->columnValuesBefore);
+	if (!keyvalues)
+		return false;
+
+	if (pgdml->op == 'u')
+	{
+		char * afterkey = build_compact_key(applytable->keyattrs, pgdml->columnValuesAfter);
+
+		if (!afterkey || strcmp(keyvalues, afterkey))
+			return false;
+		pfree(afterkey);
+	}
+
+	key.tableoid = pgdml->tableoid;
+	key.keyvalues = keyvalues;
+
+	if (batchCompactHash)
+	{
+		row = (BATCH_COMPACT_ROW *) hash_search(batchCompactHash, &key, HASH_FIND, NULL);
+		if (row)
+		{
+			bool folded;
+
+			oldContext = MemoryContextSwitchTo(batchCompactContext);
+			folded = compact_row_change(row, pgdml, applytable->upsert);
+			MemoryContextSwitchTo(oldContext);
+			if (folded)
+				return true;
+
+			/* what is deferred goes in first, then this change starts over */
+			flush_deferred_changes();
+		}
+	}
+
+	if (!batchCompactContext)
+		batchCompactContext = AllocSetContextCreate(batchApplyContext,
+													"synchdb batch compaction context",
+													ALLOCSET_DEFAULT_SIZES);
+
+	oldContext = MemoryContextSwitchTo(batchCompactContext);
+	if (!batchCompactHash)
+	{
+		HASHCTL hash_ctl;
+
+		memset(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(BATCH_COMPACT_KEY);
+		hash_ctl.entrysize = sizeof(BATCH_COMPACT_ROW);
+		hash_ctl.hash = compact_key_hash;
+		hash_ctl.match = compact_key_match;
+		hash_ctl.hcxt = batchCompactContext;
+
+		batchCompactHash = hash_create("batch compaction row hash",
+									   256,
+									   &hash_ctl,
+									   HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+	}
+
+	key.keyvalues = pstrdup(keyvalues);
+	row = (BATCH_COMPACT_ROW *) hash_search(batchCompactHash, &key, HASH_ENTER, NULL);
+	row->op = pgdml->op;
+	row->type = type;
+	row->columnValuesBefore = pgdml->op == 'c' ? NIL : copy_colvals(pgdml->columnValuesBefore);
+	row->columnValuesAfter = pgdml->op == 'd' ? NIL : copy_colvals(pgdml->columnValuesAfter);
+	row->columnInputs = own_column_inputs(applytable, pgdml->columnInputs,
+										  pgdml->ncolumnInputs);
+	row->ncolumnInputs = row->columnInputs ? pgdml->ncolumnInputs : 0;
+	batchCompactList = lappend(batchCompactList, row);
+	MemoryContextSwitchTo(oldContext);
+
+	pfree(keyvalues);
+	return true;
+}
+
+/*
+ * synchdb_handle_insert - Custom handler for INSERT operations
+ *
+ * This function performs an INSERT operation without using SPI.
+ * It creates a tuple from the provided column values and inserts it into the table.
+ * With bulk set, the tuple may be buffered within a batch and inserted together
+ * with the following ones into the same table.
+ */
+static int
+synchdb_handle_insert(List * colval, Oid tableoid, ConnectorType type,
+		PG_DML_COLUMN_INPUT * colinputs, int ncolinputs, bool bulk)
+{
+	BATCH_APPLY_TABLE standalone;
+	BATCH_APPLY_TABLE * applytable;
+
+	/*
+	 * we put in TRY and CATCH block to capture potential exceptions raised
+	 * from PostgreSQL, which would cause this worker to exit. The last error
+	 * messages related with the exception will be stored in synchdb's shared
+	 * memory state so user will have an idea what is wrong.
+	 */
+	PG_TRY();
+	{
+		applytable = get_apply_table(tableoid, &standalone);
+
+		/* turn colval into TupleTableSlot */
+		fill_slot_from_colvals(applytable->remoteslot, colval, colinputs, ncolinputs);
+
+		if (bulk && applytable != &standalone && applytable->multiinsert &&
+			!applytable->upsert)
+		{
+			ListCell * cell;
+			Size rowbytes = 0;
+
+			foreach(cell, colval)
+				rowbytes += strlen(((PG_DML_COLUMN_VALUE *) lfirst(cell))->value);
+
+			buffer_apply_table_row(applytable, rowbytes);
+		}
+		else
+		{
+			/* rows buffered earlier go in first */
+			flush_apply_table(applytable);
+
+			/* Do the insert. */
+			if (applytable->upsert)
+				upsert_apply_table_row(applytable);
+			else
+				ExecSimpleRelationInsert(applytable->resultRelInfo, applytable->estate,
+										 applytable->remoteslot);
+
+			/* increment command ID */
+			CommandCounterIncrement();
+		}
+
+		/* Cleanup. */
+		release_apply_table(applytable, &standalone);
+	}
+	PG_CATCH();
+	{
+		ErrorData  *errdata = CopyErrorData();
+		if (errdata)
+		{
+			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
+			snprintf(msg, SYNCHDB_ERRMSG_SIZE, "table %d: %s",
+					tableoid, errdata->message);
+			set_shm_connector_errmsg(myConnectorId, msg);
+			pfree(msg);
+		}
+
+		FreeErrorData(errdata);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	return 0;
+}
+
+/*
+ * synchdb_handle_update - Custom handler for UPDATE operations
+ *
+ * This function performs an UPDATE operation without using SPI.
+ * It locates the existing tuple, creates a new tuple with updated values,
+ * and replaces the old tuple with the new one.
+ */
+static int
+synchdb_handle_update(List * colvalbefore, List * colvalafter, Oid tableoid, ConnectorType type,
+		PG_DML_COLUMN_INPUT * colinputs, int ncolinputs)
+{
+	BATCH_APPLY_TABLE standalone;
+	BATCH_APPLY_TABLE * applytable;
+	List * changed;
+	int ret = 0;
+
+	/*
+	 * we put in TRY and CATCH block to capture potential exceptions raised
+	 * from PostgreSQL, which would cause this worker to exit. The last error
+	 * messages related with the exception will be stored in synchdb's shared
+	 * memory state so user will have an idea what is wrong.
+	 */
+	PG_TRY();
+	{
+		applytable = get_apply_table(tableoid, &standalone);
+
+		/* only the columns that changed go into the new tuple */
+		changed = changed_colvals(colvalbefore, colvalafter,
+				RelationGetDescr(applytable->rel)->natts);
+		if (changed == NIL)
+			elog(DEBUG1, "update does not change any column, skipped");
+		else
+		{
+			/* turn colvalbefore into TupleTableSlot */
+			fill_slot_from_colvals(applytable->remoteslot, colvalbefore, colinputs, ncolinputs);
+
+			/*
+			 * localslot should now contain the reference to the old tuple that is yet
+			 * to be updated
+			 */
+			if (find_local_tuple(applytable))
+			{
+				/* apply the changed columns on top of the old tuple */
+				modify_slot_from_colvals(applytable->remoteslot, applytable->localslot,
+										 changed, colinputs, ncolinputs);
+
+				EvalPlanQualSetSlot(&applytable->epqstate, applytable->remoteslot);
+
+				ExecSimpleRelationUpdate(applytable->resultRelInfo, applytable->estate,
+										 &applytable->epqstate, applytable->localslot,
+										 applytable->remoteslot);
+			}
+			else
+			{
+				elog(DEBUG1, "tuple to update not found");
+				ret = -1;
+			}
+
+			/* increment command ID */
+			CommandCounterIncrement();
+		}
+
+		/* Cleanup. */
+		release_apply_table(applytable, &standalone);
+	}
+	PG_CATCH();
+	{
+		ErrorData  *errdata = CopyErrorData();
+		if (errdata)
+		{
+			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
+			snprintf(msg, SYNCHDB_ERRMSG_SIZE, "table %d: %s",
+					tableoid, errdata->message);
+			set_shm_connector_errmsg(myConnectorId, msg);
+			pfree(msg);
+		}
+
+		FreeErrorData(errdata);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	return ret;
+}
+
+/*
+ * synchdb_handle_delete - Custom handler for DELETE operations
  *
- * This function is the entry point for executing DML operations.
- * Depending on the operation type and configuration, it either uses SPI
- * or calls a custom handler function.
+ * This function performs a DELETE operation without using SPI.
+ * It locates the existing tuple based on the provided column values and deletes it.
+ */
+static int
+synchdb_handle_delete(List * colvalbefore, Oid tableoid, ConnectorType type,
+		PG_DML_COLUMN_INPUT * colinputs, int ncolinputs)
+{
+	BATCH_APPLY_TABLE standalone;
+	BATCH_APPLY_TABLE * applytable;
+	int ret = 0;
+
+	/*
+	 * we put in TRY and CATCH block to capture potential exceptions raised
+	 * from PostgreSQL, which would cause this worker to exit. The last error
+	 * messages related with the exception will be stored in synchdb's shared
+	 * memory state so user will have an idea what is wrong.
+	 */
+	PG_TRY();
+	{
+		applytable = get_apply_table(tableoid, &standalone);
+
+		/* turn colvalbefore into TupleTableSlot */
+		fill_slot_from_colvals(applytable->remoteslot, colvalbefore, colinputs, ncolinputs);
+
+		/*
+		 * localslot should now contain the reference to the old tuple that is yet
+		 * to be deleted
+		 */
+		if (find_local_tuple(applytable))
+		{
+			EvalPlanQualSetSlot(&applytable->epqstate, applytable->localslot);
+
+			ExecSimpleRelationDelete(applytable->resultRelInfo, applytable->estate,
+									 &applytable->epqstate, applytable->localslot);
+		}
+		else
+		{
+			elog(DEBUG1, "tuple to delete not found");
+			ret = -1;
+		}
+
+		/* increment command ID */
+		CommandCounterIncrement();
+
+		/* Cleanup. */
+		release_apply_table(applytable, &standalone);
+	}
+	PG_CATCH();
+	{
+		ErrorData  *errdata = CopyErrorData();
+		if (errdata)
+		{
+			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
+			snprintf(msg, SYNCHDB_ERRMSG_SIZE, "table %d: %s",
+					tableoid, errdata->message);
+			set_shm_connector_errmsg(myConnectorId, msg);
+			pfree(msg);
+		}
+
+		FreeErrorData(errdata);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	return ret;
+}
+
+/*
+ * synchdb_handle_delete_batch - Custom handler for a batch of DELETE operations
+ *
+ * This function deletes the rows of a table given by a list of BATCH_COMPACT_ROW
+ * with a single index scan, using a "key = ANY(array)" scan key over the key
+ * values of all rows instead of one index descent per row. It only handles
+ * tables whose primary key or replica identity has a single column. Every
+ * tuple found is locked before it is deleted and the scan starts over if one
+ * was changed concurrently, as for a single row.
+ *
+ * @return: true if the rows were deleted, false if the table does not qualify
+ */
+static bool
+synchdb_handle_delete_batch(Oid tableoid, List * rows)
+{
+	BATCH_APPLY_TABLE standalone;
+	BATCH_APPLY_TABLE * applytable;
+	Relation idxrel = NULL;
+	IndexScanDesc scan;
+	ScanKeyData skey;
+	Snapshot snapshot;
+	Datum * keyvalues;
+	ArrayType * keyarray;
+	ListCell * cell;
+	AttrNumber keyattno;
+	Form_pg_attribute attr;
+	Oid eqop;
+	int nkeys = 0;
+	int ndeleted = 0;
+	bool ret = false;
+
+	PG_TRY();
+	{
+		applytable = get_apply_table(tableoid, &standalone);
+
+		if (OidIsValid(applytable->idxoid) &&
+			applytable->lookupidxoid == applytable->idxoid)
+			idxrel = index_open(applytable->idxoid, RowExclusiveLock);
+
+		if (idxrel && idxrel->rd_rel->relam == BTREE_AM_OID &&
+			idxrel->rd_index->indnkeyatts == 1 &&
+			idxrel->rd_index->indkey.values[0] > 0)
+		{
+			keyattno = idxrel->rd_index->indkey.values[0];
+			attr = TupleDescAttr(RelationGetDescr(applytable->rel), keyattno - 1);
+
+			/* collect the key value of every row */
+			keyvalues = palloc(sizeof(Datum) * list_length(rows));
+			foreach(cell, rows)
+			{
+				BATCH_COMPACT_ROW * row = (BATCH_COMPACT_ROW *) lfirst(cell);
+				ListCell * vcell;
+
+				foreach(vcell, row->columnValuesBefore)
+				{
+					PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(vcell);
+
+					if (colval->position == keyattno)
+					{
+						keyvalues[nkeys++] = colval_to_datum(RelationGetDescr(applytable->rel),
+								colval, keyattno - 1,
+								row->ncolumnInputs == RelationGetDescr(applytable->rel)->natts ?
+								row->columnInputs : NULL);
+						break;
+					}
+				}
+			}
+			keyarray = construct_array(keyvalues, nkeys, attr->atttypid, attr->attlen,
+									   attr->attbyval, attr->attalign);
+
+			eqop = get_opfamily_member(idxrel->rd_opfamily[0], idxrel->rd_opcintype[0],
+									   idxrel->rd_opcintype[0], BTEqualStrategyNumber);
+			if (!OidIsValid(eqop))
+				elog(ERROR, "missing equality operator for index %u", applytable->idxoid);
+
+			ScanKeyEntryInitialize(&skey, SK_SEARCHARRAY, 1, BTEqualStrategyNumber,
+								   InvalidOid, idxrel->rd_indcollation[0],
+								   get_opcode(eqop), PointerGetDatum(keyarray));
+
+retry:
+			/* the latest snapshot sees the changes made earlier in this batch */
+			snapshot = RegisterSnapshot(GetLatestSnapshot());
+			scan = index_beginscan(applytable->rel, idxrel, snapshot, 1, 0);
+			index_rescan(scan, &skey, 1, NULL, 0);
+			while (index_getnext_slot(scan, ForwardScanDirection, applytable->localslot))
+			{
+				TM_FailureData tmfd;
+				TM_Result	res;
+
+				/*
+				 * lock the tuple like RelationFindReplTupleByIndex() does for a
+				 * single row, so one changed concurrently is not deleted on the
+				 * strength of a stale version
+				 */
+				PushActiveSnapshot(GetLatestSnapshot());
+				res = table_tuple_lock(applytable->rel, &(applytable->localslot->tts_tid),
+									   GetLatestSnapshot(), applytable->localslot,
+									   GetCurrentCommandId(false), LockTupleExclusive,
+									   LockWaitBlock, 0, &tmfd);
+				PopActiveSnapshot();
+
+				switch (res)
+				{
+					case TM_Ok:
+						break;
+					case TM_Updated:
+					case TM_Deleted:
+						/*
+						 * rescan with a new snapshot, the rows deleted so far
+						 * are no longer seen once the command ID is advanced
+						 */
+						elog(LOG, "concurrent %s, retrying",
+							 res == TM_Updated ? "update" : "delete");
+						index_endscan(scan);
+						UnregisterSnapshot(snapshot);
+						CommandCounterIncrement();
+						goto retry;
+					case TM_Invisible:
+						elog(ERROR, "attempted to lock invisible tuple");
+						break;
+					default:
+						elog(ERROR, "unexpected table_tuple_lock status: %u", res);
+						break;
+				}
+
+				EvalPlanQualSetSlot(&applytable->epqstate, applytable->localslot);
+				ExecSimpleRelationDelete(applytable->resultRelInfo, applytable->estate,
+										 &applytable->epqstate, applytable->localslot);
+				ndeleted++;
+			}
+			index_endscan(scan);
+			UnregisterSnapshot(snapshot);
+
+			if (ndeleted < list_length(rows))
+				elog(DEBUG1, "%d of %d tuples to delete not found",
+					 list_length(rows) - ndeleted, list_length(rows));
+
+			/* increment command ID */
+			CommandCounterIncrement();
+			ret = true;
+		}
+
+		if (idxrel)
+			index_close(idxrel, NoLock);
+
+		/* Cleanup. */
+		release_apply_table(applytable, &standalone);
+	}
+	PG_CATCH();
+	{
+		ErrorData  *errdata = CopyErrorData();
+		if (errdata)
+		{
+			char * msg = palloc0(SYNCHDB_ERRMSG_SIZE);
+			snprintf(msg, SYNCHDB_ERRMSG_SIZE, "table %d: %s",
+					tableoid, errdata->message);
+			set_shm_connector_errmsg(myConnectorId, msg);
+			pfree(msg);
+		}
+
+		FreeErrorData(errdata);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	return ret;
+}
+
+/*
+ * ra_beginBatchApply - Start applying a batch of change events
+ *
+ * This function is called within the transaction of a batch before its change
+ * events are applied. From here on, the executor state of every target table is
+ * opened once and reused by all changes in the batch until ra_endBatchApply().
+ */
+void
+ra_beginBatchApply(void)
+{
+	HASHCTL hash_ctl;
+
+	/*
+	 * anything left by a batch that did not end properly went away with its
+	 * transaction
+	 */
+	batchApplyContext = AllocSetContextCreate(TopTransactionContext,
+											  "synchdb batch apply context",
+											  ALLOCSET_DEFAULT_SIZES);
+	batchCompactHash = NULL;
+	batchCompactList = NIL;
+	batchCompactContext = NULL;
+	batchApplyStats = NULL;
+	transformQueue = NIL;
+	transformQueueContext = NULL;
+
+	memset(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(Oid);
+	hash_ctl.entrysize = sizeof(BATCH_APPLY_TABLE);
+	hash_ctl.hcxt = batchApplyContext;
+
+	batchApplyHash = hash_create("batch apply table hash",
+								 32,
+								 &hash_ctl,
+								 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+}
+
+/*
+ * ra_endBatchApply - Finish applying a batch of change events
+ *
+ * This function closes all the tables opened by the current batch. It must be
+ * called before the transaction of the batch commits.
+ */
+void
+ra_endBatchApply(void)
+{
+	if (!batchApplyHash)
+		return;
+
+	close_batch_tables();
+
+	MemoryContextDelete(batchApplyContext);
+	batchApplyContext = NULL;
+	batchApplyHash = NULL;
+	batchApplyStats = NULL;
+}
+
+/*
+ * flush_deferred_changes
+ *
+ * This function applies the net change of every row changed by the current
+ * batch so far. It must be called before the tables of the deferred changes
+ * are closed or altered.
+ */
+static void
+flush_deferred_changes(void)
+{
+	ListCell * cell;
+	List * deletes = NIL;
+	MemoryContext oldContext;
+	int ret = 0;
+
+	/* changes waiting for transforms may still fold into the ones below */
+	flush_transform_queue();
+
+	if (batchCompactList == NIL)
+		return;
+
+	/*
+	 * deletes of different rows do not depend on each other, so the ones of
+	 * each table go in first with one index scan per table
+	 */
+	oldContext = MemoryContextSwitchTo(batchCompactContext);
+	foreach(cell, batchCompactList)
+	{
+		BATCH_COMPACT_ROW * row = (BATCH_COMPACT_ROW *) lfirst(cell);
+		ListCell * dcell;
+		bool found = false;
+
+		if (row->op != 'd')
+			continue;
+
+		foreach(dcell, deletes)
+		{
+			List ** tabledeletes = (List **) &lfirst(dcell);
+
+			if (((BATCH_COMPACT_ROW *) linitial(*tabledeletes))->key.tableoid == row->key.tableoid)
+			{
+				*tabledeletes = lappend(*tabledeletes, row);
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			deletes = lappend(deletes, list_make1(row));
+	}
+
+	foreach(cell, deletes)
+	{
+		List * tabledeletes = (List *) lfirst(cell);
+		ListCell * dcell;
+
+		if (list_length(tabledeletes) < 2 ||
+			!synchdb_handle_delete_batch(((BATCH_COMPACT_ROW *) linitial(tabledeletes))->key.tableoid,
+										 tabledeletes))
+			continue;
+
+		foreach(dcell, tabledeletes)
+			((BATCH_COMPACT_ROW *) lfirst(dcell))->op = 0;
+	}
+	MemoryContextSwitchTo(oldContext);
+
+	elog(DEBUG1, "applying %d compacted row changes", list_length(batchCompactList));
+	foreach(cell, batchCompactList)
+	{
+		BATCH_COMPACT_ROW * row = (BATCH_COMPACT_ROW *) lfirst(cell);
+
+		switch (row->op)
+		{
+			case 'c':
+				ret = synchdb_handle_insert(row->columnValuesAfter, row->key.tableoid, row->type,
+											row->columnInputs, row->ncolumnInputs, false);
+				break;
+			case 'u':
+				ret = synchdb_handle_update(row->columnValuesBefore, row->columnValuesAfter,
+											row->key.tableoid, row->type,
+											row->columnInputs, row->ncolumnInputs);
+				break;
+			case 'd':
+				ret = synchdb_handle_delete(row->columnValuesBefore, row->key.tableoid, row->type,
+											row->columnInputs, row->ncolumnInputs);
+				break;
+			default:
+				/* changes that cancel out */
+				ret = 0;
+				break;
+		}
+
+		/* same as a change that fails when applied right away */
+		if (ret)
+		{
+			elog(WARNING, "failed to apply compacted %c change to table %d",
+				 row->op, row->key.tableoid);
+			if (batchApplyStats)
+				increment_connector_statistics(batchApplyStats, STATS_BAD_CHANGE_EVENT, 1);
+		}
+	}
+
+	batchCompactList = NIL;
+	batchCompactHash = NULL;
+	MemoryContextDelete(batchCompactContext);
+	batchCompactContext = NULL;
+}
+
+/*
+ * ra_executePGDDL - Execute a PostgreSQL DDL operation
+ *
+ * This function is the entry point for executing DDL operations.
+ * It uses SPI to execute the DDL query.
  */
 int
-ra_executePGDML(PG_DML * pgdml, ConnectorType type, SynchdbStatistics * myBatchStats)
+ra_executePGDDL(PG_DDL * pgddl, ConnectorType type)
 {
-	int ret = -1;
-	if (!pgdml)
+	if (!pgddl || !pgddl->ddlquery)
     {
-        elog(WARNING, "Invalid DML operation");
+        elog(WARNING, "Invalid DDL query");
         return -1;
     }
 
+	/* tables cannot be altered while the current batch holds them open */
+	if (batchApplyHash)
+		close_batch_tables();
+
+	return spi_execute(pgddl->ddlquery, type);
+}
+
+/*
+ * apply_pgdml
+ *
+ * This function applies a DML change that is ready to be applied, either with
+ * SPI or with the heap handlers. Changes may be collapsed and deferred to the
+ * end of the batch when batch compaction is on.
+ */
+static int
+apply_pgdml(PG_DML * pgdml, ConnectorType type)
+{
+	int ret = -1;
+
+	/* snapshot rows buffered in current batch must be in place for other changes */
+	if (batchApplyHash && (pgdml->op != 'r' || synchdb_dml_use_spi))
+		flush_batch_tables();
+
+	/* changes to the same row within a batch are collapsed into their net change */
+	if (batchApplyHash && synchdb_dml_batch_compaction && !synchdb_dml_use_spi &&
+		(pgdml->op == 'c' || pgdml->op == 'u' || pgdml->op == 'd'))
+	{
+		if (defer_row_change(pgdml, type))
+			return 0;
+	}
+
+	/* and anything deferred must be in place for other changes too */
+	flush_deferred_changes();
+
 	switch (pgdml->op)
 	{
 		case 'r':  // Read operation
@@ -790,9 +1932,8 @@ ra_executePGDML(PG_DML * pgdml, ConnectorType type, SynchdbStatistics * myBatchS
 			if (synchdb_dml_use_spi)
 				ret = spi_execute(pgdml->dmlquery, type);
 			else
-				ret = synchdb_handle_insert(pgdml->columnValuesAfter, pgdml->tableoid, type);
-
-			increment_connector_statistics(myBatchStats, STATS_READ, 1);
+				ret = synchdb_handle_insert(pgdml->columnValuesAfter, pgdml->tableoid, type,
+											pgdml->columnInputs, pgdml->ncolumnInputs, true);
 			break;
 		}
 		case 'c':  // Create operation
@@ -800,9 +1941,8 @@ ra_executePGDML(PG_DML * pgdml, ConnectorType type, SynchdbStatistics * myBatchS
 			if (synchdb_dml_use_spi)
 				ret = spi_execute(pgdml->dmlquery, type);
 			else
-				ret = synchdb_handle_insert(pgdml->columnValuesAfter, pgdml->tableoid, type);
-
-			increment_connector_statistics(myBatchStats, STATS_CREATE, 1);
+				ret = synchdb_handle_insert(pgdml->columnValuesAfter, pgdml->tableoid, type,
+											pgdml->columnInputs, pgdml->ncolumnInputs, false);
 			break;
 		}
 		case 'u':  // Update operation
@@ -813,27 +1953,74 @@ ra_executePGDML(PG_DML * pgdml, ConnectorType type, SynchdbStatistics * myBatchS
 				ret = synchdb_handle_update(pgdml->columnValuesBefore,
 											 pgdml->columnValuesAfter,
 											 pgdml->tableoid,
-											 type);
+											 type,
+											 pgdml->columnInputs,
+											 pgdml->ncolumnInputs);
+			break;
+		}
+		case 'd':  // Delete operation
+		{
+			if (synchdb_dml_use_spi)
+				ret = spi_execute(pgdml->dmlquery, type);
+			else
+				ret = synchdb_handle_delete(pgdml->columnValuesBefore, pgdml->tableoid, type,
+											pgdml->columnInputs, pgdml->ncolumnInputs);
+			break;
+		}
+		default:
+		{
+			/* all others, use SPI to execute regardless what synchdb_dml_use_spi is */
+			ret = spi_execute(pgdml->dmlquery, type);
+			break;
+		}
+	}
+	return ret;
+}
+
+/*
+ * ra_executePGDML - Execute a PostgreSQL DML operation
+ *
+ * This function is the entry point for executing DML operations.
+ * Depending on the operation type and configuration, it either uses SPI
+ * or calls a custom handler function. Within a batch, changes whose values
+ * still need their transform expressions are queued with the ones after
+ * them and applied in order once the transforms are evaluated together.
+ */
+int
+ra_executePGDML(PG_DML * pgdml, ConnectorType type, SynchdbStatistics * myBatchStats)
+{
+	if (!pgdml)
+    {
+        elog(WARNING, "Invalid DML operation");
+        return -1;
+    }
+
+	switch (pgdml->op)
+	{
+		case 'r':
+			increment_connector_statistics(myBatchStats, STATS_READ, 1);
+			break;
+		case 'c':
+			increment_connector_statistics(myBatchStats, STATS_CREATE, 1);
+			break;
+		case 'u':
 			increment_connector_statistics(myBatchStats, STATS_UPDATE, 1);
 			break;
-		}
-		case 'd':  // Delete operation
-		{
-			if (synchdb_dml_use_spi)
-				ret = spi_execute(pgdml->dmlquery, type);
-			else
-				ret = synchdb_handle_delete(pgdml->columnValuesBefore, pgdml->tableoid, type);
-
+		case 'd':
 			increment_connector_statistics(myBatchStats, STATS_DELETE, 1);
 			break;
-		}
 		default:
-		{
-			/* all others, use SPI to execute regardless what synchdb_dml_use_spi is */
-			return spi_execute(pgdml->dmlquery, type);
-		}
+			break;
 	}
-	return ret;
+
+	/* changes deferred to later in the batch are reported to the same statistics */
+	batchApplyStats = myBatchStats;
+
+	/* changes are applied in order once the transforms of the batch are evaluated */
+	if (defer_transformed_change(pgdml, type))
+		return 0;
+
+	return apply_pgdml(pgdml, type);
 }
 
 /*
@@ -904,6 +2091,58 @@ ra_executeCommand(const char * query)
 	return spi_execute(query, TYPE_UNDEF);
 }
 
+/*
+ * ra_hasCrossRowConstraints
+ *
+ * This function returns true if changes to different rows of the relation can
+ * conflict with each other, which is the case if it has a unique or exclusion
+ * index besides its PK or replica identity index, has a foreign key or is
+ * referenced by one. Changes to such tables are only known to succeed if they
+ * are applied in the order they were made on the source.
+ */
+bool
+ra_hasCrossRowConstraints(Relation rel)
+{
+	Oid identityidx = GetRelationIdentityOrPK(rel);
+	List * indexoids;
+	List * referencing;
+	ListCell * cell;
+	bool result = false;
+
+	indexoids = RelationGetIndexList(rel);
+	foreach(cell, indexoids)
+	{
+		Oid indexoid = lfirst_oid(cell);
+		HeapTuple tuple;
+		Form_pg_index index;
+
+		if (indexoid == identityidx)
+			continue;
+
+		tuple = SearchSysCache1(INDEXRELID, ObjectIdGetDatum(indexoid));
+		if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "cache lookup failed for index %u", indexoid);
+
+		index = (Form_pg_index) GETSTRUCT(tuple);
+		result = index->indisunique || index->indisexclusion;
+		ReleaseSysCache(tuple);
+
+		if (result)
+			break;
+	}
+	list_free(indexoids);
+
+	if (result || RelationGetFKeyList(rel) != NIL)
+		return true;
+
+	/* foreign keys of other tables referencing this one */
+	referencing = heap_truncate_find_FKs(list_make1_oid(RelationGetRelid(rel)));
+	result = (referencing != NIL);
+	list_free(referencing);
+
+	return result;
+}
+
 /*
  * ra_listConnInfoNames
  *
@@ -979,19 +2218,536 @@ ra_listConnInfoNames(char ** out, int * numout)
 	return 0;
 }
 
+/*
+ * parameterize_expression
+ *
+ * helper function to turn the tokens of a transform expression into parameters
+ * of a SELECT query, each written with paramfmt and its parameter number. A
+ * token quoted on its own like '%d' becomes a parameter together with its
+ * quotes. NULL is returned if a token is part of a larger string literal or if
+ * %d is not quoted, such an expression can only be run with its tokens filled in
+ */
+static char *
+parameterize_expression(const char * expression, TRANSFORM_PLAN * tplan, const char * paramfmt)
+{
+	StringInfoData strinfo;
+	const char *sp;
+	bool inquote = false;
+	int i;
+
+	initStringInfo(&strinfo);
+	appendStringInfoString(&strinfo, "SELECT ");
+
+	tplan->ntokens = 0;
+	for (sp = expression; *sp; sp++)
+	{
+		if (*sp == '\'')
+		{
+			inquote = !inquote;
+			appendStringInfoChar(&strinfo, *sp);
+			continue;
+		}
+
+		if (*sp != '%' || (sp[1] != 'd' && sp[1] != 'w' && sp[1] != 's' && sp[1] != '%'))
+		{
+			appendStringInfoChar(&strinfo, *sp);
+			continue;
+		}
+
+		sp++;
+		if (*sp == '%')
+		{
+			/* convert %% to a single % */
+			appendStringInfoChar(&strinfo, *sp);
+			continue;
+		}
+
+		if (inquote)
+		{
+			if (sp - 2 < expression || sp[-2] != '\'' || sp[1] != '\'' ||
+				(sp - 3 >= expression && sp[-3] == '\''))
+			{
+				pfree(strinfo.data);
+				return NULL;
+			}
+
+			/* drop the quotes around the token */
+			strinfo.data[--strinfo.len] = '\0';
+			sp++;
+			inquote = false;
+		}
+		else if (*sp == 'd')
+		{
+			/*
+			 * data filled in without quotes is a literal whose type depends on
+			 * the value, like 3.5 or 5000000000, while a parameter takes a single
+			 * type from the expression around it
+			 */
+			pfree(strinfo.data);
+			return NULL;
+		}
+
+		/* parameters are numbered in order of first appearance */
+		for (i = 0; i < tplan->ntokens; i++)
+		{
+			if (tplan->tokens[i] == *sp)
+				break;
+		}
+		if (i == tplan->ntokens)
+			tplan->tokens[tplan->ntokens++] = *sp;
+
+		appendStringInfo(&strinfo, paramfmt, i + 1);
+	}
+	return strinfo.data;
+}
+
+/*
+ * transform_parser_setup
+ *
+ * parser setup hook of a transform expression plan. The parameter types are
+ * resolved from the expression the same way the types of the quoted literals
+ * the tokens used to be filled in as are
+ */
+static void
+transform_parser_setup(struct ParseState * pstate, void * arg)
+{
+	TRANSFORM_PLAN * tplan = (TRANSFORM_PLAN *) arg;
+
+	setup_parse_variable_parameters(pstate, &tplan->argtypes, &tplan->nargs);
+}
+
+/*
+ * get_transform_plan
+ *
+ * This function returns the prepared plan of the given transform expression,
+ * preparing it with SPI the first time the expression is seen. Must be called
+ * while connected to SPI
+ */
+static TRANSFORM_PLAN *
+get_transform_plan(const char * expression)
+{
+	TRANSFORM_PLAN * tplan;
+	SPIPrepareOptions options;
+	SPIPlanPtr plan;
+	Oid * argtypes;
+	char * query;
+	bool found;
+
+	if (!transformPlanHash)
+	{
+		HASHCTL hash_ctl;
+
+		memset(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = SYNCHDB_TRANSFORM_EXPRESSION_SIZE;
+		hash_ctl.entrysize = sizeof(TRANSFORM_PLAN);
+		hash_ctl.hcxt = TopMemoryContext;
+
+		transformPlanHash = hash_create("transform plan hash",
+										64,
+										&hash_ctl,
+										HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+	}
+
+	tplan = (TRANSFORM_PLAN *) hash_search(transformPlanHash, expression, HASH_ENTER, &found);
+	if (found)
+		return tplan;
+
+	tplan->plan = NULL;
+	tplan->ntokens = 0;
+	tplan->argtypes = NULL;
+	tplan->nargs = 0;
+	tplan->batchplan = NULL;
+	tplan->nobatch = false;
+
+	PG_TRY();
+	{
+		query = parameterize_expression(expression, tplan, "$%d");
+		if (query)
+		{
+			elog(DEBUG1, "preparing transform expression '%s' as '%s'", expression, query);
+
+			/* the entry is the parser setup argument whenever the plan is reanalyzed */
+			memset(&options, 0, sizeof(options));
+			options.parserSetup = transform_parser_setup;
+			options.parserSetupArg = tplan;
+
+			plan = SPI_prepare_extended(query, &options);
+			if (plan == NULL)
+				elog(ERROR, "failed to prepare transform expression '%s': %s",
+					 expression, SPI_result_code_string(SPI_result));
+
+			/* parameter types were resolved in SPI memory */
+			argtypes = tplan->argtypes;
+			if (tplan->nargs > 0)
+			{
+				tplan->argtypes = MemoryContextAlloc(TopMemoryContext, sizeof(Oid) * tplan->nargs);
+				memcpy(tplan->argtypes, argtypes, sizeof(Oid) * tplan->nargs);
+			}
+
+			SPI_keepplan(plan);
+			tplan->plan = plan;
+			pfree(query);
+		}
+		else
+			elog(DEBUG1, "transform expression '%s' is run with its tokens filled in", expression);
+	}
+	PG_CATCH();
+	{
+		hash_search(transformPlanHash, expression, HASH_REMOVE, NULL);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	return tplan;
+}
+
+/*
+ * get_transform_batch_plan
+ *
+ * This function returns the plan that evaluates a transform expression over
+ * arrays of values with unnest, one result row per element in array order,
+ * preparing it the first time. The array element types are the parameter
+ * types resolved for the expression. NULL is returned if the expression cannot
+ * be evaluated this way. Must be called while connected to SPI
+ */
+static SPIPlanPtr
+get_transform_batch_plan(TRANSFORM_PLAN * tplan)
+{
+	TRANSFORM_PLAN scratch = {0};
+	StringInfoData strinfo;
+	Oid argtypes[3];
+	char * query;
+	int i;
+
+	if (tplan->batchplan || tplan->nobatch)
+		return tplan->batchplan;
+
+	tplan->nobatch = true;
+	if (!tplan->plan || tplan->nargs == 0 || tplan->nargs > tplan->ntokens)
+		return NULL;
+
+	for (i = 0; i < tplan->nargs; i++)
+	{
+		Oid elemtype = tplan->argtypes[i];
+
+		if (!OidIsValid(elemtype) || elemtype == UNKNOWNOID)
+			elemtype = TEXTOID;
+
+		argtypes[i] = get_array_type(elemtype);
+		if (!OidIsValid(argtypes[i]))
+			return NULL;
+	}
+
+	query = parameterize_expression(tplan->expression, &scratch, "t.a%d");
+	if (!query)
+		return NULL;
+
+	initStringInfo(&strinfo);
+	appendStringInfo(&strinfo, "%s FROM unnest(", query);
+	for (i = 0; i < tplan->nargs; i++)
+		appendStringInfo(&strinfo, "%s$%d", i > 0 ? ", " : "", i + 1);
+	appendStringInfoString(&strinfo, ") WITH ORDINALITY AS t(");
+	for (i = 0; i < tplan->nargs; i++)
+		appendStringInfo(&strinfo, "a%d, ", i + 1);
+	appendStringInfoString(&strinfo, "n) ORDER BY t.n");
+
+	elog(DEBUG1, "preparing transform expression '%s' over arrays as '%s'",
+		 tplan->expression, strinfo.data);
+
+	tplan->batchplan = SPI_prepare(strinfo.data, tplan->nargs, argtypes);
+	if (tplan->batchplan == NULL)
+		elog(ERROR, "failed to prepare transform expression '%s' over arrays: %s",
+			 tplan->expression, SPI_result_code_string(SPI_result));
+	SPI_keepplan(tplan->batchplan);
+	tplan->nobatch = false;
+
+	pfree(query);
+	pfree(strinfo.data);
+	return tplan->batchplan;
+}
+
+/*
+ * transform_values
+ *
+ * This function applies the transform expression of the given list of
+ * PG_DML_COLUMN_VALUE, which all have the same expression, with a single query
+ * over arrays of their values and stores the results back into them. Values
+ * are transformed one by one if the expression cannot be evaluated over arrays
+ */
+static void
+transform_values(List * colvals)
+{
+	PG_DML_COLUMN_VALUE * first = (PG_DML_COLUMN_VALUE *) linitial(colvals);
+	char * expression = first->transformExpression;
+	MemoryContext valueContext = CurrentMemoryContext;
+	TRANSFORM_PLAN * tplan;
+	SPIPlanPtr batchplan = NULL;
+	ListCell * cell;
+	int nvalues = list_length(colvals);
+	int ret, i, j;
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "transform data expression - SPI_connect failed");
+
+	tplan = get_transform_plan(expression);
+	if (nvalues > 1)
+		batchplan = get_transform_batch_plan(tplan);
+
+	if (batchplan)
+	{
+		Datum args[3];
+		char argnulls[3];
+
+		for (i = 0; i < tplan->nargs; i++)
+		{
+			Oid elemtype = tplan->argtypes[i];
+			Datum * elems = palloc(sizeof(Datum) * nvalues);
+			bool * elemnulls = palloc(sizeof(bool) * nvalues);
+			int dims[1] = {nvalues};
+			int lbs[1] = {1};
+			int16 typlen;
+			bool typbyval;
+			char typalign;
+			Oid typinput;
+			Oid typioparam;
+
+			if (!OidIsValid(elemtype) || elemtype == UNKNOWNOID)
+				elemtype = TEXTOID;
+			get_typlenbyvalalign(elemtype, &typlen, &typbyval, &typalign);
+			getTypeInputInfo(elemtype, &typinput, &typioparam);
+
+			j = 0;
+			foreach(cell, colvals)
+			{
+				PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
+				char * arg = tplan->tokens[i] == 'd' ? colval->value :
+					(tplan->tokens[i] == 'w' ? colval->wkb : colval->srid);
+
+				elemnulls[j] = (arg == NULL);
+				elems[j] = arg ? OidInputFunctionCall(typinput, arg, typioparam, -1) : (Datum) 0;
+				j++;
+			}
+
+			args[i] = PointerGetDatum(construct_md_array(elems, elemnulls, 1, dims, lbs,
+														 elemtype, typlen, typbyval, typalign));
+			argnulls[i] = ' ';
+		}
+
+		ret = SPI_execute_plan(batchplan, args, argnulls, true, 0);
+		if (ret != SPI_OK_SELECT || SPI_processed != nvalues)
+			elog(ERROR, "data transform expression '%s' results in %lu values for %d",
+				 expression, (unsigned long) SPI_processed, nvalues);
+
+		/* results come in the order of the values, see get_transform_batch_plan() */
+		j = 0;
+		foreach(cell, colvals)
+		{
+			PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
+			char * transData = SPI_getvalue(SPI_tuptable->vals[j++], SPI_tuptable->tupdesc, 1);
+
+			/* a null result replaces the value too, it must not be left as received */
+			colval->value = MemoryContextStrdup(valueContext, transData ? transData : "NULL");
+			colval->transformExpression = NULL;
+		}
+		SPI_finish();
+		return;
+	}
+	SPI_finish();
+
+	foreach(cell, colvals)
+	{
+		PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
+		char * transData = ra_transformDataExpression(colval->value, colval->wkb,
+													  colval->srid, expression);
+
+		if (transData)
+		{
+			colval->value = pstrdup(transData);
+			pfree(transData);
+		}
+		colval->transformExpression = NULL;
+	}
+}
+
+/*
+ * add_pending_transforms
+ *
+ * helper function to group the values of colvals that still need a transform
+ * expression by expression. groups is a list of lists of PG_DML_COLUMN_VALUE
+ */
+static List *
+add_pending_transforms(List * groups, List * colvals)
+{
+	ListCell * cell;
+	ListCell * gcell;
+
+	foreach(cell, colvals)
+	{
+		PG_DML_COLUMN_VALUE * colval = (PG_DML_COLUMN_VALUE *) lfirst(cell);
+		bool found = false;
+
+		if (!colval->transformExpression)
+			continue;
+
+		foreach(gcell, groups)
+		{
+			List ** group = (List **) &lfirst(gcell);
+
+			if (!strcmp(((PG_DML_COLUMN_VALUE *) linitial(*group))->transformExpression,
+						colval->transformExpression))
+			{
+				*group = lappend(*group, colval);
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			groups = lappend(groups, list_make1(colval));
+	}
+	return groups;
+}
+
+/*
+ * ra_deferTransforms - Check if data transforms are evaluated per batch
+ *
+ * This function tells the format converter whether transform expressions of
+ * values are to be recorded in the PG_DML_COLUMN_VALUE rather than evaluated
+ * right away, which is the case within a batch applied without SPI when
+ * synchdb.batch_transform_expressions is on.
+ *
+ * @return: true if transforms are deferred
+ */
+bool
+ra_deferTransforms(void)
+{
+	return batchApplyHash && synchdb_batch_transform_expressions && !synchdb_dml_use_spi;
+}
+
+/*
+ * defer_transformed_change
+ *
+ * This function queues a copy of a change that has values waiting for their
+ * transform expression, or any change once the queue is not empty so changes
+ * stay in order. Returns false if the change can be applied right away.
+ */
+static bool
+defer_transformed_change(PG_DML * pgdml, ConnectorType type)
+{
+	BATCH_APPLY_TABLE standalone;
+	BATCH_APPLY_TABLE * applytable;
+	TRANSFORM_QUEUE_ITEM * item;
+	MemoryContext oldContext;
+	ListCell * cell;
+	bool pending = false;
+
+	if (transformQueue == NIL)
+	{
+		if (!ra_deferTransforms())
+			return false;
+
+		foreach(cell, pgdml->columnValuesAfter)
+			pending |= ((PG_DML_COLUMN_VALUE *) lfirst(cell))->transformExpression != NULL;
+		foreach(cell, pgdml->columnValuesBefore)
+			pending |= ((PG_DML_COLUMN_VALUE *) lfirst(cell))->transformExpression != NULL;
+		if (!pending)
+			return false;
+
+		transformQueueContext = AllocSetContextCreate(batchApplyContext,
+													  "synchdb transform queue context",
+													  ALLOCSET_DEFAULT_SIZES);
+	}
+
+	applytable = get_apply_table(pgdml->tableoid, &standalone);
+
+	oldContext = MemoryContextSwitchTo(transformQueueContext);
+	item = (TRANSFORM_QUEUE_ITEM *) palloc(sizeof(TRANSFORM_QUEUE_ITEM));
+	item->type = type;
+	item->pgdml = (PG_DML *) palloc0(sizeof(PG_DML));
+	item->pgdml->dmlquery = pgdml->dmlquery ? pstrdup(pgdml->dmlquery) : NULL;
+	item->pgdml->op = pgdml->op;
+	item->pgdml->tableoid = pgdml->tableoid;
+	item->pgdml->columnValuesBefore = copy_colvals(pgdml->columnValuesBefore);
+	item->pgdml->columnValuesAfter = copy_colvals(pgdml->columnValuesAfter);
+	item->pgdml->columnInputs = own_column_inputs(applytable, pgdml->columnInputs,
+												  pgdml->ncolumnInputs);
+	item->pgdml->ncolumnInputs = item->pgdml->columnInputs ? pgdml->ncolumnInputs : 0;
+	transformQueue = lappend(transformQueue, item);
+	MemoryContextSwitchTo(oldContext);
+
+	release_apply_table(applytable, &standalone);
+
+	return true;
+}
+
+/*
+ * flush_transform_queue
+ *
+ * This function evaluates the transform expressions of all queued changes,
+ * one query per expression, and then applies the changes in order
+ */
+static void
+flush_transform_queue(void)
+{
+	List * queue = transformQueue;
+	MemoryContext queueContext = transformQueueContext;
+	MemoryContext oldContext;
+	List * groups = NIL;
+	ListCell * cell;
+
+	if (queue == NIL)
+		return;
+
+	/* applying the changes below must not queue them again */
+	transformQueue = NIL;
+	transformQueueContext = NULL;
+
+	oldContext = MemoryContextSwitchTo(queueContext);
+	foreach(cell, queue)
+	{
+		TRANSFORM_QUEUE_ITEM * item = (TRANSFORM_QUEUE_ITEM *) lfirst(cell);
+
+		groups = add_pending_transforms(groups, item->pgdml->columnValuesAfter);
+		groups = add_pending_transforms(groups, item->pgdml->columnValuesBefore);
+	}
+
+	elog(DEBUG1, "evaluating %d transform expressions for %d changes",
+		 list_length(groups), list_length(queue));
+	foreach(cell, groups)
+		transform_values((List *) lfirst(cell));
+	MemoryContextSwitchTo(oldContext);
+
+	foreach(cell, queue)
+	{
+		TRANSFORM_QUEUE_ITEM * item = (TRANSFORM_QUEUE_ITEM *) lfirst(cell);
+
+		/* same as a change that fails when applied right away */
+		if (apply_pgdml(item->pgdml, item->type))
+		{
+			elog(WARNING, "failed to apply %c change to table %d after transform",
+				 item->pgdml->op, item->pgdml->tableoid);
+			if (batchApplyStats)
+				increment_connector_statistics(batchApplyStats, STATS_BAD_CHANGE_EVENT, 1);
+		}
+	}
+	MemoryContextDelete(queueContext);
+}
+
 /*
  * ra_transformDataExpression
  *
- * Main entry to perform data transformation on the given data using SPI
+ * Main entry to perform data transformation on the given data using SPI. The
+ * expression is prepared once and then run with the data, wkb and srid as
+ * parameters
  */
 char *
 ra_transformDataExpression(char * data, char * wkb, char * srid, char * expression)
 {
-	char * filledExpression = NULL;
+	TRANSFORM_PLAN * tplan;
+	ParamListInfo params;
+	SPIExecuteOptions options;
 	int ret = -1, i = 0;
 	char * value = NULL;
 	MemoryContext oldcontext;
-	StringInfoData strinfo;
 	bool skiptx = false;
 
 	/*
@@ -1001,14 +2757,7 @@ ra_transformDataExpression(char * data, char * wkb, char * srid, char * expressi
 	if (IsTransactionOrTransactionBlock())
 		skiptx = true;
 
-	initStringInfo(&strinfo);
-
-	filledExpression = swap_tokens(expression, data, wkb, srid);
-	appendStringInfo(&strinfo, "SELECT %s;", filledExpression);
-
-	elog(DEBUG1,"expression to execute = '%s'", strinfo.data);
-
-	/* run the filled expression with SPI and obtain result as string */
+	/* run the expression with SPI and obtain result as string */
 	if (!skiptx)
 	{
 		/* Start a transaction and set up a snapshot */
@@ -1022,7 +2771,51 @@ ra_transformDataExpression(char * data, char * wkb, char * srid, char * expressi
 		goto end;
 	}
 
-	ret = SPI_execute(strinfo.data, true, 1);
+	tplan = get_transform_plan(expression);
+	if (tplan->plan)
+	{
+		params = makeParamList(tplan->nargs);
+		for (i = 0; i < tplan->nargs; i++)
+		{
+			ParamExternData * prm = &params->params[i];
+			char * arg = NULL;
+			Oid typinput;
+			Oid typioparam;
+
+			if (i < tplan->ntokens)
+				arg = tplan->tokens[i] == 'd' ? data : (tplan->tokens[i] == 'w' ? wkb : srid);
+
+			prm->ptype = tplan->argtypes[i];
+			prm->pflags = PARAM_FLAG_CONST;
+			prm->isnull = (arg == NULL || !OidIsValid(prm->ptype));
+			prm->value = (Datum) 0;
+			if (!prm->isnull)
+			{
+				getTypeInputInfo(prm->ptype, &typinput, &typioparam);
+				prm->value = OidInputFunctionCall(typinput, arg, typioparam, -1);
+			}
+		}
+
+		memset(&options, 0, sizeof(options));
+		options.params = params;
+		options.read_only = true;
+		options.tcount = 1;
+		ret = SPI_execute_plan_extended(tplan->plan, &options);
+	}
+	else
+	{
+		StringInfoData strinfo;
+		char * filledExpression = swap_tokens(expression, data, wkb, srid);
+
+		initStringInfo(&strinfo);
+		appendStringInfo(&strinfo, "SELECT %s;", filledExpression);
+		elog(DEBUG1,"expression to execute = '%s'", strinfo.data);
+
+		ret = SPI_execute(strinfo.data, true, 1);
+		pfree(filledExpression);
+		pfree(strinfo.data);
+	}
+
 	switch (ret)
 	{
 		case SPI_OK_SELECT:
@@ -1042,27 +2835,36 @@ ra_transformDataExpression(char * data, char * wkb, char * srid, char * expressi
 		goto end;
 	}
 
-	/* only 1 record at most is expected */
+	/* only 1 record at most is expected, a null result is returned as "NULL" */
 	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
-	value = pstrdup(SPI_getvalue(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 1));
+	value = SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
+	value = pstrdup(value ? value : "NULL");
 	MemoryContextSwitchTo(oldcontext);
 
 	/* Close the connection */
 	SPI_finish();
 
+end:
 	if (!skiptx)
 	{
 		/* Commit the transaction */
 		PopActiveSnapshot();
 		CommitTransactionCommand();
 	}
+	return value;
+}
 
-end:
-	if (filledExpression)
-		pfree(filledExpression);
-
-	if (strinfo.data)
-		pfree(strinfo.data);
+/*
+ * ra_parameterizeExpression
+ *
+ * returns the query a transform expression is prepared as, with its tokens
+ * turned into parameters, or NULL if the expression can only be run with its
+ * tokens filled in. Used by the regression tests
+ */
+char *
+ra_parameterizeExpression(const char * expression)
+{
+	TRANSFORM_PLAN tplan = {0};
 
-	return value;
+	return parameterize_expression(expression, &tplan, "$%d");
 }
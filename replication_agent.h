@@ -18,9 +18,16 @@
 #ifndef SYNCHDB_REPLICATION_AGENT_H_
 #define SYNCHDB_REPLICATION_AGENT_H_
 
+#include "executor/spi.h"
 #include "executor/tuptable.h"
+#include "fmgr.h"
+#include "nodes/execnodes.h"
 #include "synchdb.h"
 
+/* limits of snapshot rows buffered per table before table_multi_insert */
+#define SYNCHDB_MULTI_INSERT_MAX_TUPLES 1000
+#define SYNCHDB_MULTI_INSERT_MAX_BYTES 65535
+
 /* Data structures representing PostgreSQL data formats */
 typedef struct pg_ddl
 {
@@ -35,8 +42,22 @@ typedef struct pg_ddl_column_value
 					 */
 	Oid datatype;
 	int position;	/* position of this value's attribute in tupdesc */
+	char * transformExpression;	/* transform expression still to apply to value, NULL if none */
+	char * wkb;		/* wkb of a geometry value for transformExpression */
+	char * srid;	/* srid of a geometry value for transformExpression */
+	bool hasInternalValue;	/* true if internalValue or numericValue is to be stored instead of value */
+	int64 internalValue;	/* DateADT, TimeADT or Timestamp of a date/time value */
+	Datum numericValue;		/* Numeric of a numeric value */
 } PG_DML_COLUMN_VALUE;
 
+/* type input information of an attribute, prepared once per table */
+typedef struct pg_dml_column_input
+{
+	FmgrInfo finfo;		/* type input function */
+	Oid typioparam;
+	int32 typmod;
+} PG_DML_COLUMN_INPUT;
+
 typedef struct pg_dml
 {
 	char * dmlquery;	/* to be fed into SPI */
@@ -45,14 +66,87 @@ typedef struct pg_dml
 	Oid tableoid;
 	List * columnValuesBefore;	/* list of PG_DML_COLUMN_VALUE */
 	List * columnValuesAfter;	/* list of PG_DML_COLUMN_VALUE */
+	PG_DML_COLUMN_INPUT * columnInputs;	/* indexed by position - 1, NULL if not prepared */
+	int ncolumnInputs;
 } PG_DML;
 
+/* executor state of a target table, kept open for a whole batch */
+typedef struct batch_apply_table
+{
+	Oid tableoid;		/* hash key */
+	Relation rel;
+	EState * estate;
+	ResultRelInfo * resultRelInfo;
+	TupleTableSlot * remoteslot;	/* tuple built from change event */
+	TupleTableSlot * localslot;		/* existing tuple found in table */
+	EPQState epqstate;
+	Oid idxoid;			/* PK or replica identity index, InvalidOid if none */
+	Bitmapset * keyattrs;	/* columns of idxoid, offset by FirstLowInvalidHeapAttributeNumber */
+	Oid lookupidxoid;	/* index to locate old tuples, idxoid or another usable one */
+	bool upsert;		/* insert or update on conflict with idxoid */
+	bool compact;		/* row changes may be collapsed by batch compaction */
+	PG_DML_COLUMN_INPUT * ownedInputs;	/* copy of the column inputs of deferred changes */
+	PG_DML_COLUMN_INPUT * ownedInputsSource;	/* data cache array ownedInputs is copied from */
+
+	/* snapshot rows buffered for table_multi_insert */
+	bool multiinsert;	/* false if rows must be inserted one by one */
+	bool frozen;		/* insert buffered rows frozen */
+	struct BulkInsertStateData * bistate;
+	TupleTableSlot ** bufferedslots;
+	int nbuffered;
+	Size bufferedbytes;
+} BATCH_APPLY_TABLE;
+
+/* key of a row changed in the current batch */
+typedef struct batch_compact_key
+{
+	Oid tableoid;
+	char * keyvalues;	/* key column values of the row */
+} BATCH_COMPACT_KEY;
+
+/* net change made to a row by the current batch, not applied yet */
+typedef struct batch_compact_row
+{
+	BATCH_COMPACT_KEY key;	/* hash key */
+	char op;			/* 'c', 'u', 'd' or 0 if the changes cancel out */
+	ConnectorType type;
+	List * columnValuesBefore;	/* list of PG_DML_COLUMN_VALUE */
+	List * columnValuesAfter;	/* list of PG_DML_COLUMN_VALUE */
+	PG_DML_COLUMN_INPUT * columnInputs;
+	int ncolumnInputs;
+} BATCH_COMPACT_ROW;
+
+/* prepared plan of a data transform expression */
+typedef struct transform_plan
+{
+	char expression[SYNCHDB_TRANSFORM_EXPRESSION_SIZE];	/* hash key */
+	SPIPlanPtr plan;	/* NULL if the expression must be run with its tokens filled in */
+	int ntokens;
+	char tokens[3];		/* token of each parameter: 'd', 'w' or 's' */
+	Oid * argtypes;		/* parameter types resolved when the plan is prepared */
+	int nargs;
+	SPIPlanPtr batchplan;	/* plan evaluating the expression over arrays of values */
+	bool nobatch;		/* true if the expression cannot be evaluated over arrays */
+} TRANSFORM_PLAN;
+
+/* change waiting for the transform expressions of its values */
+typedef struct transform_queue_item
+{
+	PG_DML * pgdml;
+	ConnectorType type;
+} TRANSFORM_QUEUE_ITEM;
+
 /* Function prototypes */
 int ra_executePGDDL(PG_DDL * pgddl, ConnectorType type);
 int ra_executePGDML(PG_DML * pgdml, ConnectorType type, SynchdbStatistics * myBatchStats);
+void ra_beginBatchApply(void);
+void ra_endBatchApply(void);
+bool ra_deferTransforms(void);
+bool ra_hasCrossRowConstraints(Relation rel);
 int ra_getConninfoByName(const char * name, ConnectionInfo * conninfo, char ** connector);
 int ra_executeCommand(const char * query);
 int ra_listConnInfoNames(char ** out, int * numout);
 char * ra_transformDataExpression(char * data, char * wkb, char * srid, char * expression);
+char * ra_parameterizeExpression(const char * expression);
 
 #endif /* SYNCHDB_REPLICATION_AGENT_H_ */
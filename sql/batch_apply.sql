@@ -0,0 +1,27 @@
+--
+-- batch apply of change events
+--
+CREATE TABLE compact_test(id int PRIMARY KEY, val text);
+
+-- changes to the same row are collapsed into their net change
+SELECT synchdb_apply_test_batch('compact_test', '{c,u,u}',
+	'{NULL,"(1,a)","(1,b)"}', '{"(1,a)","(1,b)","(1,c)"}', compaction => true) AS bad;
+SELECT * FROM compact_test ORDER BY id;
+
+-- an insert followed by a delete cancels out
+SELECT synchdb_apply_test_batch('compact_test', '{c,d}',
+	'{NULL,"(2,a)"}', '{"(2,a)",NULL}', compaction => true) AS bad;
+SELECT * FROM compact_test ORDER BY id;
+
+-- unless the row may be there already, as when a batch is replayed in upsert mode
+INSERT INTO compact_test VALUES (3, 'stale');
+SELECT synchdb_apply_test_batch('compact_test', '{c,u,d}',
+	'{NULL,"(3,a)","(3,b)"}', '{"(3,a)","(3,b)",NULL}', upsert => true, compaction => true) AS bad;
+SELECT * FROM compact_test ORDER BY id;
+
+INSERT INTO compact_test VALUES (4, 'stale');
+SELECT synchdb_apply_test_batch('compact_test', '{c,d}',
+	'{NULL,"(4,a)"}', '{"(4,a)",NULL}', upsert => true, compaction => false) AS bad;
+SELECT * FROM compact_test ORDER BY id;
+
+DROP TABLE compact_test;
@@ -0,0 +1,59 @@
+--
+-- conversion of change event values
+--
+
+-- decimal values arrive as big-endian two's complement unscaled values
+SELECT v.id, v.unscaled, v.scale, v.typname, d.as_text, d.as_numeric
+FROM (VALUES
+	(1, '\x3039'::bytea, 2, 'numeric'::text),
+	(2, '\xcfc7', 2, 'numeric'),
+	(3, '\xff', 0, 'numeric'),
+	(4, '\x00', 2, 'numeric'),
+	(5, '\x05', 4, 'numeric'),
+	(6, '\xfb', 4, 'numeric'),
+	(7, '\x0c', -2, 'numeric'),
+	(8, '\x029d42b64e76714244cb', 3, 'numeric'),
+	(9, '\xfd62bd49b1898ebdbb35', 3, 'numeric'),
+	(10, '\xf360d3632fb98b1215c0000001', 10, 'numeric'),
+	(11, '\x3039', 2, 'numeric(5,1)'),
+	(12, '\xcfc7', 2, 'numeric(5,1)'),
+	(13, '\xfd62bd49b1898ebdbb35', 3, 'numeric(30,1)')) AS v(id, unscaled, scale, typname),
+	LATERAL synchdb_decode_decimal(v.unscaled, v.scale, v.typname) d
+ORDER BY v.id;
+
+-- date/time values arrive as a number of days or time units since epoch or midnight
+SELECT v.id, v.value, v.semantictype, v.typname,
+	synchdb_decode_temporal(v.value, v.semantictype, v.typname) AS decoded
+FROM (VALUES
+	(1, -1::bigint, 'io.debezium.time.Date'::text, 'date'::text),
+	(2, -719162, 'io.debezium.time.Date', 'date'),
+	(3, -1, 'io.debezium.time.Date', 'timestamp'),
+	(4, -1, 'io.debezium.time.Timestamp', 'timestamp'),
+	(5, -1, 'io.debezium.time.MicroTimestamp', 'timestamp'),
+	(6, -1500, 'io.debezium.time.NanoTimestamp', 'timestamp'),
+	(7, -1, 'io.debezium.time.Timestamp', 'date'),
+	(8, 1234567, 'io.debezium.time.MicroTimestamp', 'timestamp(3)'),
+	(9, -1234567, 'io.debezium.time.MicroTimestamp', 'timestamp(3)'),
+	(10, -1234567, 'io.debezium.time.MicroTimestamp', 'timestamp(0)'),
+	(11, 3723456, 'io.debezium.time.Time', 'time'),
+	(12, 3723456789, 'io.debezium.time.MicroTime', 'time'),
+	(13, 3723456789, 'io.debezium.time.MicroTime', 'time(3)'),
+	(14, 3723456789123, 'io.debezium.time.NanoTime', 'time(3)'),
+	(15, 86400000001, 'io.debezium.time.MicroTime', 'time'),
+	(16, 2147483647, 'io.debezium.time.Date', 'date')) AS v(id, value, semantictype, typname)
+ORDER BY v.id;
+
+-- tokens of a transform expression become parameters unless they are part of a larger literal
+SELECT v.id, v.expression, synchdb_parameterize_expression(v.expression) AS query
+FROM (VALUES
+	(1, $$'%d' || '_suffix'$$::text),
+	(2, $$upper('%d')$$),
+	(3, $$ST_SetSRID(ST_GeomFromWKB(decode('%w', 'hex')), %s)$$),
+	(4, $$'%d' || '-' || '%d'$$),
+	(5, $$'%d'::int * 100 %% 7$$),
+	(6, $$''''||'%d'$$),
+	(7, $$'prefix-%d'$$),
+	(8, $$'%d%%'$$),
+	(9, $$%d + 1$$),
+	(10, $$'''%d'''$$)) AS v(id, expression)
+ORDER BY v.id;
@@ -0,0 +1,27 @@
+--complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION synchdb UPDATE TO '1.1'" to load this file. \quit
+
+-- synchdb_get_stats() returns the number of JNI calls made as an additional column
+CREATE OR REPLACE VIEW synchdb_stats_view AS SELECT * FROM synchdb_get_stats() AS (name text, ddls bigint, dmls bigint, reads bigint, creates bigint, updates bigint, deletes bigint, bad_events bigint, total_events bigint, batches_done bigint, avg_batch_size bigint, jni_calls bigint);
+
+-- applies a batch of changes to a table like a connector does, for regression tests
+CREATE OR REPLACE FUNCTION synchdb_apply_test_batch(tbl regclass, ops text[], befores text[], afters text[],
+		upsert bool DEFAULT false, compaction bool DEFAULT false) RETURNS bigint
+AS '$libdir/synchdb'
+LANGUAGE C STRICT;
+
+-- decodes the unscaled value of a decimal column like the format converter does, for regression tests
+CREATE OR REPLACE FUNCTION synchdb_decode_decimal(unscaled bytea, scale int, typname text DEFAULT 'numeric',
+		OUT as_text text, OUT as_numeric numeric)
+AS '$libdir/synchdb'
+LANGUAGE C STRICT;
+
+-- decodes a date/time value like the format converter does, for regression tests
+CREATE OR REPLACE FUNCTION synchdb_decode_temporal(value bigint, semantictype text, typname text) RETURNS text
+AS '$libdir/synchdb'
+LANGUAGE C STRICT;
+
+-- turns the tokens of a transform expression into parameters like the replication agent does, for regression tests
+CREATE OR REPLACE FUNCTION synchdb_parameterize_expression(expression text) RETURNS text
+AS '$libdir/synchdb'
+LANGUAGE C STRICT;
@@ -22,6 +22,7 @@
 #include "utils/builtins.h"
 #include <jni.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include "format_converter.h"
 #include "postmaster/bgworker.h"
 #include "postmaster/interrupt.h"
@@ -31,6 +32,7 @@
 #include "storage/proc.h"
 #include "storage/ipc.h"
 #include "storage/fd.h"
+#include "storage/pmsignal.h"
 #include "miscadmin.h"
 #include "utils/wait_event.h"
 #include "utils/guc.h"
@@ -38,8 +40,16 @@
 #include "funcapi.h"
 #include "synchdb.h"
 #include "replication_agent.h"
+#include "parallel_apply.h"
 #include "access/xact.h"
 #include "utils/snapmgr.h"
+#include "utils/memutils.h"
+#include "utils/array.h"
+#include "utils/fmgroids.h"
+#include "utils/lsyscache.h"
+#include "access/htup_details.h"
+#include "access/table.h"
+#include "parser/parse_type.h"
 
 PG_MODULE_MAGIC;
 
@@ -56,12 +66,22 @@ PG_FUNCTION_INFO_V1(synchdb_restart_connector);
 PG_FUNCTION_INFO_V1(synchdb_log_jvm_meminfo);
 PG_FUNCTION_INFO_V1(synchdb_get_stats);
 PG_FUNCTION_INFO_V1(synchdb_reset_stats);
+PG_FUNCTION_INFO_V1(synchdb_apply_test_batch);
+PG_FUNCTION_INFO_V1(synchdb_decode_decimal);
+PG_FUNCTION_INFO_V1(synchdb_decode_temporal);
+PG_FUNCTION_INFO_V1(synchdb_parameterize_expression);
 
 /* Constants */
-#define SYNCHDB_METADATA_DIR "pg_synchdb"
 #define DBZ_ENGINE_JAR_FILE "dbz-engine-1.0.0.jar"
 #define MAX_PATH_LENGTH 1024
 #define MAX_JAVA_OPTION_LENGTH 256
+#define SYNCHDB_JNI_LOCAL_FRAME_SIZE 16
+
+/*
+ * JNI_CALL - invokes a JNI function through the env in scope and counts it
+ * towards the JNI calls made for the current batch
+ */
+#define JNI_CALL(call) (jniCallCount++, (*env)->call)
 
 /* Global variables */
 SynchdbSharedState *sdb_state = NULL; /* Pointer to shared-memory state. */
@@ -71,6 +91,16 @@ ExtraConnectionInfo extraConnInfo = {0}; /* global extra connector parameters re
 /* GUC variables */
 int synchdb_worker_naptime = 500;
 bool synchdb_dml_use_spi = false;
+bool synchdb_dml_use_streaming_parser = false;
+bool synchdb_jni_use_direct_buffer = false;
+bool synchdb_jni_pipeline_batches = false;
+bool synchdb_jni_binary_change_events = false;
+bool synchdb_snapshot_fast_load = false;
+bool synchdb_dml_batch_compaction = false;
+bool synchdb_dml_upsert = false;
+bool synchdb_batch_transform_expressions = false;
+int synchdb_parallel_apply_workers = 0;
+bool synchdb_parallel_apply_transactions = false;
 bool synchdb_auto_launcher = true;
 int dbz_batch_size = 2048;
 int dbz_queue_size = 8192;
@@ -92,6 +122,33 @@ static JavaVM *jvm = NULL; /* represents java vm instance */
 static JNIEnv *env = NULL; /* represents JNI run-time environment */
 static jclass cls;		   /* represents debezium runner java class */
 static jobject obj;		   /* represents debezium runner java class object */
+static int dbz_batch_pipe[2] = {-1, -1}; /* written by debezium runner when a batch is queued */
+static bool dbz_pipeline_batches = false; /* debezium runner prepares batches in background */
+static bool dbz_binary_change_events = false; /* debezium runner sends change events in binary format */
+static unsigned long long jniCallCount = 0; /* JNI calls made for current batch */
+
+/*
+ * DbzJniBindings - JNI classes and method IDs used by the connector worker.
+ * They are resolved once by dbz_engine_init() so that processing a batch
+ * does not need any class or method lookup.
+ */
+typedef struct DbzJniBindings
+{
+	jclass listClass;					/* global ref to java/util/List */
+	jmethodID listSize;
+	jmethodID listGet;
+	jmethodID startEngine;
+	jmethodID stopEngine;
+	jmethodID getChangeEvents;
+	jmethodID getChangeEventsBuffer;
+	jmethodID markBatchComplete;
+	jmethodID markBatchCompleteAsync;
+	jmethodID getConnectorOffset;
+	jmethodID setConnectorOffset;
+	jmethodID jvmMemDump;
+} DbzJniBindings;
+
+static DbzJniBindings jni_bindings = {0};
 
 /* Function declarations */
 PGDLLEXPORT void synchdb_engine_main(Datum main_arg);
@@ -102,12 +159,13 @@ static int dbz_engine_stop(void);
 static int dbz_engine_init(JNIEnv *env, jclass *cls, jobject *obj);
 static int dbz_engine_get_change(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int myConnectorId, bool * dbzExitSignal,
 		BatchInfo * batchinfo, SynchdbStatistics * myBatchStats);
+static int dbz_engine_get_change_buffer(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int myConnectorId, bool * dbzExitSignal,
+		BatchInfo * batchinfo, SynchdbStatistics * myBatchStats);
 static int dbz_engine_start(const ConnectionInfo *connInfo, ConnectorType connectorType, const char * snapshotMode);
 static char *dbz_engine_get_offset(int connectorId);
 static int dbz_mark_batch_complete(int batchid);
 static TupleDesc synchdb_state_tupdesc(void);
 static TupleDesc synchdb_stats_tupdesc(void);
-static void synchdb_init_shmem(void);
 static void synchdb_detach_shmem(int code, Datum arg);
 static void prepare_bgw(BackgroundWorker *worker, const ConnectionInfo *connInfo, const char *connector, int connectorid, const char * snapshotMode);
 static const char *connectorStateAsString(ConnectorState state);
@@ -155,7 +213,8 @@ static void set_extra_dbz_parameters(jobject myParametersObj, jclass myParameter
 	jmethodID setBatchSize, setQueueSize, setSkippedOperations, setConnectTimeout, setQueryTimeout;
 	jmethodID setSnapshotThreadNum, setSnapshotFetchSize, setSnapshotMinRowToStreamResults;
 	jmethodID setIncrementalSnapshotChunkSize, setIncrementalSnapshotWatermarkingStrategy;
-	jmethodID setOffsetFlushIntervalMs, setCaptureOnlySelectedTableDDL;
+	jmethodID setOffsetFlushIntervalMs, setCaptureOnlySelectedTableDDL, setPipelineBatches, setBinaryChangeEvents;
+	jmethodID setTransactionMetadata;
 	jmethodID setSslmode, setSslKeystore, setSslKeystorePass, setSslTruststore, setSslTruststorePass;
 	jstring jdbz_skipped_operations, jdbz_watermarking_strategy;
 	jstring jdbz_sslmode, jdbz_sslkeystore, jdbz_sslkeystorepass, jdbz_ssltruststore, jdbz_ssltruststorepass;
@@ -327,6 +386,66 @@ static void set_extra_dbz_parameters(jobject myParametersObj, jclass myParameter
 	else
 		elog(WARNING, "failed to find setCaptureOnlySelectedTableDDL method");
 
+	/*
+	 * batch pipelining changes how batches are fetched and acknowledged, so
+	 * remember what Debezium runner has been started with
+	 */
+	dbz_pipeline_batches = false;
+	setPipelineBatches = (*env)->GetMethodID(env, myParametersClass, "setPipelineBatches",
+			"(Z)Lcom/example/DebeziumRunner$MyParameters;");
+	if (setPipelineBatches)
+	{
+		jboolean bval = synchdb_jni_pipeline_batches ? JNI_TRUE : JNI_FALSE;
+		myParametersObj = (*env)->CallObjectMethod(env, myParametersObj, setPipelineBatches, bval);
+		if (!myParametersObj)
+		{
+			elog(WARNING, "failed to call setPipelineBatches method");
+		}
+		else
+			dbz_pipeline_batches = synchdb_jni_pipeline_batches;
+	}
+	else
+		elog(WARNING, "failed to find setPipelineBatches method");
+
+	/* binary change events are only understood when batches come in direct buffers */
+	dbz_binary_change_events = false;
+	setBinaryChangeEvents = (*env)->GetMethodID(env, myParametersClass, "setBinaryChangeEvents",
+			"(Z)Lcom/example/DebeziumRunner$MyParameters;");
+	if (setBinaryChangeEvents)
+	{
+		jboolean bval = JNI_FALSE;
+
+		/* apply workers do not see the table schemas sent ahead of binary change events */
+		if (synchdb_jni_binary_change_events && pa_isActive())
+			elog(WARNING, "binary change events are disabled when parallel apply workers are used");
+		else if (synchdb_jni_binary_change_events)
+			bval = JNI_TRUE;
+		myParametersObj = (*env)->CallObjectMethod(env, myParametersObj, setBinaryChangeEvents, bval);
+		if (!myParametersObj)
+		{
+			elog(WARNING, "failed to call setBinaryChangeEvents method");
+		}
+		else
+			dbz_binary_change_events = (bval == JNI_TRUE);
+	}
+	else
+		elog(WARNING, "failed to find setBinaryChangeEvents method");
+
+	/* transaction metadata is only consumed by apply workers applying source transactions */
+	setTransactionMetadata = (*env)->GetMethodID(env, myParametersClass, "setTransactionMetadata",
+			"(Z)Lcom/example/DebeziumRunner$MyParameters;");
+	if (setTransactionMetadata)
+	{
+		jboolean bval = pa_applyTransactions() ? JNI_TRUE : JNI_FALSE;
+		myParametersObj = (*env)->CallObjectMethod(env, myParametersObj, setTransactionMetadata, bval);
+		if (!myParametersObj)
+		{
+			elog(WARNING, "failed to call setTransactionMetadata method");
+		}
+	}
+	else
+		elog(WARNING, "failed to find setTransactionMetadata method");
+
 	jdbz_watermarking_strategy = (*env)->NewStringUTF(env, dbz_incremental_snapshot_watermarking_strategy);
 
 	setIncrementalSnapshotWatermarkingStrategy = (*env)->GetMethodID(env, myParametersClass, "setIncrementalSnapshotWatermarkingStrategy",
@@ -467,7 +586,6 @@ static void set_extra_dbz_parameters(jobject myParametersObj, jclass myParameter
 static int
 dbz_engine_stop(void)
 {
-	jmethodID stopEngine;
 	jthrowable exception;
 
 	if (!jvm)
@@ -481,15 +599,13 @@ dbz_engine_stop(void)
 		return -1;
 	}
 
-	/* Find the stopEngine method */
-	stopEngine = (*env)->GetMethodID(env, cls, "stopEngine", "()V");
-	if (stopEngine == NULL)
+	if (jni_bindings.stopEngine == NULL)
 	{
 		elog(WARNING, "Failed to find stopEngine method");
 		return -1;
 	}
 
-	(*env)->CallVoidMethod(env, obj, stopEngine);
+	(*env)->CallVoidMethod(env, obj, jni_bindings.stopEngine);
 
 	/* Check for exceptions */
 	exception = (*env)->ExceptionOccurred(env);
@@ -504,12 +620,114 @@ dbz_engine_stop(void)
 	return 0;
 }
 
+/*
+ * dbz_notify_batch_ready - Native callback invoked by Debezium runner
+ *
+ * This function is registered as the native implementation of
+ * DebeziumRunner.notifyBatchReady(). It is called from a JVM thread whenever a
+ * new batch is queued or the connector exits, and wakes up the connector worker
+ * by writing a byte to a pipe the worker waits on. Latches may only be set from
+ * the backend's own thread or another process, so they cannot be used here.
+ * Nothing but the write may be done here, including elog.
+ *
+ * @param env: JNI environment pointer of the calling JVM thread
+ * @param thisobj: the DebeziumRunner instance
+ */
+static void JNICALL
+dbz_notify_batch_ready(JNIEnv *env, jobject thisobj)
+{
+	int fd = dbz_batch_pipe[1];
+	char c = 0;
+
+	/* a full pipe already has a wakeup pending, so a failed write is harmless */
+	if (fd >= 0)
+		(void) write(fd, &c, 1);
+}
+
+/*
+ * dbz_open_batch_pipe - Create the pipe Debezium runner wakes us up with
+ *
+ * Both ends are non-blocking: the JVM thread must never block on a full pipe and
+ * the worker drains it until it is empty.
+ *
+ * @return: true on success, false otherwise
+ */
+static bool
+dbz_open_batch_pipe(void)
+{
+	int i;
+
+	if (pipe(dbz_batch_pipe) != 0)
+	{
+		dbz_batch_pipe[0] = dbz_batch_pipe[1] = -1;
+		return false;
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		if (fcntl(dbz_batch_pipe[i], F_SETFL, O_NONBLOCK) == -1 ||
+			fcntl(dbz_batch_pipe[i], F_SETFD, FD_CLOEXEC) == -1)
+		{
+			close(dbz_batch_pipe[0]);
+			close(dbz_batch_pipe[1]);
+			dbz_batch_pipe[0] = dbz_batch_pipe[1] = -1;
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * dbz_drain_batch_pipe - Consume the wakeups Debezium runner has written so far
+ */
+static void
+dbz_drain_batch_pipe(void)
+{
+	char buf[64];
+
+	while (read(dbz_batch_pipe[0], buf, sizeof(buf)) > 0)
+		;
+}
+
+/* native methods implemented by synchdb for DebeziumRunner class */
+static JNINativeMethod dbz_native_methods[] =
+{
+	{"notifyBatchReady", "()V", (void *) dbz_notify_batch_ready},
+};
+
+/*
+ * dbz_jni_get_method - Look up a method ID for the JNI binding table
+ *
+ * @param env: JNI environment pointer
+ * @param clazz: the class to look up the method from
+ * @param name: name of the method
+ * @param sig: JNI signature of the method
+ *
+ * @return: the method ID, NULL if the method cannot be found
+ */
+static jmethodID
+dbz_jni_get_method(JNIEnv *env, jclass clazz, const char * name, const char * sig)
+{
+	jmethodID method;
+
+	method = (*env)->GetMethodID(env, clazz, name, sig);
+	if (method == NULL)
+	{
+		if ((*env)->ExceptionCheck(env))
+			(*env)->ExceptionClear(env);
+		elog(WARNING, "Failed to find %s method", name);
+	}
+	return method;
+}
+
 /*
  * dbz_engine_init - Initialize the Debezium engine
  *
  * This function initializes the Debezium engine by finding the DebeziumRunner
- * class and allocating an instance of it. It handles JNI interactions and
- * exception checking.
+ * class and allocating an instance of it. It also resolves every class and
+ * method ID used later on into the JNI binding table, keeping the class and
+ * object as global references so they stay valid for the life of the worker.
+ * It handles JNI interactions and exception checking.
  *
  * @param env: JNI environment pointer
  * @param cls: Pointer to store the found Java class
@@ -520,11 +738,14 @@ dbz_engine_stop(void)
 static int
 dbz_engine_init(JNIEnv *env, jclass *cls, jobject *obj)
 {
+	jclass localClass;
+	jobject localObj;
+
 	elog(DEBUG1, "dbz_engine_init - Starting initialization");
 
 	/* Find the DebeziumRunner class */
-	*cls = (*env)->FindClass(env, "com/example/DebeziumRunner");
-	if (*cls == NULL)
+	localClass = (*env)->FindClass(env, "com/example/DebeziumRunner");
+	if (localClass == NULL)
 	{
 		if ((*env)->ExceptionCheck(env))
 		{
@@ -534,12 +755,76 @@ dbz_engine_init(JNIEnv *env, jclass *cls, jobject *obj)
 		elog(WARNING, "Failed to find com.example.DebeziumRunner class");
 		return -1;
 	}
+	*cls = (jclass) (*env)->NewGlobalRef(env, localClass);
+	(*env)->DeleteLocalRef(env, localClass);
+
+	/*
+	 * register native callbacks so Debezium runner can wake us up as soon as a
+	 * batch is ready. This is not fatal, the worker still polls every naptime.
+	 */
+	if (!dbz_open_batch_pipe())
+		elog(WARNING, "Failed to create notification pipe: %m, "
+				"falling back to polling every synchdb.naptime");
+	else if ((*env)->RegisterNatives(env, *cls, dbz_native_methods,
+			sizeof(dbz_native_methods) / sizeof(dbz_native_methods[0])) != 0)
+	{
+		if ((*env)->ExceptionCheck(env))
+		{
+			(*env)->ExceptionDescribe(env);
+			(*env)->ExceptionClear(env);
+		}
+		elog(WARNING, "Failed to register native methods for DebeziumRunner class, "
+				"falling back to polling every synchdb.naptime");
+	}
+
+	/* resolve DebeziumRunner methods */
+	jni_bindings.startEngine = dbz_jni_get_method(env, *cls, "startEngine",
+			"(Lcom/example/DebeziumRunner$MyParameters;)V");
+	jni_bindings.stopEngine = dbz_jni_get_method(env, *cls, "stopEngine", "()V");
+	jni_bindings.getChangeEvents = dbz_jni_get_method(env, *cls, "getChangeEvents",
+			"()Ljava/util/List;");
+	jni_bindings.getChangeEventsBuffer = dbz_jni_get_method(env, *cls, "getChangeEventsBuffer",
+			"()Ljava/nio/ByteBuffer;");
+	jni_bindings.markBatchComplete = dbz_jni_get_method(env, *cls, "markBatchComplete",
+			"(IZII)V");
+	jni_bindings.markBatchCompleteAsync = dbz_jni_get_method(env, *cls, "markBatchCompleteAsync",
+			"(I)V");
+	jni_bindings.getConnectorOffset = dbz_jni_get_method(env, *cls, "getConnectorOffset",
+			"(ILjava/lang/String;Ljava/lang/String;)Ljava/lang/String;");
+	jni_bindings.setConnectorOffset = dbz_jni_get_method(env, *cls, "setConnectorOffset",
+			"(Ljava/lang/String;ILjava/lang/String;Ljava/lang/String;)V");
+	jni_bindings.jvmMemDump = dbz_jni_get_method(env, *cls, "jvmMemDump", "()V");
+
+	/* resolve java.util.List methods used to walk the change event list */
+	localClass = (*env)->FindClass(env, "java/util/List");
+	if (localClass == NULL)
+	{
+		if ((*env)->ExceptionCheck(env))
+			(*env)->ExceptionClear(env);
+		elog(WARNING, "Failed to find java list class");
+		return -1;
+	}
+	jni_bindings.listClass = (jclass) (*env)->NewGlobalRef(env, localClass);
+	(*env)->DeleteLocalRef(env, localClass);
+
+	jni_bindings.listSize = dbz_jni_get_method(env, jni_bindings.listClass, "size", "()I");
+	jni_bindings.listGet = dbz_jni_get_method(env, jni_bindings.listClass, "get",
+			"(I)Ljava/lang/Object;");
+
+	/* methods needed by every transport must all be present */
+	if (!jni_bindings.startEngine || !jni_bindings.stopEngine ||
+		!jni_bindings.getChangeEvents || !jni_bindings.markBatchComplete ||
+		!jni_bindings.listSize || !jni_bindings.listGet)
+	{
+		elog(WARNING, "DebeziumRunner class does not provide all required methods");
+		return -1;
+	}
 
 	elog(DEBUG1, "dbz_engine_init - Class found, allocating object");
 
 	/* Allocate an instance of the DebeziumRunner class */
-	*obj = (*env)->AllocObject(env, *cls);
-	if (*obj == NULL)
+	localObj = (*env)->AllocObject(env, *cls);
+	if (localObj == NULL)
 	{
 		if ((*env)->ExceptionCheck(env))
 		{
@@ -549,6 +834,8 @@ dbz_engine_init(JNIEnv *env, jclass *cls, jobject *obj)
 		elog(WARNING, "Failed to allocate DBZ Runner object");
 		return -1;
 	}
+	*obj = (*env)->NewGlobalRef(env, localObj);
+	(*env)->DeleteLocalRef(env, localObj);
 
 	elog(DEBUG1, "dbz_engine_init - Object allocated successfully");
 
@@ -602,6 +889,29 @@ processCompletionMessage(const char * eventStr, int myConnectorId, bool * dbzExi
 	}
 }
 
+/*
+ * finish_snapshot_fast_load - Add the primary keys deferred by snapshot fast load
+ *
+ * This function is called when the connector starts, to add the keys an earlier
+ * run could not add, and when there is no change event to process outside of
+ * initial snapshot. The primary keys of the tables loaded in fast load mode are
+ * added in a transaction of their own, and are forgotten once it commits.
+ */
+static void
+finish_snapshot_fast_load(void)
+{
+	if (!fc_snapshotFastLoadPending())
+		return;
+
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	fc_finishSnapshotFastLoad();
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+
+	fc_clearSnapshotFastLoadFile();
+}
+
 /*
  * dbz_engine_get_change - Retrieve and process change events from the Debezium engine
  *
@@ -622,12 +932,11 @@ static int
 dbz_engine_get_change(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int myConnectorId,
 		bool * dbzExitSignal, BatchInfo * batchinfo, SynchdbStatistics * myBatchStats)
 {
-	jmethodID getChangeEvents, sizeMethod, getMethod;
 	jobject changeEventsList;
 	jint size;
-	jclass listClass;
 	jobject event;
 	const char *eventStr;
+	int ret = 0;
 
 	/* Validate input parameters */
 	if (!jvm || !env || !cls || !obj)
@@ -636,58 +945,43 @@ dbz_engine_get_change(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int m
 		return -1;
 	}
 
-	/* Get the getChangeEvents method */
-	getChangeEvents = (*env)->GetMethodID(env, *cls, "getChangeEvents", "()Ljava/util/List;");
-	if (getChangeEvents == NULL)
+	if (jni_bindings.getChangeEvents == NULL)
 	{
 		elog(WARNING, "Failed to find getChangeEvents method");
 		return -1;
 	}
 
-	/* Call getChangeEvents method */
-	changeEventsList = (*env)->CallObjectMethod(env, *obj, getChangeEvents);
-
-	if ((*env)->ExceptionCheck(env))
-	{
-		(*env)->ExceptionDescribe(env);
-		(*env)->ExceptionClear(env);
-		elog(WARNING, "Exception occurred while calling getChangeEvents");
-		return -1;
-	}
-
-	if (changeEventsList == NULL)
-	{
-		elog(WARNING, "dbz_engine_get_change: getChangeEvents returned null");
-		return -1;
-	}
-
-	/* Get List class and methods */
-	listClass = (*env)->FindClass(env, "java/util/List");
-	if (listClass == NULL)
+	/*
+	 * all local references created while handling this batch belong to this
+	 * frame and are released together by PopLocalFrame() at the end
+	 */
+	if (JNI_CALL(PushLocalFrame(env, SYNCHDB_JNI_LOCAL_FRAME_SIZE)) != 0)
 	{
-		elog(WARNING, "Failed to find java list class");
-		(*env)->DeleteLocalRef(env, changeEventsList);
+		JNI_CALL(ExceptionClear(env));
+		elog(WARNING, "dbz_engine_get_change: Failed to push JNI local frame");
 		return -1;
 	}
 
-	sizeMethod = (*env)->GetMethodID(env, listClass, "size", "()I");
-	if (sizeMethod == NULL)
+	/* Call getChangeEvents method */
+	changeEventsList = JNI_CALL(CallObjectMethod(env, *obj, jni_bindings.getChangeEvents));
+	if (JNI_CALL(ExceptionCheck(env)))
 	{
-		elog(WARNING, "Failed to find java list.size method");
-		(*env)->DeleteLocalRef(env, changeEventsList);
-		(*env)->DeleteLocalRef(env, listClass);
-		return -1;
+		JNI_CALL(ExceptionDescribe(env));
+		JNI_CALL(ExceptionClear(env));
+		elog(WARNING, "Exception occurred while calling getChangeEvents");
+		ret = -1;
+		goto end;
 	}
 
-	getMethod = (*env)->GetMethodID(env, listClass, "get", "(I)Ljava/lang/Object;");
-	if (getMethod == NULL)
+	if (changeEventsList == NULL)
 	{
-		elog(WARNING, "Failed to find java list.get method");
-		return -1;
+		elog(WARNING, "dbz_engine_get_change: getChangeEvents returned null");
+		ret = -1;
+		goto end;
 	}
 
 	/* Process change events */
-	size = (*env)->CallIntMethod(env, changeEventsList, sizeMethod);
+	size = JNI_CALL(CallIntMethod(env, changeEventsList, jni_bindings.listSize));
 	elog(DEBUG1, "dbz_engine_get_change: Retrieved %d change events", size);
 
 	if (size == 0 || size < 0)
@@ -697,29 +991,28 @@ dbz_engine_get_change(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int m
 		{
 			set_shm_connector_stage(myConnectorId, STAGE_CHANGE_DATA_CAPTURE);
 		}
-		(*env)->DeleteLocalRef(env, changeEventsList);
-		(*env)->DeleteLocalRef(env, listClass);
-		return -1;
+		/* an empty batch in the middle of a snapshot does not end it */
+		if (!fc_snapshotInProgress())
+			finish_snapshot_fast_load();
+		ret = -1;
+		goto end;
 	}
 	batchinfo->batchSize = size - 1;	/* minus the metadata record */
 
 	/* fetch special metadata element at index 0 and convert it to string */
-	event = (*env)->CallObjectMethod(env, changeEventsList, getMethod, 0);
+	event = JNI_CALL(CallObjectMethod(env, changeEventsList, jni_bindings.listGet, 0));
 	if (event == NULL)
 	{
 		elog(WARNING, "dbz_engine_get_change: missing metadata element at index 0");
-		(*env)->DeleteLocalRef(env, changeEventsList);
-		(*env)->DeleteLocalRef(env, listClass);
-		return -1;
+		ret = -1;
+		goto end;
 	}
-	eventStr = (*env)->GetStringUTFChars(env, (jstring)event, 0);
+	eventStr = JNI_CALL(GetStringUTFChars(env, (jstring)event, 0));
 	if (eventStr == NULL)
 	{
 		elog(WARNING, "dbz_engine_get_change: Failed to convert metadata element to string");
-		(*env)->DeleteLocalRef(env, event);
-		(*env)->DeleteLocalRef(env, changeEventsList);
-		(*env)->DeleteLocalRef(env, listClass);
-		return -1;
+		ret = -1;
+		goto end;
 	}
 
 	/* check if it is a completion message */
@@ -731,11 +1024,7 @@ dbz_engine_get_change(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int m
 		 * has exited and we may need to exit later as well.
 		 */
 		processCompletionMessage(eventStr, myConnectorId, dbzExitSignal);
-        (*env)->ReleaseStringUTFChars(env, (jstring)event, eventStr);
-        (*env)->DeleteLocalRef(env, event);
-        (*env)->DeleteLocalRef(env, changeEventsList);
-        (*env)->DeleteLocalRef(env, listClass);
-		return 0;
+		JNI_CALL(ReleaseStringUTFChars(env, (jstring)event, eventStr));
 	}
 	/* check if it is a batch change request */
 	else if (eventStr[0] == 'B' && eventStr[1] == '-')
@@ -748,16 +1037,17 @@ dbz_engine_get_change(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int m
 		elog(DEBUG1, "Synchdb received batchid(%d) with size(%d)", batchinfo->batchId, size-1);
 
 		/* free reference to metadata element at index 0 */
-		(*env)->ReleaseStringUTFChars(env, (jstring)event, eventStr);
-		(*env)->DeleteLocalRef(env, event);
+		JNI_CALL(ReleaseStringUTFChars(env, (jstring)event, eventStr));
+		JNI_CALL(DeleteLocalRef(env, event));
 
 		StartTransactionCommand();
 		PushActiveSnapshot(GetTransactionSnapshot());
+		ra_beginBatchApply();
 
 		/* now process the rest of the changes in the batch */
 		for (int i = 1; i < size; i++)
 		{
-			event = (*env)->CallObjectMethod(env, changeEventsList, getMethod, i);
+			event = JNI_CALL(CallObjectMethod(env, changeEventsList, jni_bindings.listGet, i));
 			if (event == NULL)
 			{
 				elog(DEBUG1, "dbz_engine_get_change: Received NULL event at index %d", i);
@@ -765,26 +1055,33 @@ dbz_engine_get_change(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int m
 				continue;
 			}
 
-			eventStr = (*env)->GetStringUTFChars(env, (jstring)event, 0);
+			eventStr = JNI_CALL(GetStringUTFChars(env, (jstring)event, 0));
 			if (eventStr == NULL)
 			{
 				elog(WARNING, "dbz_engine_get_change: Failed to get string for event at index %d", i);
-				(*env)->DeleteLocalRef(env, event);
+				JNI_CALL(DeleteLocalRef(env, event));
 				increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
 				continue;
 			}
 
 			elog(DEBUG1, "Processing DBZ Event: %s", eventStr);
-			/* change event message, send to format converter */
-			if (fc_processDBZChangeEvent(eventStr, myBatchStats) != 0)
+			/* change event message, send to format converter or an apply worker */
+			if (pa_isActive())
+				pa_dispatchEvent(eventStr, myBatchStats);
+			else if (fc_processDBZChangeEvent(eventStr, myBatchStats) != 0)
 			{
 				elog(DEBUG1, "dbz_engine_get_change: Failed to process event at index %d", i);
 			}
 
-			(*env)->ReleaseStringUTFChars(env, (jstring)event, eventStr);
-			(*env)->DeleteLocalRef(env, event);
+			/* the local frame is sized for a few references, not a whole batch */
+			JNI_CALL(ReleaseStringUTFChars(env, (jstring)event, eventStr));
+			JNI_CALL(DeleteLocalRef(env, event));
 		}
 
+		/* the batch is complete only when apply workers have committed their share */
+		pa_syncWorkers(myBatchStats);
+
+		ra_endBatchApply();
 		PopActiveSnapshot();
 		CommitTransactionCommand();
 
@@ -795,12 +1092,243 @@ dbz_engine_get_change(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int m
 	}
 	else
 	{
+		JNI_CALL(ReleaseStringUTFChars(env, (jstring)event, eventStr));
 		elog(WARNING, "unknown change request");
 	}
 
-	(*env)->DeleteLocalRef(env, changeEventsList);
-	(*env)->DeleteLocalRef(env, listClass);
-	return 0;
+end:
+	JNI_CALL(PopLocalFrame(env, NULL));
+	return ret;
+}
+
+/*
+ * dbz_buffer_next_record - Locate the next record in a change event buffer
+ *
+ * This function returns a pointer to the next length-prefixed, null-terminated
+ * record stored in the direct ByteBuffer produced by getChangeEventsBuffer()
+ * and advances the offset past it. The returned pointer points directly into
+ * the buffer; no copy is made.
+ *
+ * @param bufaddr: start address of the direct buffer
+ * @param bufsize: capacity of the direct buffer in bytes
+ * @param offset: current read offset, advanced by this function
+ * @param reclen: set to the length of the record, excluding the null byte
+ *
+ * @return: pointer to the record on success, NULL if the buffer is malformed
+ */
+static const char *
+dbz_buffer_next_record(const char * bufaddr, Size bufsize, Size * offset, Size * reclen)
+{
+	int32 len;
+	const char * record;
+
+	if (*offset + sizeof(int32) > bufsize)
+		return NULL;
+
+	/* records are not necessarily aligned, so read the length with memcpy */
+	memcpy(&len, bufaddr + *offset, sizeof(int32));
+	if (len < 0 || *offset + sizeof(int32) + len + 1 > bufsize)
+		return NULL;
+
+	record = bufaddr + *offset + sizeof(int32);
+	if (record[len] != '\0')
+		return NULL;
+
+	*offset += sizeof(int32) + len + 1;
+	*reclen = len;
+	return record;
+}
+
+/*
+ * dbz_engine_get_change_buffer - Retrieve and process change events via a direct buffer
+ *
+ * This function does the same work as dbz_engine_get_change() but obtains the
+ * entire batch as one direct ByteBuffer from getChangeEventsBuffer(). The buffer
+ * starts with an int32 record count followed by that many records, each being an
+ * int32 length, the UTF-8 bytes of the record and a terminating null byte. The
+ * first record is the metadata record. When binary change events are enabled, a
+ * record may instead hold a binary change event, recognized by its leading
+ * SYNCHDB_BINARY_EVENT_MAGIC byte. Records are walked in place with a single
+ * JNI call per batch instead of two JNI calls and a string copy per event.
+ *
+ * @param jvm: Pointer to the Java VM
+ * @param env: Pointer to the JNI environment
+ * @param cls: Pointer to the DebeziumRunner class
+ * @param obj: Pointer to the DebeziumRunner object
+ * @param myConnectorId: The connector ID of interest
+ * @param dbzExitSignal: Set by this function to indicate the connector has exited
+ * @param batchinfo: Set by this function to indicate a valid batch is in progress
+ * @param myBatchStats: update connector statistics to this struct
+ *
+ * @return: 0 on success, -1 on failure
+ */
+static int
+dbz_engine_get_change_buffer(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int myConnectorId,
+		bool * dbzExitSignal, BatchInfo * batchinfo, SynchdbStatistics * myBatchStats)
+{
+	jobject changeEventsBuffer;
+	const char * bufaddr;
+	jlong bufsize;
+	int32 count;
+	Size offset = 0;
+	const char * eventStr;
+	Size eventLen = 0;
+	int ret = 0;
+
+	/* Validate input parameters */
+	if (!jvm || !env || !cls || !obj)
+	{
+		elog(WARNING, "dbz_engine_get_change_buffer: Invalid input parameters");
+		return -1;
+	}
+
+	if (jni_bindings.getChangeEventsBuffer == NULL)
+	{
+		elog(WARNING, "Failed to find getChangeEventsBuffer method");
+		return -1;
+	}
+
+	if (JNI_CALL(PushLocalFrame(env, SYNCHDB_JNI_LOCAL_FRAME_SIZE)) != 0)
+	{
+		JNI_CALL(ExceptionClear(env));
+		elog(WARNING, "dbz_engine_get_change_buffer: Failed to push JNI local frame");
+		return -1;
+	}
+
+	/* Call getChangeEventsBuffer method */
+	changeEventsBuffer = JNI_CALL(CallObjectMethod(env, *obj, jni_bindings.getChangeEventsBuffer));
+	if (JNI_CALL(ExceptionCheck(env)))
+	{
+		JNI_CALL(ExceptionDescribe(env));
+		JNI_CALL(ExceptionClear(env));
+		elog(WARNING, "Exception occurred while calling getChangeEventsBuffer");
+		ret = -1;
+		goto end;
+	}
+
+	if (changeEventsBuffer == NULL)
+	{
+		elog(WARNING, "dbz_engine_get_change_buffer: getChangeEventsBuffer returned null");
+		ret = -1;
+		goto end;
+	}
+
+	bufaddr = (const char *) JNI_CALL(GetDirectBufferAddress(env, changeEventsBuffer));
+	bufsize = JNI_CALL(GetDirectBufferCapacity(env, changeEventsBuffer));
+	if (bufaddr == NULL || bufsize < (jlong) sizeof(int32))
+	{
+		elog(WARNING, "dbz_engine_get_change_buffer: change event buffer is not a valid direct buffer");
+		ret = -1;
+		goto end;
+	}
+
+	memcpy(&count, bufaddr, sizeof(int32));
+	offset = sizeof(int32);
+	elog(DEBUG1, "dbz_engine_get_change_buffer: Retrieved %d change events", count);
+
+	if (count <= 0)
+	{
+		/* nothing to process, set current stage to CDC and return */
+		if (get_shm_connector_stage_enum(myConnectorId) != STAGE_CHANGE_DATA_CAPTURE)
+		{
+			set_shm_connector_stage(myConnectorId, STAGE_CHANGE_DATA_CAPTURE);
+		}
+		/* an empty batch in the middle of a snapshot does not end it */
+		if (!fc_snapshotInProgress())
+			finish_snapshot_fast_load();
+		ret = -1;
+		goto end;
+	}
+	batchinfo->batchSize = count - 1;	/* minus the metadata record */
+
+	/* fetch special metadata record */
+	eventStr = dbz_buffer_next_record(bufaddr, bufsize, &offset, &eventLen);
+	if (eventStr == NULL)
+	{
+		elog(WARNING, "dbz_engine_get_change_buffer: malformed metadata record");
+		ret = -1;
+		goto end;
+	}
+
+	/* check if it is a completion message */
+	if (eventStr[0] == 'K' && eventStr[1] == '-')
+	{
+		processCompletionMessage(eventStr, myConnectorId, dbzExitSignal);
+	}
+	/* check if it is a batch change request */
+	else if (eventStr[0] == 'B' && eventStr[1] == '-')
+	{
+		batchinfo->batchId = atoi(&eventStr[2]);
+		elog(DEBUG1, "Synchdb received batchid(%d) with size(%d)", batchinfo->batchId, count - 1);
+
+		StartTransactionCommand();
+		PushActiveSnapshot(GetTransactionSnapshot());
+		ra_beginBatchApply();
+
+		/* now process the rest of the changes in the batch */
+		for (int i = 1; i < count; i++)
+		{
+			eventStr = dbz_buffer_next_record(bufaddr, bufsize, &offset, &eventLen);
+			if (eventStr == NULL)
+			{
+				/* cannot locate the remaining records once the layout is broken */
+				elog(WARNING, "dbz_engine_get_change_buffer: malformed event at index %d", i);
+				increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, count - i);
+				break;
+			}
+
+			/* a null change event is sent as an empty record */
+			if (eventStr[0] == '\0')
+			{
+				elog(DEBUG1, "dbz_engine_get_change_buffer: Received NULL event at index %d", i);
+				increment_connector_statistics(myBatchStats, STATS_BAD_CHANGE_EVENT, 1);
+				continue;
+			}
+
+			/* change event message, send to format converter */
+			if ((unsigned char) eventStr[0] == SYNCHDB_BINARY_EVENT_MAGIC)
+			{
+				elog(DEBUG1, "Processing binary DBZ Event of %zu bytes", eventLen);
+				if (fc_processDBZBinaryChangeEvent(eventStr, eventLen, myBatchStats) != 0)
+				{
+					elog(DEBUG1, "dbz_engine_get_change_buffer: Failed to process event at index %d", i);
+				}
+			}
+			else if (pa_isActive())
+			{
+				elog(DEBUG1, "Dispatching DBZ Event: %s", eventStr);
+				pa_dispatchEvent(eventStr, myBatchStats);
+			}
+			else
+			{
+				elog(DEBUG1, "Processing DBZ Event: %s", eventStr);
+				if (fc_processDBZChangeEvent(eventStr, myBatchStats) != 0)
+				{
+					elog(DEBUG1, "dbz_engine_get_change_buffer: Failed to process event at index %d", i);
+				}
+			}
+		}
+
+		/* the batch is complete only when apply workers have committed their share */
+		pa_syncWorkers(myBatchStats);
+
+		ra_endBatchApply();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+
+		increment_connector_statistics(myBatchStats, STATS_TOTAL_CHANGE_EVENT, count - 1);
+
+		/* read offset currently flushed to file for displaying to user */
+		set_shm_dbz_offset(myConnectorId);
+	}
+	else
+	{
+		elog(WARNING, "unknown change request");
+	}
+
+end:
+	JNI_CALL(PopLocalFrame(env, NULL));
+	return ret;
 }
 
 /*
@@ -817,7 +1345,7 @@ dbz_engine_get_change(JavaVM *jvm, JNIEnv *env, jclass *cls, jobject *obj, int m
 static int
 dbz_engine_start(const ConnectionInfo *connInfo, ConnectorType connectorType, const char * snapshotMode)
 {
-	jmethodID mid, paramConstruct;
+	jmethodID paramConstruct;
 	jstring jHostname, jUser, jPassword, jDatabase, jTable, jName, jSnapshot;
 	jthrowable exception;
 	jclass myParametersClass;
@@ -873,16 +1401,14 @@ dbz_engine_start(const ConnectionInfo *connInfo, ConnectorType connectorType, co
 	/* set extra parameters */
 	set_extra_dbz_parameters(myParametersObj, myParametersClass);
 
-	/* Find the startEngine method */
-	mid = (*env)->GetMethodID(env, cls, "startEngine", "(Lcom/example/DebeziumRunner$MyParameters;)V");
-	if (mid == NULL)
+	if (jni_bindings.startEngine == NULL)
 	{
 		elog(WARNING, "Failed to find startEngine method");
 		return -1;
 	}
 
 	/* Call the Java method */
-	(*env)->CallVoidMethod(env, obj, mid, myParametersObj);
+	(*env)->CallVoidMethod(env, obj, jni_bindings.startEngine, myParametersObj);
 
 	/* Check for exceptions */
 	exception = (*env)->ExceptionOccurred(env);
@@ -929,7 +1455,6 @@ cleanup:
 static char *
 dbz_engine_get_offset(int connectorId)
 {
-	jmethodID getoffsets;
 	jstring jdb, result, jName;
 	char *resultStr = NULL;
 	char *db = NULL, *name = NULL;
@@ -966,43 +1491,41 @@ dbz_engine_get_offset(int connectorId)
 		return NULL;
 	}
 
-	getoffsets = (*env)->GetMethodID(env, cls, "getConnectorOffset",
-									 "(ILjava/lang/String;Ljava/lang/String;)Ljava/lang/String;");
-	if (getoffsets == NULL)
+	if (jni_bindings.getConnectorOffset == NULL)
 	{
 		elog(WARNING, "Failed to find getConnectorOffset method");
 		return NULL;
 	}
 
-	jdb = (*env)->NewStringUTF(env, db);
-	jName = (*env)->NewStringUTF(env, name);
+	jdb = JNI_CALL(NewStringUTF(env, db));
+	jName = JNI_CALL(NewStringUTF(env, name));
 
-	result = (jstring)(*env)->CallObjectMethod(env, obj, getoffsets,
-			(int)sdb_state->connectors[connectorId].type, jdb, jName);
+	result = (jstring) JNI_CALL(CallObjectMethod(env, obj, jni_bindings.getConnectorOffset,
+			(int)sdb_state->connectors[connectorId].type, jdb, jName));
 	/* Check for exceptions */
-	exception = (*env)->ExceptionOccurred(env);
+	exception = JNI_CALL(ExceptionOccurred(env));
 	if (exception)
 	{
-		(*env)->ExceptionDescribe(env);
-		(*env)->ExceptionClear(env);
+		JNI_CALL(ExceptionDescribe(env));
+		JNI_CALL(ExceptionClear(env));
 		elog(WARNING, "Exception occurred while getting connector offset");
-		(*env)->DeleteLocalRef(env, jdb);
-		(*env)->DeleteLocalRef(env, jName);
+		JNI_CALL(DeleteLocalRef(env, jdb));
+		JNI_CALL(DeleteLocalRef(env, jName));
 		return NULL;
 	}
 
 	/* Convert Java string to C string */
-	tmp = (*env)->GetStringUTFChars(env, result, NULL);
+	tmp = JNI_CALL(GetStringUTFChars(env, result, NULL));
 	if (tmp && strlen(tmp) > 0)
 		resultStr = pstrdup(tmp);
 	else
 		resultStr = pstrdup("no offset");
 
 	/* Clean up */
-	(*env)->ReleaseStringUTFChars(env, result, tmp);
-	(*env)->DeleteLocalRef(env, jdb);
-	(*env)->DeleteLocalRef(env, result);
-	(*env)->DeleteLocalRef(env, jName);
+	JNI_CALL(ReleaseStringUTFChars(env, result, tmp));
+	JNI_CALL(DeleteLocalRef(env, jdb));
+	JNI_CALL(DeleteLocalRef(env, result));
+	JNI_CALL(DeleteLocalRef(env, jName));
 
 	elog(DEBUG1, "Retrieved offset for %s connector: %s",
 			connectorTypeToString(sdb_state->connectors[connectorId].type), resultStr);
@@ -1019,8 +1542,6 @@ dbz_engine_get_offset(int connectorId)
 static void
 dbz_engine_memory_dump(void)
 {
-	jmethodID jvmMemDump;
-
 	if (!jvm)
 	{
 		elog(WARNING, "jvm not initialized");
@@ -1033,14 +1554,13 @@ dbz_engine_memory_dump(void)
 		return;
 	}
 
-	jvmMemDump = (*env)->GetMethodID(env, cls, "jvmMemDump", "()V");
-	if (jvmMemDump == NULL)
+	if (jni_bindings.jvmMemDump == NULL)
 	{
 		elog(WARNING, "Failed to find jvmMemDump method");
 		return;
 	}
 
-	(*env)->CallVoidMethod(env, obj, jvmMemDump);
+	(*env)->CallVoidMethod(env, obj, jni_bindings.jvmMemDump);
 }
 
 /*
@@ -1087,7 +1607,7 @@ static TupleDesc
 synchdb_stats_tupdesc(void)
 {
 	TupleDesc tupdesc;
-	AttrNumber attrnum = 11;
+	AttrNumber attrnum = 12;
 	AttrNumber a = 0;
 
 	tupdesc = CreateTemplateTupleDesc(attrnum);
@@ -1104,6 +1624,7 @@ synchdb_stats_tupdesc(void)
 	TupleDescInitEntry(tupdesc, ++a, "total_events", INT8OID, -1, 0);
 	TupleDescInitEntry(tupdesc, ++a, "batches_done", INT8OID, -1, 0);
 	TupleDescInitEntry(tupdesc, ++a, "average_batch_size", INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, ++a, "jni_calls", INT8OID, -1, 0);
 
 	Assert(a == maxattr);
 	return BlessTupleDesc(tupdesc);
@@ -1115,7 +1636,7 @@ synchdb_stats_tupdesc(void)
  * Allocate and initialize synchdb related shared memory, if not already
  * done, and set up backend-local pointer to that state.
  */
-static void
+void
 synchdb_init_shmem(void)
 {
 	bool found;
@@ -1292,7 +1813,6 @@ reset_shm_request_state(int connectorId)
 static int
 dbz_engine_set_offset(ConnectorType connectorType, char *db, char *offset, char *file)
 {
-	jmethodID setoffsets;
 	jstring joffsetstr, jdb, jfile;
 	jthrowable exception;
 
@@ -1308,10 +1828,7 @@ dbz_engine_set_offset(ConnectorType connectorType, char *db, char *offset, char
 		return -1;
 	}
 
-	/* Find the setConnectorOffset method */
-	setoffsets = (*env)->GetMethodID(env, cls, "setConnectorOffset",
-									 "(Ljava/lang/String;ILjava/lang/String;Ljava/lang/String;)V");
-	if (setoffsets == NULL)
+	if (jni_bindings.setConnectorOffset == NULL)
 	{
 		elog(WARNING, "Failed to find setConnectorOffset method");
 		return -1;
@@ -1323,7 +1840,7 @@ dbz_engine_set_offset(ConnectorType connectorType, char *db, char *offset, char
 	jfile = (*env)->NewStringUTF(env, file);
 
 	/* Call the Java method */
-	(*env)->CallVoidMethod(env, obj, setoffsets, jfile, (int)connectorType, jdb, joffsetstr);
+	(*env)->CallVoidMethod(env, obj, jni_bindings.setConnectorOffset, jfile, (int)connectorType, jdb, joffsetstr);
 
 	/* Check for exceptions */
 	exception = (*env)->ExceptionOccurred(env);
@@ -1715,10 +2232,25 @@ main_loop(ConnectorType connectorType, const ConnectionInfo *connInfo, const cha
 	bool dbzExitSignal = false;
 	BatchInfo myBatchInfo = {0};
 	SynchdbStatistics myBatchStats = {0};
+	bool batchProcessed;
+	WaitEventSet *waitset;
+	WaitEvent event;
+
+	/*
+	 * wait on our latch for signals from other processes and on the notification
+	 * pipe for wakeups from Debezium runner's threads
+	 */
+	waitset = CreateWaitEventSet(TopMemoryContext, 3);
+	AddWaitEventToSet(waitset, WL_LATCH_SET, PGINVALID_SOCKET, MyLatch, NULL);
+	AddWaitEventToSet(waitset, WL_EXIT_ON_PM_DEATH, PGINVALID_SOCKET, NULL, NULL);
+	if (dbz_batch_pipe[0] >= 0)
+		AddWaitEventToSet(waitset, WL_SOCKET_READABLE, dbz_batch_pipe[0], NULL, NULL);
 
 	elog(LOG, "Main LOOP ENTER ");
 	while (!ShutdownRequestPending)
 	{
+		batchProcessed = false;
+
 		if (ConfigReloadPending)
 		{
 			ConfigReloadPending = false;
@@ -1742,8 +2274,13 @@ main_loop(ConnectorType connectorType, const ConnectionInfo *connInfo, const cha
 				myBatchInfo.batchId = SYNCHDB_INVALID_BATCH_ID;
 				myBatchInfo.batchSize = 0;
 				memset(&myBatchStats, 0, sizeof(myBatchStats));
+				jniCallCount = 0;
 
-				dbz_engine_get_change(jvm, env, &cls, &obj, myConnectorId, &dbzExitSignal, &myBatchInfo, &myBatchStats);
+				/* pipelined batches and binary change events always come in direct buffers */
+				if (synchdb_jni_use_direct_buffer || dbz_pipeline_batches || dbz_binary_change_events)
+					dbz_engine_get_change_buffer(jvm, env, &cls, &obj, myConnectorId, &dbzExitSignal, &myBatchInfo, &myBatchStats);
+				else
+					dbz_engine_get_change(jvm, env, &cls, &obj, myConnectorId, &dbzExitSignal, &myBatchInfo, &myBatchStats);
 
 				/*
 				 * if a valid batchid is set by dbz_engine_get_change(), it means we have
@@ -1756,9 +2293,11 @@ main_loop(ConnectorType connectorType, const ConnectionInfo *connInfo, const cha
 
 					/* increment batch connector statistics */
 					increment_connector_statistics(&myBatchStats, STATS_BATCH_COMPLETION, 1);
+					increment_connector_statistics(&myBatchStats, STATS_JNI_CALLS, jniCallCount);
 
 					/* update the batch statistics to shared memory */
 					set_shm_connector_statistics(myConnectorId, &myBatchStats);
+					batchProcessed = true;
 				}
 				break;
 			}
@@ -1772,13 +2311,28 @@ main_loop(ConnectorType connectorType, const ConnectionInfo *connInfo, const cha
 				break;
 		}
 
-		(void)WaitLatch(MyLatch,
-						WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
-						synchdb_worker_naptime,
-						PG_WAIT_EXTENSION);
+		/*
+		 * more batches may already be queued behind the one just processed, so
+		 * only sleep when there was nothing to do. Debezium runner writes to the
+		 * notification pipe when a new batch is queued, so naptime is merely a
+		 * safety timeout. Under sustained load we never wait, so check for
+		 * postmaster death here as WaitEventSetWait() would.
+		 */
+		if (batchProcessed)
+		{
+			if (!PostmasterIsAlive())
+				proc_exit(1);
+			continue;
+		}
+
+		(void) WaitEventSetWait(waitset, synchdb_worker_naptime, &event, 1,
+								PG_WAIT_EXTENSION);
 
 		ResetLatch(MyLatch);
+		if (dbz_batch_pipe[0] >= 0)
+			dbz_drain_batch_pipe();
 	}
+	FreeWaitEventSet(waitset);
 	elog(LOG, "Main LOOP QUIT");
 }
 
@@ -1803,6 +2357,12 @@ cleanup(ConnectorType connectorType)
 		elog(DEBUG1, "Failed to call dbz engine stop method");
 	}
 
+	/*
+	 * the notification pipe is left open until the worker exits since JVM
+	 * threads may still write to it until the JVM is destroyed
+	 */
+	memset(&jni_bindings, 0, sizeof(jni_bindings));
+
 	if (jvm != NULL)
 	{
 		(*jvm)->DestroyJavaVM(jvm);
@@ -1901,7 +2461,6 @@ get_shm_connector_id_by_name(const char * name)
 static int
 dbz_mark_batch_complete(int batchid)
 {
-	jmethodID markBatchComplete;
 	jthrowable exception;
 	jboolean jmarkall = JNI_TRUE;
 
@@ -1921,24 +2480,38 @@ dbz_mark_batch_complete(int batchid)
 		return -1;
 	}
 
-	/* Find the markBatchComplete method */
-	markBatchComplete = (*env)->GetMethodID(env, cls, "markBatchComplete",
-									 "(IZII)V");
-	if (markBatchComplete == NULL)
+	if (dbz_pipeline_batches)
 	{
-		elog(WARNING, "Failed to find markBatchComplete method");
-		return -1;
+		/*
+		 * post the completion and return right away. Debezium runner commits
+		 * offsets in its own thread while we move on to the next batch.
+		 */
+		if (jni_bindings.markBatchCompleteAsync == NULL)
+		{
+			elog(WARNING, "Failed to find markBatchCompleteAsync method");
+			return -1;
+		}
+
+		JNI_CALL(CallVoidMethod(env, obj, jni_bindings.markBatchCompleteAsync, batchid));
 	}
+	else
+	{
+		if (jni_bindings.markBatchComplete == NULL)
+		{
+			elog(WARNING, "Failed to find markBatchComplete method");
+			return -1;
+		}
 
-	/* Call the Java method */
-	(*env)->CallVoidMethod(env, obj, markBatchComplete, batchid, jmarkall, -1, -1);
+		/* Call the Java method */
+		JNI_CALL(CallVoidMethod(env, obj, jni_bindings.markBatchComplete, batchid, jmarkall, -1, -1));
+	}
 
 	/* Check for exceptions */
-	exception = (*env)->ExceptionOccurred(env);
+	exception = JNI_CALL(ExceptionOccurred(env));
 	if (exception)
 	{
-		(*env)->ExceptionDescribe(env);
-		(*env)->ExceptionClear(env);
+		JNI_CALL(ExceptionDescribe(env));
+		JNI_CALL(ExceptionClear(env));
 		elog(WARNING, "Exception occurred while calling markBatchComplete");
 		return -1;
 	}
@@ -2144,7 +2717,7 @@ get_shm_connector_errmsg(int connectorId)
 void
 set_shm_connector_errmsg(int connectorId, const char *err)
 {
-	if (!sdb_state)
+	if (!sdb_state || connectorId < 0)
 		return;
 
 	LWLockAcquire(&sdb_state->lock, LW_EXCLUSIVE);
@@ -2229,6 +2802,8 @@ set_shm_connector_statistics(int connectorId, SynchdbStatistics * stats)
 			stats->stats_total_change_event;
 	sdb_state->connectors[connectorId].stats.stats_batch_completion +=
 			stats->stats_batch_completion;
+	sdb_state->connectors[connectorId].stats.stats_jni_calls +=
+			stats->stats_jni_calls;
 	LWLockRelease(&sdb_state->lock);
 }
 
@@ -2238,9 +2813,10 @@ set_shm_connector_statistics(int connectorId, SynchdbStatistics * stats)
  * This function increments statistic counter for specified type
  *
  * @param which: type of statistic to increment
+ * @param incby: amount to add, as wide as the counters themselves
  */
 void
-increment_connector_statistics(SynchdbStatistics * myStats, ConnectorStatistics which, int incby)
+increment_connector_statistics(SynchdbStatistics * myStats, ConnectorStatistics which, unsigned long long incby)
 {
 	if (!myStats)
 		return;
@@ -2274,6 +2850,9 @@ increment_connector_statistics(SynchdbStatistics * myStats, ConnectorStatistics
 		case STATS_BATCH_COMPLETION:
 			myStats->stats_batch_completion += incby;
 			break;
+		case STATS_JNI_CALLS:
+			myStats->stats_jni_calls += incby;
+			break;
 		default:
 			break;
 	}
@@ -2294,7 +2873,7 @@ get_shm_connector_stage_enum(int connectorId)
 {
 	ConnectorStage stage;
 
-	if (!sdb_state)
+	if (!sdb_state || connectorId < 0)
 		return STATE_UNDEF;
 
 	/*
@@ -2319,7 +2898,7 @@ get_shm_connector_stage_enum(int connectorId)
 void
 set_shm_connector_stage(int connectorId, ConnectorStage stage)
 {
-	if (!sdb_state)
+	if (!sdb_state || connectorId < 0)
 		return;
 
 	LWLockAcquire(&sdb_state->lock, LW_EXCLUSIVE);
@@ -2400,7 +2979,8 @@ get_shm_connector_state_enum(int connectorId)
 void
 set_shm_connector_state(int connectorId, ConnectorState state)
 {
-	if (!sdb_state)
+	/* the connector state is owned by the connector worker */
+	if (!sdb_state || connectorId < 0 || am_parallel_apply_worker)
 		return;
 
 	LWLockAcquire(&sdb_state->lock, LW_EXCLUSIVE);
@@ -2482,6 +3062,126 @@ _PG_init(void)
 							 0,
 							 NULL, NULL, NULL);
 
+	DefineCustomBoolVariable("synchdb.dml_use_streaming_parser",
+							 "option to parse DML change events in a single pass with a streaming JSON "
+							 "parser instead of converting them to jsonb first. Default false",
+							 NULL,
+							 &synchdb_dml_use_streaming_parser,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("synchdb.jni_use_direct_buffer",
+							 "option to receive each change event batch from Debezium as a single direct buffer "
+							 "instead of a list of strings. Default false",
+							 NULL,
+							 &synchdb_jni_use_direct_buffer,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("synchdb.jni_pipeline_batches",
+							 "option to let Debezium prepare the next batch in the background while the "
+							 "current one is being applied, and to acknowledge completed batches asynchronously. "
+							 "Batches are then always received as direct buffers. Takes effect when a connector "
+							 "starts. Default false",
+							 NULL,
+							 &synchdb_jni_pipeline_batches,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("synchdb.jni_binary_change_events",
+							 "option to let Debezium send DML change events in a compact binary format "
+							 "instead of JSON, with the schema of a table sent only once per table version. "
+							 "Batches are then always received as direct buffers. Takes effect when a connector "
+							 "starts. Default false",
+							 NULL,
+							 &synchdb_jni_binary_change_events,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("synchdb.snapshot_fast_load",
+							 "option to create tables during initial snapshot without their primary keys, "
+							 "which are then added once the snapshot ends or when the connector restarts. "
+							 "Snapshot rows applied in the same batch that creates their table are inserted "
+							 "frozen. Default false",
+							 NULL,
+							 &synchdb_snapshot_fast_load,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("synchdb.dml_batch_compaction",
+							 "option to collapse the changes made to a row within a batch into their "
+							 "net change before applying them, so a row inserted and then updated is "
+							 "inserted once and a row inserted and then deleted is not applied at all. "
+							 "Only tables with a primary key or replica identity and no other unique "
+							 "index or foreign key are compacted, and only when synchdb.dml_use_spi is off. The deletes of a table left after "
+							 "compaction are applied with one index scan. Default false",
+							 NULL,
+							 &synchdb_dml_batch_compaction,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("synchdb.dml_upsert",
+							 "option to apply inserts into tables with a primary key or replica "
+							 "identity as insert or update on conflict, so change events replayed "
+							 "after a restart update the existing rows instead of failing with a "
+							 "unique violation. Only applies when synchdb.dml_use_spi is off. "
+							 "Default false",
+							 NULL,
+							 &synchdb_dml_upsert,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("synchdb.batch_transform_expressions",
+							 "option to evaluate the data transform expressions of a batch together, "
+							 "with one query per expression over all the values that need it, instead "
+							 "of one query per value. Changes are applied in order once their values "
+							 "are transformed. Only applies when synchdb.dml_use_spi is off. Default false",
+							 NULL,
+							 &synchdb_batch_transform_expressions,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomIntVariable("synchdb.parallel_apply_workers",
+							"number of apply workers a connector dispatches change events to by "
+							"table and primary key. Takes effect when a connector starts and requires "
+							"synchdb.dml_upsert. Default 0, change events are applied by the connector worker",
+							NULL,
+							&synchdb_parallel_apply_workers,
+							0,
+							0,
+							SYNCHDB_PARALLEL_APPLY_MAX_WORKERS,
+							PGC_SIGHUP,
+							0,
+							NULL, NULL, NULL);
+
+	DefineCustomBoolVariable("synchdb.parallel_apply_transactions",
+							 "option to have apply workers apply change events in source transactions, "
+							 "using Debezium's transaction metadata. Transactions that do not change the "
+							 "same rows are applied concurrently. Requires synchdb.parallel_apply_workers. "
+							 "Takes effect when a connector starts. Default false",
+							 NULL,
+							 &synchdb_parallel_apply_transactions,
+							 false,
+							 PGC_SIGHUP,
+							 0,
+							 NULL, NULL, NULL);
+
 	DefineCustomIntVariable("synchdb.dbz_batch_size",
 							"the maximum number of change events in a batch",
 							NULL,
@@ -2717,6 +3417,14 @@ synchdb_engine_main(Datum main_arg)
 	if (connInfo.rulefile && strlen(connInfo.rulefile) > 0 && strcasecmp(connInfo.rulefile, "null"))
 		fc_load_rules(connectorType, connInfo.rulefile);
 
+	/*
+	 * primary keys deferred by an earlier run in snapshot fast load mode are added
+	 * now, whether that snapshot ended or is about to start over, so rows sent
+	 * again are caught by the key
+	 */
+	fc_loadSnapshotFastLoad(connectorType, connInfo.name);
+	finish_snapshot_fast_load();
+
 	/* Initialize JVM */
 	initialize_jvm();
 
@@ -2724,6 +3432,9 @@ synchdb_engine_main(Datum main_arg)
 	memset(sdb_state->connectors[myConnectorId].dbzoffset, 0, SYNCHDB_ERRMSG_SIZE);
 	set_shm_dbz_offset(myConnectorId);
 
+	/* start apply workers, if requested, before Debezium sends anything */
+	pa_startWorkers(synchdb_parallel_apply_workers, connectorType, &connInfo);
+
 	/* start Debezium engine */
 	start_debezium_engine(connectorType, &connInfo, snapshotMode);
 
@@ -2731,6 +3442,8 @@ synchdb_engine_main(Datum main_arg)
 	/* Main processing loop */
 	main_loop(connectorType, &connInfo, snapshotMode);
 
+	pa_stopWorkers();
+
 	elog(LOG, "synchdb worker shutting down .... ");
 	if (snapshotMode)
 		pfree(snapshotMode);
@@ -3099,8 +3812,8 @@ synchdb_get_stats(PG_FUNCTION_ARGS)
 
 	if (*idx < count_active_connectors())
 	{
-		Datum values[11];
-		bool nulls[11] = {0};
+		Datum values[12];
+		bool nulls[12] = {0};
 		HeapTuple tuple;
 
 		LWLockAcquire(&sdb_state->lock, LW_SHARED);
@@ -3118,6 +3831,7 @@ synchdb_get_stats(PG_FUNCTION_ARGS)
 					Int64GetDatum(sdb_state->connectors[*idx].stats.stats_total_change_event /
 							sdb_state->connectors[*idx].stats.stats_batch_completion) :
 					Int64GetDatum(0);
+		values[11] = Int64GetDatum(sdb_state->connectors[*idx].stats.stats_jni_calls);
 		LWLockRelease(&sdb_state->lock);
 
 		*idx += 1;
@@ -3653,3 +4367,228 @@ synchdb_log_jvm_meminfo(PG_FUNCTION_ARGS)
 			text_to_cstring(name_text), connectorId);
 	PG_RETURN_INT32(0);
 }
+
+/*
+ * test_row_to_colvals
+ *
+ * helper function to turn a row of the given table, written as a row literal
+ * such as '(1,foo)', into a list of PG_DML_COLUMN_VALUE as they are made from
+ * a change event, with every column value expressed as string
+ */
+static List *
+test_row_to_colvals(Relation rel, const char * row)
+{
+	TupleDesc tupdesc = RelationGetDescr(rel);
+	HeapTupleHeader rec;
+	HeapTupleData tuple;
+	Datum * values;
+	bool * nulls;
+	List * colvals = NIL;
+	int i;
+
+	rec = DatumGetHeapTupleHeader(OidInputFunctionCall(F_RECORD_IN, (char *) row,
+													   rel->rd_rel->reltype, -1));
+	tuple.t_len = HeapTupleHeaderGetDatumLength(rec);
+	ItemPointerSetInvalid(&(tuple.t_self));
+	tuple.t_tableOid = InvalidOid;
+	tuple.t_data = rec;
+
+	values = (Datum *) palloc(sizeof(Datum) * tupdesc->natts);
+	nulls = (bool *) palloc(sizeof(bool) * tupdesc->natts);
+	heap_deform_tuple(&tuple, tupdesc, values, nulls);
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+		PG_DML_COLUMN_VALUE * colval;
+		Oid typoutput;
+		bool typisvarlena;
+
+		if (attr->attisdropped)
+			continue;
+
+		colval = (PG_DML_COLUMN_VALUE *) palloc0(sizeof(PG_DML_COLUMN_VALUE));
+		if (nulls[i])
+			colval->value = pstrdup("NULL");
+		else
+		{
+			getTypeOutputInfo(attr->atttypid, &typoutput, &typisvarlena);
+			colval->value = OidOutputFunctionCall(typoutput, values[i]);
+		}
+		colval->datatype = attr->atttypid;
+		colval->position = attr->attnum;
+		colvals = lappend(colvals, colval);
+	}
+	return colvals;
+}
+
+/*
+ * synchdb_apply_test_batch
+ *
+ * This function applies a batch of changes to a table the same way a connector
+ * applies the changes of a batch of events, for regression tests. Each change
+ * is given by its op ('c', 'u' or 'd') and its before and after images written
+ * as row literals of the table. synchdb.dml_upsert and synchdb.dml_batch_compaction
+ * are taken from the arguments for the duration of the batch.
+ *
+ * @return: the number of changes that failed to apply
+ */
+Datum
+synchdb_apply_test_batch(PG_FUNCTION_ARGS)
+{
+	Oid tableoid = PG_GETARG_OID(0);
+	ArrayType * ops = PG_GETARG_ARRAYTYPE_P(1);
+	ArrayType * befores = PG_GETARG_ARRAYTYPE_P(2);
+	ArrayType * afters = PG_GETARG_ARRAYTYPE_P(3);
+	bool upsert = PG_GETARG_BOOL(4);
+	bool compaction = PG_GETARG_BOOL(5);
+	bool saveupsert = synchdb_dml_upsert;
+	bool savecompaction = synchdb_dml_batch_compaction;
+	bool savespi = synchdb_dml_use_spi;
+	SynchdbStatistics stats = {0};
+	Datum * opvals, * beforevals, * aftervals;
+	bool * opnulls, * beforenulls, * afternulls;
+	int nops, nbefores, nafters, i;
+	Relation rel;
+
+	deconstruct_array_builtin(ops, TEXTOID, &opvals, &opnulls, &nops);
+	deconstruct_array_builtin(befores, TEXTOID, &beforevals, &beforenulls, &nbefores);
+	deconstruct_array_builtin(afters, TEXTOID, &aftervals, &afternulls, &nafters);
+	if (nbefores != nops || nafters != nops)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("every change needs an op, a before and an after image")));
+
+	rel = table_open(tableoid, RowExclusiveLock);
+
+	synchdb_dml_upsert = upsert;
+	synchdb_dml_batch_compaction = compaction;
+	synchdb_dml_use_spi = false;
+	PG_TRY();
+	{
+		ra_beginBatchApply();
+		for (i = 0; i < nops; i++)
+		{
+			PG_DML * pgdml = (PG_DML *) palloc0(sizeof(PG_DML));
+
+			if (opnulls[i])
+				ereport(ERROR,
+						(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+						 errmsg("op of change %d is null", i + 1)));
+
+			pgdml->op = TextDatumGetCString(opvals[i])[0];
+			pgdml->tableoid = tableoid;
+			if (!beforenulls[i])
+				pgdml->columnValuesBefore = test_row_to_colvals(rel,
+						TextDatumGetCString(beforevals[i]));
+			if (!afternulls[i])
+				pgdml->columnValuesAfter = test_row_to_colvals(rel,
+						TextDatumGetCString(aftervals[i]));
+
+			if (ra_executePGDML(pgdml, TYPE_MYSQL, &stats))
+				increment_connector_statistics(&stats, STATS_BAD_CHANGE_EVENT, 1);
+		}
+		ra_endBatchApply();
+	}
+	PG_FINALLY();
+	{
+		synchdb_dml_upsert = saveupsert;
+		synchdb_dml_batch_compaction = savecompaction;
+		synchdb_dml_use_spi = savespi;
+	}
+	PG_END_TRY();
+
+	table_close(rel, NoLock);
+	PG_RETURN_INT64((int64) stats.stats_bad_change_event);
+}
+
+/*
+ * synchdb_decode_decimal
+ *
+ * This function decodes the big-endian two's complement unscaled value of a
+ * decimal column the same way as the format converter does for change events,
+ * for regression tests. The value is returned both as text and as a numeric of
+ * the given type, whose typmod is applied.
+ *
+ * @return: the decoded value as text and as numeric
+ */
+Datum
+synchdb_decode_decimal(PG_FUNCTION_ARGS)
+{
+	bytea * unscaled = PG_GETARG_BYTEA_PP(0);
+	int32 scale = PG_GETARG_INT32(1);
+	char * typname = text_to_cstring(PG_GETARG_TEXT_PP(2));
+	TupleDesc tupdesc;
+	Datum values[2];
+	bool nulls[2] = {false, false};
+	Oid typoid;
+	int32 typmod;
+	char * text;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	parseTypeString(typname, &typoid, &typmod, NULL);
+	if (typoid != NUMERICOID)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("type %s is not numeric", typname)));
+
+	text = fc_decodeUnscaledDecimal((const unsigned char *) VARDATA_ANY(unscaled),
+			VARSIZE_ANY_EXHDR(unscaled), scale, typmod, &values[1]);
+	values[0] = CStringGetTextDatum(text);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * synchdb_decode_temporal
+ *
+ * This function decodes a date/time value sent by Debezium as a number of days
+ * or time units since epoch or midnight, the same way as the format converter
+ * does for change events, for regression tests. The Debezium semantic type such
+ * as io.debezium.time.MicroTimestamp tells the unit, and the precision of the
+ * given type is applied.
+ *
+ * @return: the decoded value as text, NULL if it is out of range of the type
+ */
+Datum
+synchdb_decode_temporal(PG_FUNCTION_ARGS)
+{
+	int64 value = PG_GETARG_INT64(0);
+	char * semantictype = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	char * typname = text_to_cstring(PG_GETARG_TEXT_PP(2));
+	Oid typoid;
+	int32 typmod;
+	char * result;
+
+	parseTypeString(typname, &typoid, &typmod, NULL);
+	result = fc_decodeTemporal(psprintf(INT64_FORMAT, value), semantictype, typoid, typmod);
+	if (!result)
+		PG_RETURN_NULL();
+
+	PG_RETURN_TEXT_P(cstring_to_text(result));
+}
+
+/*
+ * synchdb_parameterize_expression
+ *
+ * This function turns the %d, %w and %s tokens of a data transform expression
+ * into parameters the same way as the replication agent does before it prepares
+ * the expression, for regression tests.
+ *
+ * @return: the query the expression is prepared as, NULL if the expression has
+ * to be run with its tokens filled in
+ */
+Datum
+synchdb_parameterize_expression(PG_FUNCTION_ARGS)
+{
+	char * expression = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char * query;
+
+	query = ra_parameterizeExpression(expression);
+	if (!query)
+		PG_RETURN_NULL();
+
+	PG_RETURN_TEXT_P(cstring_to_text(query));
+}
@@ -48,6 +48,13 @@
  * 		pg_synchdb/mysql_mysqlconn_offsets.dat
  */
 #define SYNCHDB_OFFSET_FILE_PATTERN "pg_synchdb/%s_%s_offsets.dat"
+
+/*
+ * primary keys deferred by snapshot fast load and not added yet
+ * ex: 	pg_synchdb/[connector]_[name]_deferredpks.dat
+ */
+#define SYNCHDB_FASTLOAD_FILE_PATTERN "pg_synchdb/%s_%s_deferredpks.dat"
+#define SYNCHDB_METADATA_DIR "pg_synchdb"
 #define SYNCHDB_SECRET "930e62fb8c40086c23f543357a023c0c"
 
 #define SYNCHDB_CONNINFO_TABLE "synchdb_conninfo"
@@ -107,7 +114,8 @@ typedef enum _connectorStatistics
 	STATS_BAD_CHANGE_EVENT,
 	STATS_TOTAL_CHANGE_EVENT,
 	STATS_BATCH_COMPLETION,
-	STATS_AVERAGE_BATCH_SIZE
+	STATS_AVERAGE_BATCH_SIZE,
+	STATS_JNI_CALLS
 } ConnectorStatistics;
 
 /**
@@ -189,6 +197,7 @@ typedef struct _SynchdbStatistics
 	unsigned long long stats_total_change_event;/* number of total change events */
 	unsigned long long stats_batch_completion;	/* number of batches completed */
 	unsigned long long stats_average_batch_size;/* calculated average batch size: */
+	unsigned long long stats_jni_calls;			/* number of JNI calls made for batches */
 
 	/* todo: more stats to be added */
 } SynchdbStatistics;
@@ -233,6 +242,7 @@ ConnectorState get_shm_connector_state_enum(int connectorId);
 const char* connectorTypeToString(ConnectorType type);
 void set_shm_connector_stage(int connectorId, ConnectorStage stage);
 ConnectorStage get_shm_connector_stage_enum(int connectorId);
-void increment_connector_statistics(SynchdbStatistics * myStats, ConnectorStatistics which, int incby);
+void increment_connector_statistics(SynchdbStatistics * myStats, ConnectorStatistics which, unsigned long long incby);
+void synchdb_init_shmem(void);
 
 #endif /* SYNCHDB_SYNCHDB_H_ */